@@ -0,0 +1,116 @@
+#ifndef ASYNC_IO_HPP
+#define ASYNC_IO_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <span>
+
+class ThreadPool;
+
+/**
+ * Positional reads and writes that run in the background while the caller
+ * keeps computing, so disk transfers overlap compression.
+ *
+ * On Linux 5.6+ requests go through an io_uring instance (set up with the
+ * raw system calls, no liburing needed); when io_uring is missing or
+ * blocked (old kernel, seccomp, kernel.io_uring_disabled) a few dedicated
+ * threads issue plain pread/pwrite instead. Either way a request is cut
+ * into pieces of at most PIECE_SIZE bytes, up to depth of them are in
+ * flight at once, and short transfers are resumed until the request is
+ * complete.
+ *
+ * Buffers must stay valid until the request's ticket has been waited on or
+ * drain() has returned. One thread submits and waits; the object is not
+ * meant to be shared between submitting threads.
+ */
+class AsyncIO {
+public:
+    enum class Backend {
+        AUTO,      // io_uring when the kernel allows it, threads otherwise
+        IO_URING,
+        THREADS
+    };
+
+    using Ticket = uint64_t;  // 0 = nothing to wait for
+
+    static constexpr unsigned DEFAULT_DEPTH = 32;
+    static constexpr size_t PIECE_SIZE = 4 << 20;
+
+    explicit AsyncIO(unsigned depth = DEFAULT_DEPTH, Backend backend = getPreferredBackend());
+    // Waits for the requests still in flight, ignoring their errors
+    ~AsyncIO();
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    // Queue out.size() / data.size() bytes at offset of fd
+    Ticket read(int fd, std::span<uint8_t> out, uint64_t offset);
+    Ticket write(int fd, std::span<const uint8_t> data, uint64_t offset);
+
+    // Blocks until the request finished; throws std::runtime_error if it
+    // failed (I/O error or end of file inside a read)
+    void wait(Ticket ticket);
+    void wait(std::span<const Ticket> tickets);
+    // Waits for every queued request; throws for the first that failed
+    void drain();
+
+    // Backend in use after AUTO was resolved
+    Backend getBackend() const { return backend_; }
+    unsigned getDepth() const { return depth_; }
+
+    // Backend of AsyncIO objects constructed without one (process-wide,
+    // AUTO by default)
+    static void setPreferredBackend(Backend backend);
+    static Backend getPreferredBackend();
+    static std::string getBackendName(Backend backend);
+
+private:
+    struct Piece {
+        Ticket ticket = 0;
+        int fd = -1;
+        bool write = false;
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        uint64_t offset = 0;
+        size_t done = 0;
+    };
+    struct Request {
+        size_t pending = 0;  // Pieces not yet finished
+        int error = 0;       // First errno, -1 for an unexpected end of file
+    };
+    struct Ring;
+
+    Backend backend_;
+    unsigned depth_;
+    Ticket next_ticket_ = 1;
+    std::unordered_map<Ticket, Request> requests_;
+    std::mutex mutex_;                 // Guards requests_ (threads backend)
+    std::condition_variable finished_;
+
+    // io_uring state: pieces waiting for a free slot, and the slots
+    std::unique_ptr<Ring> ring_;
+    std::deque<Piece> backlog_;
+    std::vector<Piece> slots_;
+    std::vector<unsigned> free_slots_;
+
+    std::unique_ptr<ThreadPool> workers_;
+
+    Ticket submit(int fd, bool write, uint8_t* data, size_t size, uint64_t offset);
+    void finishPiece(Ticket ticket, int error);
+    bool isPending(Ticket ticket);
+    void takeResult(Ticket ticket);
+
+    bool setupRing();
+    // Submits what fits from the backlog and reaps completions, blocking
+    // for at least one when block is set and something is in flight
+    void pump(bool block);
+    void runPiece(Piece piece);
+};
+
+#endif
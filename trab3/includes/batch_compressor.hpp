@@ -0,0 +1,90 @@
+#ifndef BATCH_COMPRESSOR_HPP
+#define BATCH_COMPRESSOR_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "compressor.hpp"
+#include "zstd_dictionary.hpp"
+
+/**
+ * Compresses or restores every shard of a model directory in one process.
+ *
+ * All shards are scheduled on the shared thread pool: up to one shard per
+ * core runs at a time, started largest first, and the cores are divided
+ * between the shards in flight. A shard therefore never asks for more
+ * workers (chunk tasks or ZSTD threads) than its share, and while one shard
+ * waits on disk reads or writes the others keep compressing. The chunks of
+ * every shard are queued on the same pool, so workers that finish early pick
+ * up work from whichever shard still has some.
+ *
+ * Files other than shards (config, tokenizer, the safetensors index) are
+ * copied unchanged. compressDirectory writes a manifest.json listing every
+ * shard with its archive and sizes next to the archives.
+ */
+class BatchCompressor {
+public:
+    struct ShardResult {
+        std::string input;        // File name inside the source directory
+        std::string output;       // File name inside the destination directory
+        uint64_t input_bytes = 0;
+        uint64_t output_bytes = 0;
+        size_t chunks = 0;
+        double seconds = 0.0;
+        bool ok = false;
+    };
+
+    static constexpr const char* MANIFEST_NAME = "manifest.json";
+
+    void setThreads(unsigned threads) { threads_ = threads; }
+    void setMemoryLimit(size_t bytes) { memory_limit_ = bytes; }
+    void setAutoStrategy(bool enabled) { auto_strategy_ = enabled; }
+    void setMinimumGain(double fraction) { min_gain_ = fraction; }
+    void setDictionary(std::shared_ptr<const ZstdDictionary> dictionary) { dictionary_ = std::move(dictionary); }
+
+    // *.safetensors in input_dir -> *.stcmp in output_dir (created if missing)
+    bool compressDirectory(const std::string& input_dir, const std::string& output_dir,
+                           Compressor::Algorithm algo, Compressor::OperationPoint op_point);
+
+    // *.stcmp in input_dir -> *.safetensors in output_dir
+    bool decompressDirectory(const std::string& input_dir, const std::string& output_dir);
+
+    // One entry per shard, in file name order
+    const std::vector<ShardResult>& getResults() const { return results_; }
+    const std::vector<std::string>& getCopiedFiles() const { return copied_; }
+    // Shards processed side by side in the last run
+    size_t getConcurrency() const { return concurrency_; }
+
+private:
+    unsigned threads_ = 0;
+    size_t memory_limit_ = 0;
+    bool auto_strategy_ = false;
+    double min_gain_ = Compressor::DEFAULT_MIN_GAIN;
+    std::shared_ptr<const ZstdDictionary> dictionary_;
+    std::vector<ShardResult> results_;
+    std::vector<std::string> copied_;
+    size_t concurrency_ = 0;
+    std::mutex print_mutex_;
+
+    // Lists the shards with the given extension and copies every other
+    // regular file except the manifest; false if the directories are unusable
+    bool prepare(const std::string& input_dir, const std::string& output_dir,
+                 const std::string& shard_ext, const std::string& output_ext);
+
+    // Runs job(input, output, threads, memory_limit, result) for every shard
+    template <typename Job>
+    void runShards(const std::string& input_dir, const std::string& output_dir, Job job);
+
+    bool compressShard(const std::string& input, const std::string& output,
+                       Compressor::Algorithm algo, Compressor::OperationPoint op_point,
+                       unsigned threads, size_t memory_limit, ShardResult& result);
+    bool decompressShard(const std::string& input, const std::string& output,
+                         unsigned threads, size_t memory_limit, ShardResult& result);
+    void reportShard(const ShardResult& result, size_t done);
+    bool writeManifest(const std::string& output_dir,
+                       Compressor::Algorithm algo, Compressor::OperationPoint op_point) const;
+};
+
+#endif
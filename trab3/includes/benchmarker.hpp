@@ -4,10 +4,26 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <span>
+#include <functional>
 #include "compressor.hpp"
+#include "memory_tracker.hpp"
 
 class Benchmarker {
 public:
+    // Distribution of one phase's wall time over the timed repetitions;
+    // percentiles interpolate linearly between the sorted samples
+    struct PhaseStats {
+        unsigned samples = 0;
+        double median = 0.0;
+        double p10 = 0.0;
+        double p90 = 0.0;
+        double mean = 0.0;
+        double stddev = 0.0;   // Sample standard deviation, 0 for one sample
+        double min = 0.0;
+        double max = 0.0;
+    };
+
     struct BenchmarkResult {
         std::string algorithm;
         std::string operation_point;
@@ -15,39 +31,133 @@ public:
         size_t original_size;
         size_t compressed_size;
         double compression_ratio;
-        double preprocess_time;
-        double compress_time;
+        double preprocess_time;         // Medians of preprocess_stats / deprocess_stats
+        double compress_time;           // Codec share: full call median minus the transform median
         double decompress_time;
         double deprocess_time;
-        double total_compress_time;
+        double total_compress_time;     // Medians of compress_stats / decompress_stats
         double total_decompress_time;
+        PhaseStats preprocess_stats;    // Payload transforms alone, segment by segment
+        PhaseStats deprocess_stats;
+        PhaseStats compress_stats;
+        PhaseStats decompress_stats;
+        unsigned warmup_runs;
+        bool cold_input;
         double throughput_mb_per_sec;
+        // Order-0 entropy in bits per byte, averaged over 64 KiB blocks so a
+        // transform that regroups bytes (byte planes) shows its effect
         double original_entropy;
         double preprocessed_entropy;
         double entropy_reduction;
-        double peak_memory_mb;
+        // Measured in one extra untimed round: preprocessing the payload
+        // alone, then the full compress and decompress calls
+        MemoryTracker::PhaseMemory preprocess_memory;
+        MemoryTracker::PhaseMemory compress_memory;
+        MemoryTracker::PhaseMemory decompress_memory;
+        unsigned threads;
         bool decompression_verified;
     };
 
+    // One algorithm timed at one thread count; speedups are relative to the
+    // single-threaded run of the same algorithm
+    struct ScalingResult {
+        std::string algorithm;
+        std::string operation_point;
+        unsigned threads;
+        size_t original_size;
+        double compress_time;       // Medians over the timed repetitions
+        double decompress_time;
+        PhaseStats compress_stats;
+        PhaseStats decompress_stats;
+        double compress_speedup;
+        double decompress_speedup;
+        size_t compressed_size;
+    };
+
     Benchmarker() = default;
     ~Benchmarker() = default;
 
-    BenchmarkResult runBenchmark(const std::vector<uint8_t>& data, 
+    // Tensor table of the benchmarked payload; empty means one BF16 blob
+    void setTensors(const std::vector<TensorInfo>& tensors) { tensors_ = tensors; }
+
+    // Worker threads for every run (0 = all cores); also the upper end of
+    // the thread scaling sweep
+    void setThreads(unsigned threads) { compressor_.setThreads(threads); }
+
+    // Untimed rounds before measuring (code, allocator and caches warm up)
+    // and timed rounds per configuration [defaults: 1 and 3]
+    void setWarmup(unsigned rounds) { warmup_ = rounds; }
+    void setRepetitions(unsigned rounds) { repetitions_ = rounds == 0 ? 1 : rounds; }
+
+    // Called before every timed compression to evict the input from the
+    // page cache, so each round reads it from disk; unset means warm input
+    void setColdInput(std::function<void()> evict) { evict_input_ = std::move(evict); }
+
+    // Pins every thread of the process, including pool workers that already
+    // exist, to the given CPUs; later threads inherit the mask
+    bool setCpuPinning(const std::vector<unsigned>& cpus);
+
+    static PhaseStats summarize(std::vector<double> times);
+
+    BenchmarkResult runBenchmark(std::span<const uint8_t> data, 
                                  Compressor::Algorithm algo,
                                  Compressor::OperationPoint op_point);
     
-    std::vector<BenchmarkResult> runAllBenchmarks(const std::vector<uint8_t>& data);
+    std::vector<BenchmarkResult> runAllBenchmarks(std::span<const uint8_t> data);
     
-    std::vector<BenchmarkResult> runAlgorithmComparison(const std::vector<uint8_t>& data,
+    std::vector<BenchmarkResult> runAlgorithmComparison(std::span<const uint8_t> data,
                                                         Compressor::OperationPoint op_point);
 
+    // Times every algorithm at 1, 2, 4, ... threads up to the configured count
+    std::vector<ScalingResult> runThreadScaling(std::span<const uint8_t> data,
+                                                Compressor::OperationPoint op_point);
+
     void printResults(const std::vector<BenchmarkResult>& results);
+    void printScalingTable(const std::vector<ScalingResult>& results);
+    bool saveScalingCSV(const std::vector<ScalingResult>& results, const std::string& filepath);
     void printComparisonTable(const std::vector<BenchmarkResult>& results);
     bool saveResultsJSON(const std::vector<BenchmarkResult>& results, const std::string& filepath);
     bool saveResultsCSV(const std::vector<BenchmarkResult>& results, const std::string& filepath);
 
 private:
     Compressor compressor_;
+    std::vector<TensorInfo> tensors_;
+    unsigned warmup_ = 1;
+    unsigned repetitions_ = 3;
+    std::function<void()> evict_input_;
+    std::vector<unsigned> pinned_cpus_;
+
+    // Runs the warmup and timed rounds of compress + decompress; the last
+    // round's output is left in compressed / decompressed
+    void measure(std::span<const uint8_t> data,
+                 Compressor::Algorithm algo,
+                 Compressor::OperationPoint op_point,
+                 std::vector<uint8_t>& compressed,
+                 std::vector<uint8_t>& decompressed,
+                 PhaseStats& compress_stats,
+                 PhaseStats& decompress_stats);
+    std::string describeRun() const;
+
+    // Preprocesses the payload as compress() does, one segment after the
+    // other into out (sized to the transformed segments)
+    void preprocessPayload(std::span<const uint8_t> data,
+                           const std::vector<Compressor::Segment>& plan,
+                           ByteBuffer& out);
+
+    // Times the payload transforms alone, preprocess and then deprocess,
+    // over the same warmup and timed rounds as measure(); the preprocessed
+    // bytes of the last round are left in preprocessed
+    void measureTransforms(std::span<const uint8_t> data,
+                           Compressor::OperationPoint op_point,
+                           ByteBuffer& preprocessed,
+                           PhaseStats& preprocess_stats,
+                           PhaseStats& deprocess_stats);
+
+    // Runs the memory round; the sampler thread would skew timed rounds
+    void measureMemory(std::span<const uint8_t> data,
+                       Compressor::Algorithm algo,
+                       Compressor::OperationPoint op_point,
+                       BenchmarkResult& result);
 
     class Timer {
     public:
@@ -61,8 +171,7 @@ private:
         std::chrono::high_resolution_clock::time_point start_;
     };
 
-    double getPeakMemoryUsageMB();
-    bool verifyDecompression(const std::vector<uint8_t>& original, 
+    bool verifyDecompression(std::span<const uint8_t> original,
                             const std::vector<uint8_t>& decompressed);
 };
 
@@ -0,0 +1,42 @@
+#ifndef BYTE_BUFFER_HPP
+#define BYTE_BUFFER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Allocator whose construct() default-initialises instead of
+ * value-initialising, so resize() on a byte vector leaves the new bytes
+ * unwritten. Scratch and output buffers that are about to be overwritten in
+ * full by a kernel or codec are then touched once instead of twice, and
+ * a reused buffer never pays for zeroing again.
+ */
+template <typename T>
+class DefaultInitAllocator : public std::allocator<T> {
+public:
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    DefaultInitAllocator() = default;
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    template <typename U>
+    void construct(U* p) noexcept {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        std::allocator_traits<std::allocator<T>>::construct(
+            static_cast<std::allocator<T>&>(*this), p, std::forward<Args>(args)...);
+    }
+};
+
+// Growable byte buffer without zero-fill on resize
+using ByteBuffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+#endif
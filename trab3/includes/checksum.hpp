@@ -0,0 +1,34 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+
+/**
+ * CRC32C (Castagnoli polynomial, as in iSCSI, ext4 and SSE4.2), the
+ * integrity check of STCMP archives.
+ *
+ * On x86 CPUs with SSE4.2 the crc32 instruction runs three independent
+ * streams over interleaved blocks whose CRCs are then combined, which keeps
+ * the instruction's pipeline full; elsewhere a slicing-by-8 table loop
+ * produces the same values. The kernel is picked once at runtime.
+ *
+ * crc is the CRC of the bytes before data, so a buffer may be checksummed
+ * in pieces: crc32c(b, crc32c(a)) == crc32c(a + b).
+ */
+namespace checksum {
+
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+inline uint32_t crc32c(std::span<const uint8_t> data, uint32_t crc = 0) {
+    return crc32c(data.data(), data.size(), crc);
+}
+
+// Name of the kernel crc32c dispatches to ("SSE4.2", "Scalar")
+std::string getKernelName();
+
+} // namespace checksum
+
+#endif
@@ -4,7 +4,12 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <span>
+#include <memory>
+#include "byte_buffer.hpp"
 #include "preprocessor.hpp"
+#include "safetensors_parser.hpp"
+#include "zstd_dictionary.hpp"
 
 class Compressor {
 public:
@@ -12,7 +17,8 @@ public:
         ZSTD,
         LZ4,
         DEFLATE,
-        LZMA
+        LZMA,
+        RANS
     };
 
     enum class OperationPoint {
@@ -20,19 +26,154 @@ public:
         MAXIMUM
     };
 
-    Compressor() = default;
-    ~Compressor() = default;
+    // Contiguous byte range of the tensor payload preprocessed with one strategy
+    struct Segment {
+        uint64_t offset;
+        uint64_t size;
+        Preprocessor::Strategy strategy;
+        uint64_t row_length = 0;  // Innermost dimension of its (largest) tensor, 0 for 1-D
+    };
+
+    // One point of a backend's parameter space, beyond the level the
+    // operation points pick; fields a backend does not use are ignored
+    struct CodecSettings {
+        Algorithm algorithm = Algorithm::ZSTD;
+        int level = 0;              // ZSTD -5..22, LZ4 0 (fast) or HC 1..12, DEFLATE 1..9, LZMA 0..9
+        int acceleration = 1;       // LZ4 fast mode
+        bool long_distance = false; // ZSTD long-distance matching (128 MiB window)
+        bool extreme = false;       // LZMA_PRESET_EXTREME
+    };
 
-    std::vector<uint8_t> compress(const std::vector<uint8_t>& data, 
+    Compressor();
+    ~Compressor();
+
+    std::vector<uint8_t> compress(std::span<const uint8_t> data,
                                    Algorithm algo, 
                                    OperationPoint op_point);
-    std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed_data, 
+    std::vector<uint8_t> decompress(std::span<const uint8_t> compressed_data,
+                                     Algorithm algo,
+                                     OperationPoint op_point);
+
+    // Tensor-aware variants: each tensor is preprocessed according to its dtype
+    std::vector<uint8_t> compress(std::span<const uint8_t> data,
+                                   const std::vector<TensorInfo>& tensors,
+                                   Algorithm algo,
+                                   OperationPoint op_point);
+    std::vector<uint8_t> decompress(std::span<const uint8_t> compressed_data,
+                                     const std::vector<TensorInfo>& tensors,
                                      Algorithm algo,
                                      OperationPoint op_point);
 
+    std::vector<Segment> planSegments(const std::vector<TensorInfo>& tensors,
+                                      size_t data_size,
+                                      OperationPoint op_point);
+
+    // Chunked container support: chunks are segments capped at the chunk size,
+    // split at tensor boundaries where possible (else at row boundaries),
+    // and compressed independently
+    std::vector<Segment> planChunks(const std::vector<TensorInfo>& tensors,
+                                    size_t data_size,
+                                    Algorithm algo,
+                                    OperationPoint op_point);
+    // threads is the parallelism available inside this one chunk; callers
+    // that already run chunks side by side pass 1
+    std::vector<uint8_t> compressChunk(std::span<const uint8_t> raw,
+                                        Algorithm algo,
+                                        Preprocessor::Strategy strategy,
+                                        OperationPoint op_point,
+                                        unsigned threads = 1);
+    std::vector<uint8_t> decompressChunk(std::span<const uint8_t> compressed,
+                                          Algorithm algo,
+                                          Preprocessor::Strategy strategy,
+                                          unsigned threads = 1);
+
+    // Allocation-free chunk path. compressChunk writes at most
+    // maxCompressedSize() bytes to out and returns the compressed size;
+    // decompressChunk restores exactly out.size() raw bytes. scratch carries
+    // the preprocessed form and is only grown, so reusing it across chunks
+    // avoids fresh allocations, zero-fill and page faults.
+    size_t compressChunk(std::span<const uint8_t> raw,
+                         std::span<uint8_t> out,
+                         Algorithm algo,
+                         Preprocessor::Strategy strategy,
+                         OperationPoint op_point,
+                         ByteBuffer& scratch,
+                         unsigned threads = 1,
+                         size_t row_length = 0);
+    void decompressChunk(std::span<const uint8_t> compressed,
+                         std::span<uint8_t> out,
+                         Algorithm algo,
+                         Preprocessor::Strategy strategy,
+                         ByteBuffer& scratch,
+                         unsigned threads = 1);
+    static size_t maxCompressedSize(size_t raw_size, Algorithm algo, Preprocessor::Strategy strategy);
+
+    // Automatic strategy selection: instead of always using the dtype's
+    // default transform, each chunk gets the lossless candidate for its
+    // element width that compresses a sample best. The choice is recorded
+    // per chunk in the container, so decompression never repeats it. Chunks
+    // of matrices (row_length > 0) also try the planar and the vertical 2D
+    // XOR prediction.
+    void setAutoStrategy(bool enabled) { auto_strategy_ = enabled; }
+    bool getAutoStrategy() const { return auto_strategy_; }
+    Preprocessor::Strategy selectStrategy(std::span<const uint8_t> raw,
+                                          Algorithm algo,
+                                          Preprocessor::Strategy dtype_strategy,
+                                          OperationPoint op_point,
+                                          size_t row_length = 0);
+
+    // Chunks a quick probe rates at less than min_gain saving (a fraction of
+    // their size) are stored instead of compressed, as are chunks the codec
+    // would expand; 0 keeps only the latter. worthCompressing is the probe.
+    static constexpr double DEFAULT_MIN_GAIN = 0.02;
+    void setMinimumGain(double fraction) { min_gain_ = fraction; }
+    double getMinimumGain() const { return min_gain_; }
+    bool worthCompressing(std::span<const uint8_t> raw,
+                          Algorithm algo,
+                          Preprocessor::Strategy strategy,
+                          size_t row_length = 0);
+
+    void setChunkSize(size_t bytes) { chunk_size_ = bytes; }
+    size_t getChunkSize(Algorithm algo, OperationPoint op_point) const;
+
+    // Caps the working set of one chunk (input window, preprocessed copy,
+    // output buffer and codec state); 0 disables the limit
+    void setMemoryLimit(size_t bytes) { memory_limit_ = bytes; }
+    size_t getMemoryLimit() const { return memory_limit_; }
+    size_t estimateChunkMemory(Algorithm algo, OperationPoint op_point, size_t chunk_size) const;
+
+    // Worker threads used by compress/decompress and by the chunked
+    // container; 0 = all available cores
+    void setThreads(unsigned threads) { threads_ = threads; }
+    unsigned getThreads() const;
+
+    // Trained dictionary for ZSTD frames (other codecs ignore it); nullptr
+    // for none. Frames compressed with one need the same one to decompress.
+    void setDictionary(std::shared_ptr<const ZstdDictionary> dictionary) { dictionary_ = std::move(dictionary); }
+    const std::shared_ptr<const ZstdDictionary>& getDictionary() const { return dictionary_; }
+
+    // Appends dictionary training samples from source: fraction of every
+    // chunk (at least one window), in windows of up to window_size bytes
+    // spread over the chunk, each preprocessed on its own with the chunk's
+    // strategy as a small tensor would be
+    void addDictionarySamples(const SafetensorsParser& source,
+                              OperationPoint op_point,
+                              double fraction,
+                              size_t window_size,
+                              ByteBuffer& samples,
+                              std::vector<size_t>& sample_sizes);
+
+    // Bare codec, no preprocessing: out holds at least blockBound() bytes,
+    // and the frame decodes with decompressBlock whatever the settings
+    static size_t blockBound(size_t size, Algorithm algo);
+    size_t compressBlock(std::span<const uint8_t> data, std::span<uint8_t> out,
+                         const CodecSettings& settings, unsigned threads);
+    void decompressBlock(std::span<const uint8_t> data, std::span<uint8_t> out, Algorithm algo, unsigned threads);
+
+    // Legacy monolithic format (version 2), kept for compatibility
     bool writeCompressedFile(const std::string& filepath, 
                             const std::string& header,
-                            const std::vector<uint8_t>& compressed_data, 
+                            std::span<const uint8_t> compressed_data,
                             Algorithm algo,
                             OperationPoint op_point);
     bool readCompressedFile(const std::string& filepath, 
@@ -46,20 +187,52 @@ public:
 
 private:
     Preprocessor preprocessor_;
+    size_t chunk_size_ = 0;    // 0 = default for the operation point
+    size_t memory_limit_ = 0;  // 0 = unlimited
+    unsigned threads_ = 0;     // 0 = hardware concurrency
+    bool auto_strategy_ = false;
+    double min_gain_ = DEFAULT_MIN_GAIN;
+    std::shared_ptr<const ZstdDictionary> dictionary_;
+
+    // Reusable codec contexts; safe to lease from any number of threads
+    struct ContextPools;
+    std::unique_ptr<ContextPools> pools_;
+
+    std::vector<Segment> buildPlan(const std::vector<TensorInfo>& tensors,
+                                   size_t data_size,
+                                   OperationPoint op_point,
+                                   uint64_t max_segment_size);
 
-    std::vector<uint8_t> compressZSTD(const std::vector<uint8_t>& data, int level);
-    std::vector<uint8_t> decompressZSTD(const std::vector<uint8_t>& data);
+    // Codecs write into out, which holds at least blockBound() bytes, and
+    // return the compressed size. The vector decoders find the output size
+    // themselves; the span decoders fill out exactly or throw.
+    size_t compressZSTD(std::span<const uint8_t> data, std::span<uint8_t> out, const CodecSettings& settings, unsigned threads);
+    size_t compressZSTDTiled(std::span<const uint8_t> raw, Preprocessor::Strategy strategy,
+                             std::span<uint8_t> out, int level, unsigned threads, ByteBuffer& scratch,
+                             size_t row_length);
+    std::vector<uint8_t> decompressZSTD(std::span<const uint8_t> data, unsigned threads);
+    void decompressZSTD(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
     
-    std::vector<uint8_t> compressLZ4(const std::vector<uint8_t>& data, int level);
-    std::vector<uint8_t> decompressLZ4(const std::vector<uint8_t>& data);
+    size_t compressLZ4(std::span<const uint8_t> data, std::span<uint8_t> out, const CodecSettings& settings, unsigned threads);
+    std::vector<uint8_t> decompressLZ4(std::span<const uint8_t> data, unsigned threads);
+    void decompressLZ4(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
     
-    std::vector<uint8_t> compressDEFLATE(const std::vector<uint8_t>& data, int level);
-    std::vector<uint8_t> decompressDEFLATE(const std::vector<uint8_t>& data);
+    size_t compressDEFLATE(std::span<const uint8_t> data, std::span<uint8_t> out, int level, unsigned threads);
+    std::vector<uint8_t> decompressDEFLATE(std::span<const uint8_t> data, unsigned threads);
+    void decompressDEFLATE(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
     
-    std::vector<uint8_t> compressLZMA(const std::vector<uint8_t>& data, int level);
-    std::vector<uint8_t> decompressLZMA(const std::vector<uint8_t>& data);
+    size_t compressLZMA(std::span<const uint8_t> data, std::span<uint8_t> out, const CodecSettings& settings, unsigned threads);
+    std::vector<uint8_t> decompressLZMA(std::span<const uint8_t> data, unsigned threads);
+    void decompressLZMA(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
+
+    std::vector<uint8_t> compressBlock(std::span<const uint8_t> data, Algorithm algo, int level, unsigned threads);
+    size_t compressBlock(std::span<const uint8_t> data, std::span<uint8_t> out, Algorithm algo, int level, unsigned threads);
+    std::vector<uint8_t> decompressBlock(std::span<const uint8_t> data, Algorithm algo, unsigned threads);
+
+    static std::vector<Preprocessor::Strategy> candidateStrategies(Preprocessor::Strategy dtype_strategy, bool matrix);
 
     Preprocessor::Strategy getPreprocessingStrategy(OperationPoint op_point);
+    Preprocessor::Strategy getPreprocessingStrategy(DType dtype, OperationPoint op_point);
     int getCompressionLevel(Algorithm algo, OperationPoint op_point);
 };
 
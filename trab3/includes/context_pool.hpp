@@ -0,0 +1,105 @@
+#ifndef CONTEXT_POOL_HPP
+#define CONTEXT_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * Free list of expensive codec contexts (ZSTD_CCtx, z_stream, lzma_stream,
+ * ...). A PooledContext takes an idle context, or creates one when none is
+ * idle, and gives it back when it goes out of scope, so each worker thread
+ * keeps reusing the same few objects instead of allocating and tearing down
+ * codec state per call. Any number of threads may share a pool.
+ *
+ * Each thread first tries its own slot, one atomic exchange that no other
+ * thread touches while there are no more threads than cores, so the common
+ * take/give pair of a worker reusing its context never locks. Only when the
+ * slot is empty (first call, or a thread holding several contexts at once)
+ * or already full does it fall back to the mutex-guarded shared list.
+ *
+ * Contexts come back in whatever state the last user left them (including
+ * after an exception), so callers must reset a context before using it.
+ */
+template <typename T>
+class ContextPool {
+public:
+    using Destroy = void (*)(T*);
+
+    explicit ContextPool(Destroy destroy)
+        : destroy_(destroy),
+          slot_count_(std::max(1u, std::thread::hardware_concurrency())),
+          slots_(std::make_unique<Slot[]>(slot_count_)) {}
+    ~ContextPool() {
+        for (size_t i = 0; i < slot_count_; ++i) {
+            if (T* ctx = slots_[i].ctx.load(std::memory_order_relaxed)) destroy_(ctx);
+        }
+        for (T* ctx : idle_) destroy_(ctx);
+    }
+
+    ContextPool(const ContextPool&) = delete;
+    ContextPool& operator=(const ContextPool&) = delete;
+
+    T* take() {
+        if (T* ctx = slot().ctx.exchange(nullptr, std::memory_order_acquire)) return ctx;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.empty()) return nullptr;
+        T* ctx = idle_.back();
+        idle_.pop_back();
+        return ctx;
+    }
+
+    void give(T* ctx) {
+        T* empty = nullptr;
+        if (slot().ctx.compare_exchange_strong(empty, ctx, std::memory_order_release,
+                                               std::memory_order_relaxed)) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(ctx);
+    }
+
+private:
+    // One cache line each, so neighbouring threads do not share one
+    struct alignas(64) Slot {
+        std::atomic<T*> ctx{nullptr};
+    };
+
+    Destroy destroy_;
+    size_t slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+    std::mutex mutex_;
+    std::vector<T*> idle_;
+
+    // Threads are numbered in order of first use of a pool of this type;
+    // beyond the core count they share slots, which stays correct
+    Slot& slot() {
+        static std::atomic<size_t> next_index{0};
+        thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+        return slots_[index % slot_count_];
+    }
+};
+
+template <typename T>
+class PooledContext {
+public:
+    PooledContext(ContextPool<T>& pool, T* (*create)()) : pool_(pool), ctx_(pool.take()) {
+        if (!ctx_) ctx_ = create();
+        if (!ctx_) throw std::runtime_error("Failed to allocate a codec context");
+    }
+    ~PooledContext() { pool_.give(ctx_); }
+
+    PooledContext(const PooledContext&) = delete;
+    PooledContext& operator=(const PooledContext&) = delete;
+
+    T* get() const { return ctx_; }
+
+private:
+    ContextPool<T>& pool_;
+    T* ctx_;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef IO_UTIL_HPP
+#define IO_UTIL_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+/**
+ * Small output helpers shared by the archive, the quantizer and the batch
+ * manifest, kept in one place so their behaviour cannot drift apart.
+ */
+namespace io_util {
+
+// Positional I/O that retries short transfers; safe to call from several
+// threads on one descriptor. False on an error or an early end of file.
+bool preadFully(int fd, std::span<uint8_t> out, uint64_t offset);
+bool pwriteFully(int fd, std::span<const uint8_t> data, uint64_t offset);
+
+// text as a quoted JSON string: quotes and backslashes are escaped, bytes
+// below 0x20 written as \u00XX; other bytes pass through unchanged
+std::string jsonString(const std::string& text);
+
+} // namespace io_util
+
+#endif
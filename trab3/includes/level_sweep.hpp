@@ -0,0 +1,86 @@
+#ifndef LEVEL_SWEEP_HPP
+#define LEVEL_SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <span>
+#include "compressor.hpp"
+#include "benchmarker.hpp"
+
+/**
+ * Runs every level of each backend, in every variant it has (ZSTD long
+ * mode, LZ4 acceleration, LZMA extreme), over the payload preprocessed with
+ * each chosen strategy, and finds the configurations on the Pareto frontier
+ * of ratio, compression speed and decompression speed.
+ *
+ * Work that does not feed a timer runs in parallel: a screening pass
+ * compresses every configuration once on one thread and checks its round
+ * trip. The timed rounds then run one configuration at a time with all
+ * threads, since concurrent runs would share cores and memory bandwidth
+ * and skew each other's speeds. Each strategy is preprocessed and timed
+ * once; its median is added to the codec times of its configurations.
+ * Strategies are swept one after another, so a single preprocessed copy
+ * of the payload is held at a time, and a strategy whose inverse does not
+ * restore the input leaves all its configurations unverified.
+ */
+class LevelSweep {
+public:
+    struct Point {
+        Compressor::CodecSettings settings;
+        Preprocessor::Strategy strategy;
+        std::string algorithm;      // e.g. "ZSTD"
+        std::string variant;        // e.g. "19 long", "fast a8", "9e"
+        size_t original_size = 0;
+        size_t compressed_size = 0; // Of the timed runs
+        double compression_ratio = 0.0;
+        Benchmarker::PhaseStats compress_stats;    // Preprocessing + codec
+        Benchmarker::PhaseStats decompress_stats;  // Codec + deprocessing
+        double compress_mb_per_sec = 0.0;          // From the medians
+        double decompress_mb_per_sec = 0.0;
+        bool verified = false;
+        bool pareto = false;
+    };
+
+    // Every configuration swept for algo, fastest settings first
+    static std::vector<Compressor::CodecSettings> levelGrid(Compressor::Algorithm algo);
+
+    void setAlgorithms(const std::vector<Compressor::Algorithm>& algorithms) { algorithms_ = algorithms; }
+    void setStrategies(const std::vector<Preprocessor::Strategy>& strategies) { strategies_ = strategies; }
+
+    // Threads of the timed runs and of the parallel passes (0 = all cores)
+    void setThreads(unsigned threads) { threads_ = threads; }
+    void setWarmup(unsigned rounds) { warmup_ = rounds; }
+    void setRepetitions(unsigned rounds) { repetitions_ = rounds == 0 ? 1 : rounds; }
+    // Bounds the screening workers, each of which holds a compressed and a
+    // decoded copy of the payload; 0 = one worker per thread
+    void setMemoryLimit(size_t bytes) { memory_limit_ = bytes; }
+
+    std::vector<Point> run(std::span<const uint8_t> data);
+
+    // Sets pareto on every point no other point matches or beats in all
+    // three of ratio, compression speed and decompression speed
+    static void markParetoFrontier(std::vector<Point>& points);
+
+    void printFrontier(const std::vector<Point>& points) const;
+    bool saveCSV(const std::vector<Point>& points, const std::string& filepath, bool frontier_only) const;
+    bool saveJSON(const std::vector<Point>& points, const std::string& filepath) const;
+
+private:
+    Compressor compressor_;
+    std::vector<Compressor::Algorithm> algorithms_ = {
+        Compressor::Algorithm::ZSTD, Compressor::Algorithm::LZ4,
+        Compressor::Algorithm::DEFLATE, Compressor::Algorithm::LZMA
+    };
+    std::vector<Preprocessor::Strategy> strategies_ = {
+        Preprocessor::Strategy::NONE, Preprocessor::Strategy::BYTE_REORDER
+    };
+    unsigned threads_ = 0;
+    unsigned warmup_ = 1;
+    unsigned repetitions_ = 3;
+    size_t memory_limit_ = 0;
+
+    unsigned getThreads() const;
+    static std::string describeVariant(const Compressor::CodecSettings& settings);
+};
+
+#endif
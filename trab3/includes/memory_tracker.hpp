@@ -0,0 +1,76 @@
+#ifndef MEMORY_TRACKER_HPP
+#define MEMORY_TRACKER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+
+/**
+ * Memory accounting for benchmark phases, from two sources:
+ *
+ *  - heap: live bytes obtained through operator new, which covers every
+ *    std::vector and ByteBuffer of the pipeline. The replacement operators
+ *    in memory_hooks.cpp report to this class; only the compressor
+ *    executable links them, because a library must not replace the
+ *    allocator of the program that loads it. Without them the heap figures
+ *    stay zero and heapTracked() is false.
+ *  - resident: the process RSS from /proc/self/statm, sampled by a
+ *    background thread. It also sees what the heap count cannot: codec
+ *    state that zstd, liblzma and zlib allocate with malloc, and pages of
+ *    the memory-mapped input.
+ *
+ * Unlike ru_maxrss, both are measured per phase, so a phase that needs
+ * less than an earlier one reports its own peak.
+ */
+class MemoryTracker {
+public:
+    struct PhaseMemory {
+        uint64_t heap_peak_bytes = 0;      // Peak live heap above the level at the start
+        uint64_t resident_peak_bytes = 0;  // Peak RSS above the RSS at the start
+        uint64_t resident_max_bytes = 0;   // Peak RSS of the process
+    };
+
+    // Measures from construction to stop(). The heap peak is process-wide,
+    // so meters must not overlap.
+    class PhaseMeter {
+    public:
+        explicit PhaseMeter(std::chrono::microseconds interval = std::chrono::microseconds(1000));
+        ~PhaseMeter();
+
+        PhaseMeter(const PhaseMeter&) = delete;
+        PhaseMeter& operator=(const PhaseMeter&) = delete;
+
+        PhaseMemory stop();
+
+    private:
+        uint64_t start_heap_;
+        uint64_t start_resident_;
+        std::atomic<uint64_t> max_resident_;
+        std::atomic<bool> running_{true};
+        std::thread sampler_;
+    };
+
+    // Called by the replacement allocation functions with usable sizes
+    static void recordAllocation(size_t bytes) {
+        uint64_t live = live_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        uint64_t peak = peak_.load(std::memory_order_relaxed);
+        while (live > peak && !peak_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+    static void recordRelease(size_t bytes) { live_.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    static void setHeapTracked(bool tracked) { tracked_.store(tracked, std::memory_order_relaxed); }
+    static bool heapTracked() { return tracked_.load(std::memory_order_relaxed); }
+    static uint64_t liveHeapBytes() { return live_.load(std::memory_order_relaxed); }
+
+    // Current RSS, 0 if /proc is unavailable
+    static uint64_t residentBytes();
+
+private:
+    inline static std::atomic<uint64_t> live_{0};
+    inline static std::atomic<uint64_t> peak_{0};
+    inline static std::atomic<bool> tracked_{false};
+};
+
+#endif
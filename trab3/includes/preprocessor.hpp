@@ -4,6 +4,9 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <span>
+#include <functional>
+#include "byte_buffer.hpp"
 
 class Preprocessor {
 public:
@@ -14,32 +17,105 @@ public:
         BF16_TO_FP16,
         COMBINED,
         BYTE_REORDER_DELTA,        
-        BIT_PLANE_SEPARATION       
+        BIT_PLANE_SEPARATION,
+        BYTE_REORDER_32,           // Byte planes of 4-byte elements (F32, I32, U32)
+        BYTE_REORDER_64,           // Byte planes of 8-byte elements (F64, I64, U64)
+        FIELD_SPLIT_BF16,          // Exponent, sign and mantissa streams of BF16 values
+        FIELD_SPLIT_F16,           // Same for F16 (5-bit exponent, 10-bit mantissa)
+        FIELD_SPLIT_F32,           // Exponent, sign and mantissa byte planes of F32 values
+        XOR_DELTA_32,              // XOR with the previous 4-byte value, then byte planes
+        XOR_2D_16,                 // XOR with the 2-byte value one row up, then byte planes
+        XOR_2D_32,                 // Same for 4-byte values
+        XOR_PLANE_16,              // XOR with up ^ left ^ up-left 2-byte values, then byte planes
+        XOR_PLANE_32               // Same for 4-byte values
     };
 
     Preprocessor() = default;
     ~Preprocessor() = default;
 
-    std::vector<uint8_t> preprocess(const std::vector<uint8_t>& data, Strategy strategy);
-    std::vector<uint8_t> deprocess(const std::vector<uint8_t>& data, Strategy strategy);
+    // threads bounds the workers a strategy may use on the shared pool;
+    // only the bit-plane transform is currently split. row_length is the
+    // innermost dimension, in elements, of the matrix the data holds; only
+    // the 2D strategies use it (0 = one row) and they record it in their
+    // output, so deprocess needs no shape. This deprocess recovers the raw
+    // size from data.size() and throws std::invalid_argument when several
+    // raw sizes give that length (bit planes and field streams pad to whole
+    // bytes); callers that know the size use the caller-buffer variant.
+    std::vector<uint8_t> preprocess(std::span<const uint8_t> data, Strategy strategy, unsigned threads = 1,
+                                    size_t row_length = 0);
+    std::vector<uint8_t> deprocess(std::span<const uint8_t> data, Strategy strategy, unsigned threads = 1);
 
-    static double calculateEntropy(const std::vector<uint8_t>& data);
+    // Caller-buffer variants: preprocess fills out, which must hold exactly
+    // preprocessedSize(data.size()) bytes; deprocess restores out.size() raw
+    // bytes from data, which must be preprocessedSize(out.size()) bytes
+    void preprocess(std::span<const uint8_t> data, std::span<uint8_t> out, Strategy strategy, unsigned threads = 1,
+                    size_t row_length = 0);
+    void deprocess(std::span<const uint8_t> data, std::span<uint8_t> out, Strategy strategy, unsigned threads = 1);
+
+    // Hands the preprocessed bytes to sink in order, in pieces of about
+    // tile_bytes, so a streaming codec consumes them without a full-size
+    // copy. Byte-plane strategies are built tile by tile from the input;
+    // the others are preprocessed whole into scratch.
+    void preprocessTiled(std::span<const uint8_t> data, Strategy strategy, size_t tile_bytes,
+                         ByteBuffer& scratch, const std::function<void(std::span<const uint8_t>)>& sink,
+                         unsigned threads = 1, size_t row_length = 0);
+
+    // Size of the preprocessed form of raw_size bytes (bit planes and field
+    // streams pad to whole bytes, the 2D strategies add their row length). Every strategy carries bytes past the last
+    // whole element over unchanged, so any length round-trips.
+    static size_t preprocessedSize(size_t raw_size, Strategy strategy);
+
+    static double calculateEntropy(std::span<const uint8_t> data);
     static std::string getStrategyName(Strategy strategy);
 
 private:
-    std::vector<uint8_t> byteReorder(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> byteDeorder(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> deltaEncode(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> deltaDecode(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> bf16ToFp16(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> fp16ToBf16(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> combinedPreprocess(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> combinedDeprocess(const std::vector<uint8_t>& data);
-
-    std::vector<uint8_t> byteReorderDelta(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> byteReorderDeltaInverse(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> bitPlaneSeparation(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> bitPlaneReconstruction(const std::vector<uint8_t>& data);
+    void byteReorder(std::span<const uint8_t> data, std::span<uint8_t> out);
+    void byteDeorder(std::span<const uint8_t> data, std::span<uint8_t> out);
+    std::vector<uint8_t> deltaEncode(std::span<const uint8_t> data);
+    std::vector<uint8_t> deltaDecode(std::span<const uint8_t> data);
+    std::vector<uint8_t> bf16ToFp16(std::span<const uint8_t> data);
+    std::vector<uint8_t> fp16ToBf16(std::span<const uint8_t> data);
+    std::vector<uint8_t> combinedPreprocess(std::span<const uint8_t> data);
+    std::vector<uint8_t> combinedDeprocess(std::span<const uint8_t> data);
+
+    std::vector<uint8_t> byteReorderDelta(std::span<const uint8_t> data);
+    std::vector<uint8_t> byteReorderDeltaInverse(std::span<const uint8_t> data);
+    void bitPlaneSeparation(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
+    void bitPlaneReconstruction(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads);
+    void byteSplit(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size);
+    void byteMerge(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size);
+    void fieldSplit(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned exp_bits, unsigned threads);
+    void fieldMerge(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned exp_bits, unsigned threads);
+    void fieldSplit32(std::span<const uint8_t> data, std::span<uint8_t> out);
+    void fieldMerge32(std::span<const uint8_t> data, std::span<uint8_t> out);
+    void xorDelta32(std::span<const uint8_t> data, std::span<uint8_t> out);
+    void xorDeltaInverse32(std::span<const uint8_t> data, std::span<uint8_t> out);
+    void xorPredict2D(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size, size_t row_length,
+                      bool planar);
+    void xorReconstruct2D(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size, bool planar);
+
+    // Residuals of raw bytes [begin, end) under the 2D prediction, to res
+    static void predict2DRange(const uint8_t* raw, uint8_t* res, size_t begin, size_t end,
+                               size_t elem_size, size_t row_bytes, bool planar);
+
+    // Element size of the byte-plane strategies, 0 for the others
+    static size_t planeElementSize(Strategy strategy);
+
+    // Element size of the 2D prediction strategies, 0 for the others
+    static size_t predictElementSize(Strategy strategy);
+    // Whether a 2D strategy predicts from up ^ left ^ up-left rather than up
+    static bool isPlanarPrediction(Strategy strategy);
+
+    // Row length stored by the 2D strategies: 0 for a single row, which is
+    // also how lengths that are unknown or cover every value are written
+    static uint32_t storedRowLength(size_t row_length, size_t count);
+
+    // Exponent width of the field-split strategies, 0 for the others
+    static unsigned fieldExponentBits(Strategy strategy);
+
+    // Bytes of the exponent, sign and mantissa streams of count values
+    static size_t fieldStreamsSize(size_t count, unsigned exp_bits);
+    static size_t fieldStreamsSize32(size_t count);
 };
 
 #endif
@@ -0,0 +1,97 @@
+#ifndef QUANTIZER_HPP
+#define QUANTIZER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <span>
+#include "safetensors_parser.hpp"
+
+/**
+ * Block-wise absmax INT4/INT8 quantization of floating point tensors, the
+ * lossy first stage of the compression pipeline and a native replacement
+ * for scripts/quantize_blockwise.py.
+ *
+ * A tensor is cut into blocks of block_size values (the last one short).
+ * Each block is scaled by absmax / qmax (qmax 7 for INT4, 127 for INT8; 1
+ * for an all-zero block) and every value rounded half to even and clamped
+ * to [-qmax - 1, qmax], all in float32, which reproduces the script's
+ * NumPy arithmetic bit for bit. The output safetensors keeps the script's
+ * layout:
+ *
+ *   name              INT4: U8[ceil(n / 2)], value 2i in the high nibble
+ *                     of byte i and value 2i + 1 in the low one
+ *                     INT8: I8 with the original shape
+ *   name.__scales__   F32[ceil(n / block_size)], one scale per block
+ *
+ * Tensors the script would skip (small, embeddings, norms, biases) and
+ * non-float tensors are copied unchanged, in their original dtype. In the
+ * payload all scales come first, then the kept tensors, then the codes, so
+ * the backend sees each kind as one long run with its own preprocessing
+ * instead of small interleaved pieces.
+ *
+ * quantizeFile streams: the layout is fixed by the header, so each tensor
+ * is converted in place into a reused buffer and written at its final
+ * offset, and memory stays at about one tensor whatever the model size.
+ * Within a tensor, ranges of blocks are quantized in parallel. Conversion
+ * of BF16/F16 input, the absmax and the quantization itself run on AVX2
+ * (with F16C for F16) when the CPU has them, picked once at runtime.
+ */
+class Quantizer {
+public:
+    struct Stats {
+        size_t tensors = 0;
+        size_t quantized_tensors = 0;
+        uint64_t original_bytes = 0;
+        uint64_t code_bytes = 0;   // Packed INT4 / INT8 values
+        uint64_t scale_bytes = 0;
+        uint64_t kept_bytes = 0;   // Tensors copied unchanged
+        double seconds = 0.0;
+
+        uint64_t outputBytes() const { return code_bytes + scale_bytes + kept_bytes; }
+    };
+
+    // bits is 4 or 8; block_size must be at least 1
+    explicit Quantizer(unsigned bits = 4, size_t block_size = 128);
+
+    // Worker threads (0 = all cores)
+    void setThreads(unsigned threads) { threads_ = threads; }
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+
+    unsigned getBits() const { return bits_; }
+    size_t getBlockSize() const { return block_size_; }
+
+    // Same choice as should_quantize_tensor in the script, restricted to
+    // the floating point dtypes it can convert (BF16, F16, F32, F64)
+    static bool shouldQuantize(const TensorInfo& tensor);
+
+    // Bytes of the codes and number of scales for count values
+    size_t codesSize(size_t count) const;
+    size_t scalesCount(size_t count) const;
+
+    // Quantizes the values in src (dtype BF16, F16, F32 or F64) into codes
+    // and scales, sized by the two functions above
+    void quantize(std::span<const uint8_t> src, DType dtype, std::span<uint8_t> codes,
+                  std::span<float> scales) const;
+
+    // Reads a safetensors file and writes its quantized form to output
+    bool quantizeFile(const std::string& input, const std::string& output);
+
+    const Stats& getStats() const { return stats_; }
+
+    // Name of the instruction set the kernels dispatch to ("AVX2", "Scalar")
+    static std::string getKernelName();
+
+private:
+    unsigned bits_;
+    size_t block_size_;
+    unsigned threads_ = 0;
+    bool verbose_ = true;
+    Stats stats_;
+
+    void quantizeRange(std::span<const uint8_t> src, DType dtype, size_t first_block, size_t last_block,
+                       std::span<uint8_t> codes, std::span<float> scales,
+                       std::vector<float>& values, std::vector<int8_t>& levels) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef RANS_CODEC_HPP
+#define RANS_CODEC_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+/**
+ * Order-0 rANS entropy coder for preprocessed tensor bytes.
+ *
+ * After byte reordering a BF16 chunk is one long run of mantissa bytes
+ * (nearly uniform) followed by one of sign/exponent bytes (a handful of
+ * symbols carrying 2-3 bits of entropy). The input is cut into 1 MiB
+ * blocks, each with its own frequency table, so the exponent half is coded
+ * with its own skewed statistics and mantissa blocks that rANS cannot
+ * shrink are stored raw. Four interleaved 32-bit states keep the decoder's
+ * dependency chains independent; blocks are (de)coded on the shared pool.
+ *
+ * Stream layout (native byte order):
+ *   u64 raw size | u32 block size | u32 block count
+ *   u32 encoded size per block | blocks
+ * Block: u8 mode (0 = raw, 1 = rANS), then the raw bytes, or
+ *   32-byte symbol bitmap | frequency per present symbol (1-2 bytes)
+ *   4 x u32 initial decoder states | renormalisation bytes
+ */
+namespace rans {
+
+// Worst-case encoded size of size input bytes
+size_t encodeBound(size_t size);
+
+// Returns the encoded size; out must hold encodeBound(data.size()) bytes
+size_t encode(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads = 1);
+
+// Raw size recorded in an encoded stream
+uint64_t decodedSize(std::span<const uint8_t> data);
+
+// Fills out, which must hold exactly decodedSize(data) bytes; throws
+// std::runtime_error on a corrupt stream
+void decode(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads = 1);
+
+} // namespace rans
+
+#endif
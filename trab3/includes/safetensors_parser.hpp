@@ -4,26 +4,122 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <span>
+#include "async_io.hpp"
+
+// Element types defined by the safetensors specification
+enum class DType {
+    BOOL,
+    U8,
+    I8,
+    F8_E4M3,
+    F8_E5M2,
+    I16,
+    U16,
+    F16,
+    BF16,
+    I32,
+    U32,
+    F32,
+    I64,
+    U64,
+    F64,
+    UNKNOWN
+};
+
+// One entry of the header's tensor table. Offsets are relative to the start
+// of the tensor data region (i.e. after the 8-byte size and the JSON header).
+struct TensorInfo {
+    std::string name;
+    DType dtype = DType::UNKNOWN;
+    std::vector<int64_t> shape;
+    uint64_t data_begin = 0;
+    uint64_t data_end = 0;
+
+    uint64_t size() const { return data_end - data_begin; }
+};
 
 class SafetensorsParser {
 public:
+    // MMAP maps the file read-only and exposes the tensor region in place;
+    // READ copies the payload into an owned buffer (used when mmap fails),
+    // with several asynchronous reads in flight;
+    // STREAM only loads the header and serves payload windows through
+    // readTensorData(), keeping memory independent of the model size.
+    enum class LoadMode {
+        MMAP,
+        READ,
+        STREAM
+    };
+
     SafetensorsParser();
     ~SafetensorsParser();
 
-    bool parse(const std::string& filepath);
+    SafetensorsParser(const SafetensorsParser&) = delete;
+    SafetensorsParser& operator=(const SafetensorsParser&) = delete;
+
+    bool parse(const std::string& filepath, LoadMode mode = LoadMode::MMAP);
+
+    // Progress lines on stdout while parsing (on by default)
+    void setVerbose(bool verbose) { verbose_ = verbose; }
 
     const std::string& getHeader() const { return header_; }
-    const std::vector<uint8_t>& getTensorData() const { return tensor_data_; }
+    // Whole payload; empty in STREAM mode
+    std::span<const uint8_t> getTensorData() const { return tensor_span_; }
     size_t getFileSize() const { return file_size_; }
     size_t getHeaderSize() const { return header_size_; }
-    size_t getTensorDataSize() const { return tensor_data_.size(); }
+    size_t getTensorDataSize() const { return data_size_; }
+    bool isMapped() const { return mapping_ != nullptr; }
+    bool isStreaming() const { return fd_ >= 0; }
+
+    // Copies out.size() payload bytes starting at offset (works in every mode)
+    bool readTensorData(uint64_t offset, std::span<uint8_t> out) const;
+
+    // Same, queued on io in STREAM mode and done at once otherwise (ticket
+    // 0); out must stay valid until the ticket is waited on. Throws
+    // std::runtime_error for a range outside the payload.
+    AsyncIO::Ticket readTensorData(AsyncIO& io, uint64_t offset, std::span<uint8_t> out) const;
+
+    // Asks the kernel to start reading a payload range that will be needed
+    // soon (MMAP mode; the other modes read explicitly)
+    void prefetchTensorData(uint64_t offset, size_t size) const;
+
+    // Drops the file's pages from this process and from the page cache, so
+    // the next access reads from disk again (cold-start benchmarks). Only
+    // meaningful for MMAP and STREAM; false if the kernel refused.
+    bool dropPageCache() const;
+
+    // Tensor table, sorted by data offset
+    const std::vector<TensorInfo>& getTensors() const { return tensors_; }
+    const TensorInfo* findTensor(const std::string& name) const;
+
+    // Parses a safetensors JSON header into a tensor table sorted by offset.
+    // Also used on the decompression side, where only the header is stored.
+    static bool parseHeader(const std::string& header, size_t data_size,
+                            std::vector<TensorInfo>& tensors);
+
+    static DType parseDType(const std::string& name);
+    static std::string getDTypeName(DType dtype);
+    static size_t getDTypeSize(DType dtype);
 
 private:
     std::string filepath_;
     std::string header_;
-    std::vector<uint8_t> tensor_data_;
+    std::vector<TensorInfo> tensors_;
+    std::vector<uint8_t> tensor_data_;      // Owned payload (READ mode only)
+    std::span<const uint8_t> tensor_span_;  // View of the payload in either mode
+    void* mapping_;
+    int fd_;                                // Open descriptor (STREAM mode only)
     size_t file_size_;
     size_t header_size_;
+    size_t data_size_;
+    bool verbose_;
+
+    bool parseMapped(int fd);
+    bool parseRead();
+    bool parseStream(int fd);
+    bool parseTensorTable();
+    void release();
 };
 
 #endif
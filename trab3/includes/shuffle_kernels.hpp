@@ -0,0 +1,62 @@
+#ifndef SHUFFLE_KERNELS_HPP
+#define SHUFFLE_KERNELS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/**
+ * Byte- and bit-plane transposition kernels used by the preprocessing
+ * strategies.
+ *
+ * byteShuffle splits count elements of elem_size bytes into elem_size
+ * planes, plane b holding byte b of every element:
+ *
+ *   dst[b * count + i] = src[i * elem_size + b]
+ *
+ * byteUnshuffle is the exact inverse. Element sizes 2, 4 and 8 run on
+ * SSE2, AVX2 or AVX-512BW kernels picked once at runtime from the CPU
+ * features; other sizes and the tail that does not fill a vector use the
+ * scalar loop, so every path produces the same bytes.
+ */
+namespace shuffle {
+
+void byteShuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size);
+void byteUnshuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size);
+
+// Bit planes of count 16-bit values: plane p (0..15) holds bit p of every
+// value, value i at bit i % 8 of byte i / 8, planes ceil(count / 8) bytes
+// apart. A short last byte is zero-padded. Large inputs are split over up
+// to threads workers of the shared pool.
+void bitShuffle16(const uint8_t* src, uint8_t* dst, size_t count, unsigned threads = 1);
+void bitUnshuffle16(const uint8_t* src, uint8_t* dst, size_t count, unsigned threads = 1);
+
+// Sign/exponent/mantissa fields of count 16-bit floats with exp_bits
+// exponent bits (8 for BF16, 5 for FP16) and m = 15 - exp_bits mantissa
+// bits, as three streams: one exponent byte per value; the sign bits,
+// value i at bit i % 8 of byte i / 8; and the mantissas packed m bits each,
+// value i at bit (i % 8) * m of the m-byte group i / 8. The streams are
+// count, ceil(count / 8) and ceil(count * m / 8) bytes. BF16 and FP16 use
+// AVX2 + BMI2 kernels when available.
+void fieldSplit16(const uint8_t* src, uint8_t* exponents, uint8_t* signs, uint8_t* mantissas,
+                  size_t count, unsigned exp_bits, unsigned threads = 1);
+void fieldMerge16(const uint8_t* exponents, const uint8_t* signs, const uint8_t* mantissas, uint8_t* dst,
+                  size_t count, unsigned exp_bits, unsigned threads = 1);
+
+// dst[i] = a[i] ^ b[i] for n bytes; dst may be a
+void xorBytes(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n);
+
+// XOR prediction at a fixed distance, in place: xorPredict replaces every
+// byte i >= distance of data with data[i] ^ data[i - distance] (the
+// original values), xorReconstruct undoes it. Prediction is vectorised at
+// any distance, reconstruction from distance 32 up; shorter distances are
+// a serial chain.
+void xorPredict(uint8_t* data, size_t count, size_t distance);
+void xorReconstruct(uint8_t* data, size_t count, size_t distance);
+
+// Name of the instruction set the kernels dispatch to ("AVX-512", "AVX2", "SSE2", "Scalar")
+std::string getKernelName();
+
+} // namespace shuffle
+
+#endif
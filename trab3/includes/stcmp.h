@@ -0,0 +1,85 @@
+#ifndef STCMP_H
+#define STCMP_H
+
+/*
+ * libstcmp: C interface for loading tensors from STCMP archives on demand.
+ *
+ * A reader opens an archive (version 3 or later), lists its tensors and
+ * decodes any tensor into a caller-supplied buffer, touching only the
+ * chunks that hold it. Decoded chunks shared by several small tensors are
+ * kept in an LRU cache bounded by stcmp_set_cache_capacity.
+ *
+ * The reader is an opaque handle and every value crosses the boundary as a
+ * plain C type, so the ABI does not change with the C++ implementation.
+ * All functions are thread-safe for a given reader except stcmp_close.
+ * Strings returned for a tensor stay valid until the reader is closed.
+ *
+ *   stcmp_reader* r = stcmp_open("model.stcmp", NULL);
+ *   int64_t t = stcmp_find_tensor(r, "lm_head.weight");
+ *   void* buf = malloc(stcmp_tensor_size(r, t));
+ *   if (stcmp_read_tensor(r, t, buf, stcmp_tensor_size(r, t)) != STCMP_OK)
+ *       fprintf(stderr, "%s\n", stcmp_last_error());
+ *   stcmp_close(r);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STCMP_API __attribute__((visibility("default")))
+
+/* Incremented whenever a declaration below changes incompatibly */
+#define STCMP_ABI_VERSION 1
+
+typedef struct stcmp_reader stcmp_reader;
+
+enum {
+    STCMP_OK = 0,
+    STCMP_ERROR_INVALID_ARGUMENT = -1, /* NULL reader, unknown tensor index */
+    STCMP_ERROR_BUFFER_SIZE = -2,      /* dst_size differs from the tensor size */
+    STCMP_ERROR_DECODE = -3            /* read failure or corrupt chunk */
+};
+
+/* STCMP_ABI_VERSION the library was built with */
+STCMP_API uint32_t stcmp_abi_version(void);
+
+/* Message of the last failed call on this thread ("" if none) */
+STCMP_API const char* stcmp_last_error(void);
+
+/* Opens an archive; dictionary_path is the ZSTD dictionary it was
+ * compressed with, or NULL. Returns NULL on failure. */
+STCMP_API stcmp_reader* stcmp_open(const char* path, const char* dictionary_path);
+STCMP_API void stcmp_close(stcmp_reader* reader);
+
+/* The original safetensors JSON header */
+STCMP_API const char* stcmp_header(const stcmp_reader* reader);
+
+/* Tensor table, indices 0 .. count-1 in data order */
+STCMP_API size_t stcmp_tensor_count(const stcmp_reader* reader);
+STCMP_API int64_t stcmp_find_tensor(const stcmp_reader* reader, const char* name); /* -1 if absent */
+STCMP_API const char* stcmp_tensor_name(const stcmp_reader* reader, size_t index);
+STCMP_API const char* stcmp_tensor_dtype(const stcmp_reader* reader, size_t index);  /* e.g. "BF16" */
+STCMP_API size_t stcmp_tensor_ndim(const stcmp_reader* reader, size_t index);
+STCMP_API const int64_t* stcmp_tensor_shape(const stcmp_reader* reader, size_t index);
+STCMP_API uint64_t stcmp_tensor_size(const stcmp_reader* reader, size_t index);     /* bytes */
+
+/* Decodes tensor index into dst, which must be exactly its size */
+STCMP_API int stcmp_read_tensor(stcmp_reader* reader, size_t index, void* dst, size_t dst_size);
+
+/* Decoded-chunk cache budget in bytes (0 disables it, default 256 MiB) and
+ * decoding threads per read (0 = all cores) */
+STCMP_API void stcmp_set_cache_capacity(stcmp_reader* reader, size_t bytes);
+STCMP_API void stcmp_set_threads(stcmp_reader* reader, unsigned threads);
+
+/* Cache counters; any pointer may be NULL */
+STCMP_API void stcmp_cache_stats(const stcmp_reader* reader, uint64_t* hits, uint64_t* misses,
+                                 size_t* cached_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
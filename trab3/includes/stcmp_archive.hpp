@@ -0,0 +1,235 @@
+#ifndef STCMP_ARCHIVE_HPP
+#define STCMP_ARCHIVE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <span>
+#include <fstream>
+#include <functional>
+#include "compressor.hpp"
+#include "safetensors_parser.hpp"
+#include "async_io.hpp"
+
+/**
+ * STCMP version 3: chunked container with a trailing seek index.
+ *
+ *   "STCMP" | u8 version (3) | u8 algorithm | u8 operation point
+ *   u64 header size | safetensors JSON header
+ *   u64 raw tensor data size
+ *   chunk payloads, back to back
+ *   index:  u32 chunk count, then per chunk
+ *           u64 raw offset | u64 raw size | u64 file offset | u64 compressed size
+ *           u8 algorithm | u8 strategy | u8 flags
+ *   footer: u64 index offset | "STIX"
+ *
+ * Version 4 is the same with a u32 ZSTD dictionary ID after the operation
+ * point; it is only written when the chunks need a trained dictionary
+ * (see ZstdDictionary), which is stored separately.
+ *
+ * Version 5 adds CRC32C checksums (see checksum.hpp):
+ * the dictionary ID is always present (0 = none), every index entry ends
+ * with u32 CRC of the raw bytes | u32 CRC of the compressed bytes, and the
+ * entries are followed by u32 CRC of the JSON header | u32 CRC of the index
+ * (count, entries and header CRC). Readers check each chunk's compressed
+ * bytes before decoding and its raw bytes after, so corruption surfaces as
+ * an error instead of wrong tensors; versions 3 and 4 stay readable
+ * without these checks.
+ *
+ * Version 6, written by this build, gives the flags byte a meaning: bit 0
+ * (ChunkEntry::STORED) marks a chunk whose payload is its raw bytes, for
+ * data the compressor judged incompressible (see
+ * Compressor::worthCompressing). Such a chunk has strategy none and equal
+ * sizes and CRCs; it is restored with a plain read. Other bits are
+ * reserved and must be zero.
+ *
+ * Every chunk is compressed independently, so any tensor can be restored by
+ * decompressing only the chunks that overlap its byte range. Versions 1 and
+ * 2 (one monolithic blob) are still readable; they appear as a single chunk.
+ */
+struct ChunkEntry {
+    static constexpr uint8_t STORED = 0x01;  // Payload is the raw bytes (version 6+)
+
+    uint64_t raw_offset = 0;
+    uint64_t raw_size = 0;
+    uint64_t file_offset = 0;
+    uint64_t compressed_size = 0;
+    Compressor::Algorithm algo = Compressor::Algorithm::ZSTD;
+    Preprocessor::Strategy strategy = Preprocessor::Strategy::NONE;
+    uint8_t flags = 0;
+    uint32_t raw_crc = 0;         // CRC32C of the raw bytes (version 5+)
+    uint32_t compressed_crc = 0;  // CRC32C of the stored bytes (version 5+)
+
+    bool isStored() const { return (flags & STORED) != 0; }
+};
+
+/**
+ * Writes go through AsyncIO at each chunk's final offset, so the file
+ * layout is fixed by plan order while the transfers run in the background:
+ * compressing a batch of chunks overlaps writing the previous batch and,
+ * when streaming, reading the next one. I/O errors surface in
+ * writeChunks or finish.
+ */
+class StcmpWriter {
+public:
+    StcmpWriter() = default;
+    ~StcmpWriter();
+
+    StcmpWriter(const StcmpWriter&) = delete;
+    StcmpWriter& operator=(const StcmpWriter&) = delete;
+
+    bool open(const std::string& filepath,
+              const std::string& header,
+              Compressor::Algorithm algo,
+              Compressor::OperationPoint op_point,
+              uint64_t raw_size,
+              uint32_t dictionary_id = 0);
+
+    // Queues one compressed chunk; file_offset and compressed_size are
+    // filled in, the caller sets both CRCs. The write completes in the
+    // background, so compressed must stay valid until finish().
+    bool addChunk(ChunkEntry entry, std::span<const uint8_t> compressed);
+
+    // Plans, compresses and appends every chunk of the tensor payload
+    bool writeChunks(Compressor& compressor,
+                     std::span<const uint8_t> data,
+                     const std::vector<TensorInfo>& tensors);
+
+    // Same for a parsed file: mapped payloads are prefetched one batch
+    // ahead, streamed ones (LoadMode::STREAM) are read one batch ahead into
+    // a few rotating windows, so only those are resident
+    bool writeChunks(Compressor& compressor, const SafetensorsParser& source);
+
+    // Writes the index and footer and waits for every write to land
+    bool finish();
+
+    uint64_t getCompressedBytes() const { return payload_bytes_; }
+    // Chunks kept raw because they did not compress
+    size_t getStoredCount() const;
+    size_t getChunkCount() const { return index_.size(); }
+    const std::vector<ChunkEntry>& getChunks() const { return index_; }
+    // Backend the writes went through (resolved at open)
+    AsyncIO::Backend getIoBackend() const { return io_backend_; }
+
+private:
+    int fd_ = -1;
+    std::unique_ptr<AsyncIO> io_;
+    AsyncIO::Backend io_backend_ = AsyncIO::Backend::AUTO;
+    // Bytes before and after the chunks, kept alive while being written
+    std::vector<uint8_t> prefix_;  // Magic through raw size
+    std::vector<uint8_t> suffix_;  // Index and footer
+    std::vector<ChunkEntry> index_;
+    Compressor::Algorithm algo_ = Compressor::Algorithm::ZSTD;
+    Compressor::OperationPoint op_point_ = Compressor::OperationPoint::MAXIMUM;
+    uint64_t offset_ = 0;
+    uint64_t payload_bytes_ = 0;
+    uint32_t header_crc_ = 0;
+
+    // Throws std::runtime_error if the write cannot be queued
+    AsyncIO::Ticket queueChunk(ChunkEntry entry, std::span<const uint8_t> payload);
+
+    // Reads windows from source when it streams, otherwise slices data
+    bool compressPlan(Compressor& compressor,
+                      const std::vector<Compressor::Segment>& plan,
+                      std::span<const uint8_t> data,
+                      const SafetensorsParser* source);
+};
+
+class StcmpReader {
+public:
+    StcmpReader() = default;
+    ~StcmpReader();
+
+    StcmpReader(const StcmpReader&) = delete;
+    StcmpReader& operator=(const StcmpReader&) = delete;
+
+    bool open(const std::string& filepath);
+
+    uint8_t getVersion() const { return version_; }
+    bool hasChecksums() const;
+    Compressor::Algorithm getAlgorithm() const { return algo_; }
+    Compressor::OperationPoint getOperationPoint() const { return op_point_; }
+    const std::string& getHeader() const { return header_; }
+
+    // ID of the dictionary the chunks were compressed with, 0 for none; it
+    // must be supplied through setDictionary before decoding
+    uint32_t getDictionaryID() const { return dictionary_id_; }
+    void setDictionary(std::shared_ptr<const ZstdDictionary> dictionary) {
+        compressor_.setDictionary(std::move(dictionary));
+    }
+    const std::vector<ChunkEntry>& getChunks() const { return chunks_; }
+    const std::vector<TensorInfo>& getTensors() const { return tensors_; }
+
+    // Raw tensor data size; unknown (0) for version 1/2 files until decoded
+    uint64_t getRawSize() const { return raw_size_; }
+
+    bool readCompressedChunk(size_t index, std::vector<uint8_t>& out);
+    std::vector<uint8_t> decompressChunk(size_t index);
+
+    // Decodes chunk index (version 3+) into out, which must hold exactly
+    // its raw size; compressed and scratch are reusable work buffers.
+    // Reads with pread, so several threads may call this at once. Throws
+    // std::runtime_error on read or decode errors.
+    void decompressChunk(size_t index, std::span<uint8_t> out,
+                         ByteBuffer& compressed, ByteBuffer& scratch, unsigned threads = 1);
+
+    // Restores one tensor, decompressing only the chunks overlapping it
+    bool decompressTensor(const std::string& name, std::vector<uint8_t>& out);
+
+    // Streams the whole tensor payload to out, decoding chunks in parallel
+    // batches and writing them in order
+    bool decompressAll(std::ostream& out, uint64_t* bytes_written = nullptr);
+
+    // Restores the complete safetensors file at path (size prefix, header,
+    // payload). The file is preallocated and every chunk is written at its
+    // final offset by the worker that decoded it, in whatever order the
+    // chunks finish; bytes_written receives the payload size. On failure
+    // the partial file is removed.
+    bool decompressToFile(const std::string& path, uint64_t* bytes_written = nullptr);
+
+    // Integrity check that writes nothing. Every chunk is read and, with
+    // checksums, its compressed bytes are checked; unless quick it is also
+    // decoded and its raw bytes checked (archives without checksums are
+    // always decoded). Chunks are checked in parallel and every failure is
+    // reported, not just the first.
+    struct VerifyReport {
+        size_t chunks = 0;
+        size_t failed_chunks = 0;
+        uint64_t compressed_bytes = 0;
+        uint64_t raw_bytes = 0;  // Decoded bytes, 0 for a quick check
+        bool checksums = false;
+        bool decoded = false;
+    };
+    bool verify(bool quick, VerifyReport& report);
+
+    // Decoding threads (0 = all cores) and a cap on the decoded chunks held
+    // at once (0 = unlimited)
+    void setThreads(unsigned threads) { compressor_.setThreads(threads); }
+    void setMemoryLimit(size_t bytes) { compressor_.setMemoryLimit(bytes); }
+
+private:
+    std::string filepath_;
+    std::ifstream file_;
+    int fd_ = -1;                      // Same file, for concurrent pread
+    std::string header_;
+    std::vector<ChunkEntry> chunks_;
+    std::vector<TensorInfo> tensors_;
+    Compressor compressor_;
+    Compressor::Algorithm algo_ = Compressor::Algorithm::ZSTD;
+    Compressor::OperationPoint op_point_ = Compressor::OperationPoint::MAXIMUM;
+    uint64_t raw_size_ = 0;
+    uint32_t dictionary_id_ = 0;
+    uint8_t version_ = 0;
+
+    bool readIndex(uint64_t file_size);
+    // Throws std::runtime_error unless bytes match the chunk's stored CRC
+    // (no-op without checksums)
+    void checkChunk(size_t index, std::span<const uint8_t> bytes, bool raw) const;
+    bool readAt(uint64_t offset, std::span<uint8_t> out);
+    std::vector<uint8_t> decodeChunk(size_t index, std::span<const uint8_t> compressed, unsigned threads);
+    size_t batchSize(size_t first, size_t last) const;
+    void decodeRange(size_t first, size_t last,
+                     const std::function<void(size_t, std::span<const uint8_t>)>& sink);
+};
+
+#endif
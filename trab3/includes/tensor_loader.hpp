@@ -0,0 +1,84 @@
+#ifndef TENSOR_LOADER_HPP
+#define TENSOR_LOADER_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <span>
+#include <cstdint>
+#include "byte_buffer.hpp"
+#include "stcmp_archive.hpp"
+
+/**
+ * On-demand tensor access to an STCMP archive, for programs that load a
+ * compressed checkpoint directly instead of restoring a .safetensors file
+ * first (the C ABI in stcmp.h wraps this class).
+ *
+ * Opening reads only the header and the chunk index. readTensor decodes
+ * just the chunks overlapping the requested tensor, in parallel, into the
+ * caller's buffer: chunks that lie entirely inside the tensor are decoded
+ * in place, while chunks shared with neighbouring tensors (small tensors
+ * are packed together) go through an LRU cache of decoded chunks, so
+ * loading the neighbours does not decode them again. Start-up cost is
+ * therefore proportional to the tensors actually touched.
+ *
+ * All methods may be called from several threads at once.
+ */
+class TensorLoader {
+public:
+    // Throws std::runtime_error unless path is a chunked (version 3+)
+    // archive; archives compressed with a dictionary need that dictionary
+    explicit TensorLoader(const std::string& path,
+                          std::shared_ptr<const ZstdDictionary> dictionary = nullptr);
+
+    TensorLoader(const TensorLoader&) = delete;
+    TensorLoader& operator=(const TensorLoader&) = delete;
+
+    const std::vector<TensorInfo>& getTensors() const { return reader_.getTensors(); }
+    const TensorInfo* findTensor(const std::string& name) const;
+    const std::string& getHeader() const { return reader_.getHeader(); }
+
+    // Decodes the tensor into out, which must be exactly tensor.size() bytes;
+    // throws std::runtime_error on corrupt data or a size mismatch
+    void readTensor(const TensorInfo& tensor, std::span<uint8_t> out);
+
+    // Budget for decoded shared chunks, 0 disables the cache [default: 256 MiB]
+    void setCacheCapacity(size_t bytes);
+    size_t getCacheCapacity() const;
+    size_t getCachedBytes() const;
+    uint64_t getCacheHits() const;
+    uint64_t getCacheMisses() const;
+
+    // Decoding threads per readTensor call (0 = all cores); may change
+    // while other threads read, which pick it up on their next call
+    void setThreads(unsigned threads) { threads_.store(threads, std::memory_order_relaxed); }
+
+private:
+    struct CacheEntry {
+        size_t chunk;
+        std::shared_ptr<const ByteBuffer> data;
+    };
+
+    StcmpReader reader_;
+    std::atomic<unsigned> threads_{0};
+
+    // Most recently used first; entries are shared so a reader can keep
+    // copying from a chunk that another thread just evicted
+    mutable std::mutex cache_mutex_;
+    std::list<CacheEntry> lru_;
+    std::unordered_map<size_t, std::list<CacheEntry>::iterator> cache_index_;
+    size_t cache_capacity_ = 256 << 20;
+    size_t cached_bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    std::shared_ptr<const ByteBuffer> lookup(size_t chunk);
+    void insert(size_t chunk, std::shared_ptr<const ByteBuffer> data);
+    void evict();  // Caller holds cache_mutex_
+};
+
+#endif
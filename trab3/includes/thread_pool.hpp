@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned num_threads = 0);  // 0 = hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs fn(0..count-1) with at most max_parallel calls in flight and
+    // returns once all of them finished, rethrowing the first exception.
+    // The calling thread takes part in the work, so it is safe to call from
+    // inside a pool task without deadlocking the pool.
+    void parallelFor(size_t count, size_t max_parallel, const std::function<void(size_t)>& fn);
+
+    unsigned getThreadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    // Process-wide pool shared by the compressor, archive reader and writer
+    static ThreadPool& shared();
+    static unsigned defaultThreadCount();
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef ZSTD_DICTIONARY_HPP
+#define ZSTD_DICTIONARY_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+/**
+ * Trained ZSTD dictionary shared by the shards of one model.
+ *
+ * Every chunk is an independent frame, so small tensors start from an empty
+ * history and pay for their own entropy tables. A dictionary trained on
+ * preprocessed samples of all shards primes each frame with the typical
+ * byte statistics instead. Archives record only the dictionary ID; the
+ * dictionary file travels separately.
+ *
+ * The digested forms are built once: the DDict when the dictionary is
+ * loaded, a CDict per compression level on first use. Loaded dictionaries
+ * are cached by ID, so every archive and reader in the process that uses
+ * the same dictionary shares one digested copy.
+ */
+class ZstdDictionary {
+public:
+    ~ZstdDictionary();
+
+    ZstdDictionary(const ZstdDictionary&) = delete;
+    ZstdDictionary& operator=(const ZstdDictionary&) = delete;
+
+    // Reads and digests a dictionary file, or returns the cached copy with
+    // the same ID; nullptr (with an error printed) if it is not a valid
+    // ZSTD dictionary
+    static std::shared_ptr<const ZstdDictionary> load(const std::string& path);
+    static std::shared_ptr<const ZstdDictionary> fromBytes(std::vector<uint8_t> bytes);
+
+    // Trains a dictionary of at most capacity bytes from samples laid back
+    // to back with the given sizes; throws std::runtime_error on failure
+    static std::vector<uint8_t> train(std::span<const uint8_t> samples,
+                                      const std::vector<size_t>& sample_sizes,
+                                      size_t capacity);
+
+    uint32_t getID() const { return id_; }
+    size_t getSize() const { return bytes_.size(); }
+
+    const ZSTD_DDict_s* getDDict() const { return ddict_; }
+    const ZSTD_CDict_s* getCDict(int level) const;
+
+private:
+    explicit ZstdDictionary(std::vector<uint8_t> bytes, uint32_t id);
+
+    std::vector<uint8_t> bytes_;
+    uint32_t id_ = 0;
+    ZSTD_DDict_s* ddict_ = nullptr;
+    mutable std::mutex cdict_mutex_;
+    mutable std::map<int, ZSTD_CDict_s*> cdicts_;
+};
+
+#endif
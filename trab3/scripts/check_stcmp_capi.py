@@ -0,0 +1,115 @@
+import sys
+import json
+import ctypes
+import struct
+import argparse
+
+
+def load_library(path):
+    lib = ctypes.CDLL(path)
+    reader = ctypes.c_void_p
+    signatures = {
+        "stcmp_abi_version": (ctypes.c_uint32, []),
+        "stcmp_last_error": (ctypes.c_char_p, []),
+        "stcmp_open": (reader, [ctypes.c_char_p, ctypes.c_char_p]),
+        "stcmp_close": (None, [reader]),
+        "stcmp_header": (ctypes.c_char_p, [reader]),
+        "stcmp_tensor_count": (ctypes.c_size_t, [reader]),
+        "stcmp_find_tensor": (ctypes.c_int64, [reader, ctypes.c_char_p]),
+        "stcmp_tensor_name": (ctypes.c_char_p, [reader, ctypes.c_size_t]),
+        "stcmp_tensor_dtype": (ctypes.c_char_p, [reader, ctypes.c_size_t]),
+        "stcmp_tensor_ndim": (ctypes.c_size_t, [reader, ctypes.c_size_t]),
+        "stcmp_tensor_shape": (ctypes.POINTER(ctypes.c_int64), [reader, ctypes.c_size_t]),
+        "stcmp_tensor_size": (ctypes.c_uint64, [reader, ctypes.c_size_t]),
+        "stcmp_read_tensor": (ctypes.c_int, [reader, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t]),
+        "stcmp_set_cache_capacity": (None, [reader, ctypes.c_size_t]),
+        "stcmp_set_threads": (None, [reader, ctypes.c_uint]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    return lib
+
+
+def read_safetensors(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    header_size = struct.unpack("<Q", data[:8])[0]
+    header = json.loads(data[8:8 + header_size])
+    payload = data[8 + header_size:]
+    tensors = {name: info for name, info in header.items() if name != "__metadata__"}
+    return header, tensors, payload
+
+
+def check(lib, archive, original, dictionary):
+    header, tensors, payload = read_safetensors(original)
+    failures = []
+
+    def expect(condition, message):
+        if not condition:
+            failures.append(message)
+
+    expect(lib.stcmp_abi_version() == 1, f"ABI version {lib.stcmp_abi_version()}")
+    expect(not lib.stcmp_open(original.encode(), None), "opened a file that is not an archive")
+    expect(lib.stcmp_last_error() != b"", "no error message after a failed open")
+
+    reader = lib.stcmp_open(archive.encode(), dictionary.encode() if dictionary else None)
+    if not reader:
+        return [f"cannot open {archive}: {lib.stcmp_last_error().decode()}"]
+
+    expect(json.loads(lib.stcmp_header(reader)) == header, "header differs")
+    count = lib.stcmp_tensor_count(reader)
+    expect(count == len(tensors), f"{count} tensors, expected {len(tensors)}")
+    expect(lib.stcmp_find_tensor(reader, b"no such tensor") == -1, "found a missing tensor")
+
+    # Decode every tensor twice: through the chunk cache, then with it off
+    for capacity, threads in ((256 << 20, 2), (0, 1)):
+        lib.stcmp_set_cache_capacity(reader, capacity)
+        lib.stcmp_set_threads(reader, threads)
+        for index in range(count):
+            name = lib.stcmp_tensor_name(reader, index).decode()
+            info = tensors.get(name)
+            if info is None:
+                failures.append(f"unexpected tensor {name}")
+                continue
+            begin, end = info["data_offsets"]
+            size = lib.stcmp_tensor_size(reader, index)
+            shape = lib.stcmp_tensor_shape(reader, index)
+            expect(lib.stcmp_find_tensor(reader, name.encode()) == index, f"{name}: wrong index")
+            expect(lib.stcmp_tensor_dtype(reader, index).decode() == info["dtype"], f"{name}: wrong dtype")
+            expect([shape[d] for d in range(lib.stcmp_tensor_ndim(reader, index))] == info["shape"],
+                   f"{name}: wrong shape")
+            expect(size == end - begin, f"{name}: {size} bytes, expected {end - begin}")
+
+            buffer = ctypes.create_string_buffer(size + 1)
+            status = lib.stcmp_read_tensor(reader, index, buffer, size)
+            expect(status == 0, f"{name}: read failed ({status})")
+            expect(buffer.raw[:size] == payload[begin:end], f"{name}: data differs")
+            expect(lib.stcmp_read_tensor(reader, index, buffer, size + 1) == -2, f"{name}: size not checked")
+
+    buffer = ctypes.create_string_buffer(1)
+    expect(lib.stcmp_read_tensor(reader, count, buffer, 1) == -1, "index past the end not rejected")
+    lib.stcmp_close(reader)
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Check the libstcmp C API against the safetensors file an archive was made from"
+    )
+    parser.add_argument("archive", help="STCMP archive (version 3 or later)")
+    parser.add_argument("original", help="SafeTensors file the archive was compressed from")
+    parser.add_argument("--library", default="lib/libstcmp.so", help="Path to libstcmp (default: lib/libstcmp.so)")
+    parser.add_argument("--dict", help="ZSTD dictionary the archive was compressed with")
+
+    args = parser.parse_args()
+
+    failures = check(load_library(args.library), args.archive, args.original, args.dict)
+    for message in failures:
+        print(f"Error: {message}")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
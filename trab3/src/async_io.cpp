@@ -0,0 +1,377 @@
+#include "../includes/async_io.hpp"
+#include "../includes/thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Pread/pwrite threads of the fallback; more only queue up in the kernel
+const unsigned MAX_IO_THREADS = 8;
+
+std::atomic<AsyncIO::Backend> preferred_backend{AsyncIO::Backend::AUTO};
+
+std::string describeError(int error) {
+    return error < 0 ? std::string("unexpected end of file") : std::string(strerror(error));
+}
+
+} // namespace
+
+// ============================================================================
+// IO_URING
+// ============================================================================
+
+#ifdef ASYNC_IO_URING
+
+// Submission and completion rings shared with the kernel. Only this thread
+// moves the submission tail and the completion head; the kernel moves the
+// other two ends, hence the acquire/release accesses.
+struct AsyncIO::Ring {
+    int fd = -1;
+    void* sq_map = MAP_FAILED;
+    size_t sq_map_size = 0;
+    void* cq_map = MAP_FAILED;
+    size_t cq_map_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;  // Entries filled in but not yet passed to the kernel
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map) munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED) munmap(sq_map, sq_map_size);
+        if (fd >= 0) close(fd);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+};
+
+bool AsyncIO::setupRing() {
+    auto ring = std::make_unique<Ring>();
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, depth_, &params));
+    if (ring->fd < 0) return false;
+    // IORING_OP_READ/WRITE came with this feature flag (Linux 5.6)
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) return false;
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map) ring->sq_map_size = ring->cq_map_size = std::max(ring->sq_map_size, ring->cq_map_size);
+
+    ring->sq_map = mmap(nullptr, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) return false;
+    ring->cq_map = single_map ? ring->sq_map
+                              : mmap(nullptr, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_map == MAP_FAILED) return false;
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(ring->sq_map);
+    uint8_t* cq = static_cast<uint8_t*>(ring->cq_map);
+    ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // At most depth_ pieces are in flight, so the completion ring (twice
+    // the submission entries) never overflows
+    depth_ = std::min(depth_, params.sq_entries);
+    ring_ = std::move(ring);
+    return true;
+}
+
+void AsyncIO::pump(bool block) {
+    Ring& ring = *ring_;
+
+    while (!backlog_.empty() && !free_slots_.empty()) {
+        unsigned slot = free_slots_.back();
+        free_slots_.pop_back();
+        slots_[slot] = backlog_.front();
+        backlog_.pop_front();
+        const Piece& piece = slots_[slot];
+
+        unsigned tail = *ring.sq_tail;
+        unsigned index = tail & ring.sq_mask;
+        io_uring_sqe* sqe = &ring.sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = piece.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = piece.fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(piece.data + piece.done);
+        sqe->len = static_cast<uint32_t>(piece.size - piece.done);
+        sqe->off = piece.offset + piece.done;
+        sqe->user_data = slot;
+        ring.sq_array[index] = index;
+        __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++ring.unsubmitted;
+    }
+
+    while (ring.unsubmitted > 0) {
+        int rc = ring.enter(ring.unsubmitted, 0, 0);
+        if (rc > 0) {
+            ring.unsubmitted -= static_cast<unsigned>(rc);
+        } else if (rc < 0 && errno == EINTR) {
+            continue;
+        } else if (rc < 0 && (errno == EAGAIN || errno == EBUSY)) {
+            break;  // Kernel is short of resources; retried after completions are reaped
+        } else {
+            throw std::runtime_error(std::string("io_uring submission failed: ") + strerror(errno));
+        }
+    }
+
+    auto reap = [&] {
+        size_t reaped = 0;
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head, ++reaped) {
+            const io_uring_cqe& cqe = ring.cqes[head & ring.cq_mask];
+            unsigned slot = static_cast<unsigned>(cqe.user_data);
+            Piece piece = slots_[slot];
+            free_slots_.push_back(slot);
+
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                backlog_.push_front(piece);
+            } else if (cqe.res < 0) {
+                finishPiece(piece.ticket, -cqe.res);
+            } else if (cqe.res == 0) {
+                finishPiece(piece.ticket, piece.write ? EIO : -1);
+            } else {
+                piece.done += static_cast<size_t>(cqe.res);
+                if (piece.done < piece.size) {
+                    backlog_.push_front(piece);  // Short transfer: queue the rest
+                } else {
+                    finishPiece(piece.ticket, 0);
+                }
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        return reaped;
+    };
+
+    bool in_flight = free_slots_.size() < depth_;
+    if (reap() == 0 && block && in_flight) {
+        // Entries the kernel refused above go along with the wait
+        int rc;
+        do {
+            rc = ring.enter(ring.unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        } while (rc < 0 && errno == EINTR);
+        if (rc > 0) {
+            ring.unsubmitted -= std::min(ring.unsubmitted, static_cast<unsigned>(rc));
+        } else if (rc < 0 && errno != EAGAIN && errno != EBUSY) {
+            throw std::runtime_error(std::string("io_uring wait failed: ") + strerror(errno));
+        }
+        reap();
+    }
+}
+
+#else
+
+struct AsyncIO::Ring {};
+
+bool AsyncIO::setupRing() { return false; }
+
+void AsyncIO::pump(bool) {}
+
+#endif
+
+// ============================================================================
+// THREADS
+// ============================================================================
+
+void AsyncIO::runPiece(Piece piece) {
+    int error = 0;
+    while (piece.done < piece.size) {
+        ssize_t n = piece.write
+            ? pwrite(piece.fd, piece.data + piece.done, piece.size - piece.done, piece.offset + piece.done)
+            : pread(piece.fd, piece.data + piece.done, piece.size - piece.done, piece.offset + piece.done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            error = n < 0 ? errno : (piece.write ? EIO : -1);
+            break;
+        }
+        piece.done += static_cast<size_t>(n);
+    }
+    finishPiece(piece.ticket, error);
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+AsyncIO::AsyncIO(unsigned depth, Backend backend) : backend_(backend), depth_(std::max(1u, depth)) {
+    if (backend_ != Backend::THREADS && setupRing()) {
+        backend_ = Backend::IO_URING;
+        slots_.resize(depth_);
+        for (unsigned slot = depth_; slot-- > 0;) free_slots_.push_back(slot);
+        return;
+    }
+    if (backend_ == Backend::IO_URING) {
+        std::cerr << "Warning: io_uring is not available, falling back to I/O threads" << std::endl;
+    }
+    backend_ = Backend::THREADS;
+    depth_ = std::min(depth_, MAX_IO_THREADS);
+    workers_ = std::make_unique<ThreadPool>(depth_);
+}
+
+AsyncIO::~AsyncIO() {
+    try {
+        drain();
+    } catch (const std::exception&) {
+        // Errors were for the owner to collect; the buffers are safe to free either way
+    }
+    workers_.reset();
+}
+
+AsyncIO::Ticket AsyncIO::read(int fd, std::span<uint8_t> out, uint64_t offset) {
+    return submit(fd, false, out.data(), out.size(), offset);
+}
+
+AsyncIO::Ticket AsyncIO::write(int fd, std::span<const uint8_t> data, uint64_t offset) {
+    // Never written through: the pointer only travels back to pwrite
+    return submit(fd, true, const_cast<uint8_t*>(data.data()), data.size(), offset);
+}
+
+AsyncIO::Ticket AsyncIO::submit(int fd, bool write, uint8_t* data, size_t size, uint64_t offset) {
+    if (size == 0) return 0;
+    Ticket ticket = next_ticket_++;
+    size_t pieces = (size + PIECE_SIZE - 1) / PIECE_SIZE;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_[ticket].pending = pieces;
+    }
+    for (size_t k = 0; k < pieces; ++k) {
+        Piece piece;
+        piece.ticket = ticket;
+        piece.fd = fd;
+        piece.write = write;
+        piece.data = data + k * PIECE_SIZE;
+        piece.size = std::min(PIECE_SIZE, size - k * PIECE_SIZE);
+        piece.offset = offset + k * PIECE_SIZE;
+        if (ring_) {
+            backlog_.push_back(piece);
+        } else {
+            workers_->submit([this, piece] { runPiece(piece); });
+        }
+    }
+    if (ring_) pump(false);
+    return ticket;
+}
+
+void AsyncIO::finishPiece(Ticket ticket, int error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Request& request = requests_[ticket];
+        if (error != 0 && request.error == 0) request.error = error;
+        --request.pending;
+    }
+    finished_.notify_all();
+}
+
+bool AsyncIO::isPending(Ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = requests_.find(ticket);
+    return it != requests_.end() && it->second.pending > 0;
+}
+
+void AsyncIO::takeResult(Ticket ticket) {
+    int error = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = requests_.find(ticket);
+        if (it == requests_.end()) return;
+        error = it->second.error;
+        requests_.erase(it);
+    }
+    if (error != 0) throw std::runtime_error("Asynchronous I/O failed: " + describeError(error));
+}
+
+void AsyncIO::wait(Ticket ticket) {
+    if (ticket == 0) return;
+    if (ring_) {
+        while (isPending(ticket)) {
+            if (backlog_.empty() && free_slots_.size() == depth_) {
+                throw std::logic_error("AsyncIO request has nothing in flight");
+            }
+            pump(true);
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [&] {
+            auto it = requests_.find(ticket);
+            return it == requests_.end() || it->second.pending == 0;
+        });
+    }
+    takeResult(ticket);
+}
+
+void AsyncIO::wait(std::span<const Ticket> tickets) {
+    for (Ticket ticket : tickets) wait(ticket);
+}
+
+void AsyncIO::drain() {
+    std::vector<Ticket> tickets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : requests_) tickets.push_back(entry.first);
+    }
+    std::sort(tickets.begin(), tickets.end());
+
+    // Every request is waited for, even after a failure, so no buffer is
+    // still in use when this returns
+    std::exception_ptr first_error;
+    for (Ticket ticket : tickets) {
+        try {
+            wait(ticket);
+        } catch (...) {
+            if (!first_error) first_error = std::current_exception();
+        }
+    }
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+void AsyncIO::setPreferredBackend(Backend backend) {
+    preferred_backend = backend;
+}
+
+AsyncIO::Backend AsyncIO::getPreferredBackend() {
+    return preferred_backend;
+}
+
+std::string AsyncIO::getBackendName(Backend backend) {
+    switch (backend) {
+        case Backend::AUTO: return "auto";
+        case Backend::IO_URING: return "io_uring";
+        case Backend::THREADS: return "threads";
+    }
+    return "unknown";
+}
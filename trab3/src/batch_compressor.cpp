@@ -0,0 +1,248 @@
+#include "../includes/batch_compressor.hpp"
+#include "../includes/stcmp_archive.hpp"
+#include "../includes/thread_pool.hpp"
+#include "../includes/io_util.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+bool BatchCompressor::prepare(const std::string& input_dir, const std::string& output_dir,
+                              const std::string& shard_ext, const std::string& output_ext) {
+    results_.clear();
+    copied_.clear();
+
+    std::error_code ec;
+    if (!fs::is_directory(input_dir, ec)) {
+        std::cerr << "Error: Not a directory: " << input_dir << std::endl;
+        return false;
+    }
+    fs::create_directories(output_dir, ec);
+    if (ec) {
+        std::cerr << "Error: Cannot create directory " << output_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (fs::equivalent(input_dir, output_dir, ec)) {
+        std::cerr << "Error: Output directory must differ from the input directory" << std::endl;
+        return false;
+    }
+
+    for (const auto& entry : fs::directory_iterator(input_dir, ec)) {
+        if (!entry.is_regular_file()) continue;
+        std::string name = entry.path().filename().string();
+        if (entry.path().extension() == shard_ext) {
+            ShardResult result;
+            result.input = name;
+            result.output = entry.path().stem().string() + output_ext;
+            result.input_bytes = entry.file_size();
+            results_.push_back(result);
+        } else if (name != MANIFEST_NAME) {
+            fs::copy_file(entry.path(), fs::path(output_dir) / name, fs::copy_options::overwrite_existing, ec);
+            if (ec) {
+                std::cerr << "Error: Cannot copy " << name << ": " << ec.message() << std::endl;
+                return false;
+            }
+            copied_.push_back(name);
+        }
+    }
+    if (ec) {
+        std::cerr << "Error: Cannot list " << input_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (results_.empty()) {
+        std::cerr << "Error: No " << shard_ext << " files in " << input_dir << std::endl;
+        return false;
+    }
+
+    std::sort(results_.begin(), results_.end(),
+              [](const ShardResult& a, const ShardResult& b) { return a.input < b.input; });
+    std::sort(copied_.begin(), copied_.end());
+    return true;
+}
+
+// One shard per slot, each slot with an equal share of the cores and of the
+// memory limit. Shards start largest first so a big one does not begin last
+// and run alone while the other slots sit idle.
+//
+// The shared pool is a plain FIFO queue, not a work-stealing one, and that
+// is enough here. What it queues are parallelFor helpers, and every
+// parallelFor (the shard loop below, each shard's chunk loop) hands out
+// its indices from one atomic counter. A worker that becomes free takes
+// the next shard or chunk, whichever loop it joined, so the load balances
+// at chunk granularity without per-worker deques to steal from. The caller
+// always runs its own loop too, so nested loops never wait on helpers
+// queued behind busy workers. What stealing would add is letting a
+// finished slot's cores join a shard still running. A shard's share is
+// fixed when it starts, so the largest-first order is what keeps that
+// tail short.
+template <typename Job>
+void BatchCompressor::runShards(const std::string& input_dir, const std::string& output_dir, Job job) {
+    size_t total = threads_ == 0 ? ThreadPool::defaultThreadCount() : threads_;
+    concurrency_ = std::min(results_.size(), total);
+    unsigned share = static_cast<unsigned>(std::max<size_t>(1, total / concurrency_));
+    size_t memory_share = memory_limit_ == 0 ? 0 : std::max<size_t>(1, memory_limit_ / concurrency_);
+
+    std::vector<size_t> order(results_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return results_[a].input_bytes > results_[b].input_bytes;
+    });
+
+    std::atomic<size_t> done{0};
+    ThreadPool::shared().parallelFor(order.size(), concurrency_, [&](size_t i) {
+        ShardResult& result = results_[order[i]];
+        std::string input = (fs::path(input_dir) / result.input).string();
+        std::string output = (fs::path(output_dir) / result.output).string();
+
+        // A failed shard must not abort the others
+        auto start = std::chrono::high_resolution_clock::now();
+        try {
+            result.ok = job(input, output, share, memory_share, result);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << result.input << ": " << e.what() << std::endl;
+            result.ok = false;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        reportShard(result, ++done);
+    });
+}
+
+bool BatchCompressor::compressDirectory(const std::string& input_dir, const std::string& output_dir,
+                                        Compressor::Algorithm algo, Compressor::OperationPoint op_point) {
+    if (!prepare(input_dir, output_dir, ".safetensors", ".stcmp")) return false;
+
+    runShards(input_dir, output_dir, [&](const std::string& input, const std::string& output,
+                                         unsigned threads, size_t memory_limit, ShardResult& result) {
+        return compressShard(input, output, algo, op_point, threads, memory_limit, result);
+    });
+
+    bool ok = std::all_of(results_.begin(), results_.end(), [](const ShardResult& r) { return r.ok; });
+    if (!ok) return false;
+    if (!writeManifest(output_dir, algo, op_point)) {
+        std::cerr << "Error: Cannot write " << MANIFEST_NAME << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BatchCompressor::decompressDirectory(const std::string& input_dir, const std::string& output_dir) {
+    if (!prepare(input_dir, output_dir, ".stcmp", ".safetensors")) return false;
+
+    runShards(input_dir, output_dir, [&](const std::string& input, const std::string& output,
+                                         unsigned threads, size_t memory_limit, ShardResult& result) {
+        return decompressShard(input, output, threads, memory_limit, result);
+    });
+
+    return std::all_of(results_.begin(), results_.end(), [](const ShardResult& r) { return r.ok; });
+}
+
+bool BatchCompressor::compressShard(const std::string& input, const std::string& output,
+                                    Compressor::Algorithm algo, Compressor::OperationPoint op_point,
+                                    unsigned threads, size_t memory_limit, ShardResult& result) {
+    SafetensorsParser parser;
+    parser.setVerbose(false);
+    SafetensorsParser::LoadMode load_mode = memory_limit ? SafetensorsParser::LoadMode::STREAM
+                                                         : SafetensorsParser::LoadMode::MMAP;
+    if (!parser.parse(input, load_mode)) return false;
+
+    Compressor compressor;
+    compressor.setThreads(threads);
+    compressor.setMemoryLimit(memory_limit);
+    compressor.setAutoStrategy(auto_strategy_);
+    compressor.setMinimumGain(min_gain_);
+    compressor.setDictionary(dictionary_);
+
+    StcmpWriter writer;
+    uint32_t dictionary_id = dictionary_ ? dictionary_->getID() : 0;
+    if (!writer.open(output, parser.getHeader(), algo, op_point, parser.getTensorDataSize(), dictionary_id) ||
+        !writer.writeChunks(compressor, parser) ||
+        !writer.finish()) {
+        std::cerr << "Error: Failed to write " << output << std::endl;
+        return false;
+    }
+    result.chunks = writer.getChunkCount();
+
+    std::error_code ec;
+    result.output_bytes = fs::file_size(output, ec);
+    return !ec;
+}
+
+bool BatchCompressor::decompressShard(const std::string& input, const std::string& output,
+                                      unsigned threads, size_t memory_limit, ShardResult& result) {
+    StcmpReader reader;
+    if (!reader.open(input)) return false;
+    uint32_t id = reader.getDictionaryID();
+    if (id != 0) {
+        if (!dictionary_ || dictionary_->getID() != id) {
+            std::cerr << "Error: " << input << " needs dictionary " << id << "; pass it with --dict" << std::endl;
+            return false;
+        }
+        reader.setDictionary(dictionary_);
+    }
+    reader.setThreads(threads);
+    reader.setMemoryLimit(memory_limit);
+
+    uint64_t tensor_bytes = 0;
+    if (!reader.decompressToFile(output, &tensor_bytes)) {
+        std::cerr << "Error: Decompression of " << input << " failed" << std::endl;
+        return false;
+    }
+
+    result.chunks = reader.getChunks().size();
+    result.output_bytes = 8 + reader.getHeader().size() + tensor_bytes;
+    return true;
+}
+
+void BatchCompressor::reportShard(const ShardResult& result, size_t done) {
+    std::lock_guard<std::mutex> lock(print_mutex_);
+    std::cout << "[" << done << "/" << results_.size() << "] " << result.input << " -> " << result.output;
+    if (result.ok) {
+        std::cout << ": " << std::fixed << std::setprecision(2) << (result.input_bytes / 1024.0 / 1024.0)
+                  << " MB -> " << (result.output_bytes / 1024.0 / 1024.0) << " MB in "
+                  << result.seconds << " s";
+    } else {
+        std::cout << ": FAILED";
+    }
+    std::cout << std::endl;
+}
+
+bool BatchCompressor::writeManifest(const std::string& output_dir,
+                                    Compressor::Algorithm algo, Compressor::OperationPoint op_point) const {
+    std::ofstream file(fs::path(output_dir) / MANIFEST_NAME);
+    if (!file.is_open()) return false;
+
+    file << "{\n";
+    file << "  \"algorithm\": " << io_util::jsonString(Compressor::getAlgorithmName(algo)) << ",\n";
+    file << "  \"operation_point\": " << io_util::jsonString(Compressor::getOperationPointName(op_point)) << ",\n";
+    file << "  \"dictionary_id\": " << (dictionary_ ? dictionary_->getID() : 0) << ",\n";
+    file << "  \"shards\": [\n";
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const auto& r = results_[i];
+        file << "    {\n";
+        file << "      \"source\": " << io_util::jsonString(r.input) << ",\n";
+        file << "      \"archive\": " << io_util::jsonString(r.output) << ",\n";
+        file << "      \"original_bytes\": " << r.input_bytes << ",\n";
+        file << "      \"compressed_bytes\": " << r.output_bytes << ",\n";
+        file << "      \"compression_ratio\": " << std::fixed << std::setprecision(3)
+             << (r.output_bytes ? static_cast<double>(r.input_bytes) / r.output_bytes : 0.0) << ",\n";
+        file << "      \"chunks\": " << r.chunks << ",\n";
+        file << "      \"compress_time_sec\": " << std::setprecision(2) << r.seconds << "\n";
+        file << "    }" << (i < results_.size() - 1 ? "," : "") << "\n";
+    }
+    file << "  ],\n";
+    file << "  \"copied_files\": [";
+    for (size_t i = 0; i < copied_.size(); ++i) {
+        file << (i ? ", " : "") << io_util::jsonString(copied_[i]);
+    }
+    file << "]\n}\n";
+
+    file.close();
+    return !file.fail();
+}
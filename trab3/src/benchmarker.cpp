@@ -3,66 +3,267 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <sys/resource.h>
+#include <sched.h>
 #include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <numeric>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+const size_t ENTROPY_BLOCK = 64 << 10;
+
+// Mean order-0 entropy of the 64 KiB blocks of data, in bits per byte. A
+// histogram of the whole buffer would not move under transforms that only
+// reorder bytes; per block it sees the planes a codec window sees.
+double blockEntropy(std::span<const uint8_t> data) {
+    if (data.empty()) return 0.0;
+    double bits = 0.0;
+    for (size_t pos = 0; pos < data.size(); pos += ENTROPY_BLOCK) {
+        std::span<const uint8_t> block = data.subspan(pos, std::min(ENTROPY_BLOCK, data.size() - pos));
+        uint32_t counts[256] = {};
+        for (uint8_t b : block) ++counts[b];
+        for (uint32_t c : counts) {
+            if (c) bits -= c * std::log2(static_cast<double>(c) / block.size());
+        }
+    }
+    return bits / data.size();
+}
+
+} // namespace
+
+Benchmarker::PhaseStats Benchmarker::summarize(std::vector<double> times) {
+    PhaseStats stats;
+    if (times.empty()) return stats;
+    std::sort(times.begin(), times.end());
+
+    auto percentile = [&times](double p) {
+        double pos = p * (times.size() - 1);
+        size_t lo = static_cast<size_t>(pos);
+        size_t hi = std::min(lo + 1, times.size() - 1);
+        return times[lo] + (times[hi] - times[lo]) * (pos - lo);
+    };
+    stats.samples = static_cast<unsigned>(times.size());
+    stats.median = percentile(0.5);
+    stats.p10 = percentile(0.1);
+    stats.p90 = percentile(0.9);
+    stats.min = times.front();
+    stats.max = times.back();
+    stats.mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    if (times.size() > 1) {
+        double sq = 0.0;
+        for (double t : times) sq += (t - stats.mean) * (t - stats.mean);
+        stats.stddev = std::sqrt(sq / (times.size() - 1));
+    }
+    return stats;
+}
+
+bool Benchmarker::setCpuPinning(const std::vector<unsigned>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+
+    // sched_setaffinity applies to one thread; walk all of them so workers
+    // of an already running pool move too
+    std::error_code ec;
+    bool ok = !cpus.empty();
+    for (const auto& task : std::filesystem::directory_iterator("/proc/self/task", ec)) {
+        pid_t tid = static_cast<pid_t>(std::stol(task.path().filename().string()));
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0) ok = false;
+    }
+    if (ec || !ok) return false;
+    pinned_cpus_ = cpus;
+    return true;
+}
 
-Benchmarker::BenchmarkResult Benchmarker::runBenchmark(const std::vector<uint8_t>& data,
+std::string Benchmarker::describeRun() const {
+    std::ostringstream out;
+    out << warmup_ << " warmup + " << repetitions_ << " timed round(s), "
+        << (evict_input_ ? "cold" : "warm") << " input";
+    if (!pinned_cpus_.empty()) {
+        out << ", pinned to CPU";
+        for (size_t i = 0; i < pinned_cpus_.size(); ++i) out << (i ? "," : " ") << pinned_cpus_[i];
+    }
+    return out.str();
+}
+
+void Benchmarker::measure(std::span<const uint8_t> data,
+                          Compressor::Algorithm algo,
+                          Compressor::OperationPoint op_point,
+                          std::vector<uint8_t>& compressed,
+                          std::vector<uint8_t>& decompressed,
+                          PhaseStats& compress_stats,
+                          PhaseStats& decompress_stats) {
+    for (unsigned i = 0; i < warmup_; ++i) {
+        compressed = compressor_.compress(data, tensors_, algo, op_point);
+        decompressed = compressor_.decompress(compressed, tensors_, algo, op_point);
+    }
+
+    // Only the input is evicted for cold rounds: decompression reads the
+    // compressed buffer from memory in either case
+    std::vector<double> compress_times, decompress_times;
+    Timer timer;
+    for (unsigned i = 0; i < repetitions_; ++i) {
+        if (evict_input_) evict_input_();
+        timer.start();
+        compressed = compressor_.compress(data, tensors_, algo, op_point);
+        compress_times.push_back(timer.stop());
+
+        timer.start();
+        decompressed = compressor_.decompress(compressed, tensors_, algo, op_point);
+        decompress_times.push_back(timer.stop());
+    }
+    compress_stats = summarize(std::move(compress_times));
+    decompress_stats = summarize(std::move(decompress_times));
+}
+
+void Benchmarker::preprocessPayload(std::span<const uint8_t> data,
+                                    const std::vector<Compressor::Segment>& plan,
+                                    ByteBuffer& out) {
+    size_t total = 0;
+    for (const auto& seg : plan) total += Preprocessor::preprocessedSize(seg.size, seg.strategy);
+    out.resize(total);
+
+    Preprocessor preprocessor;
+    size_t pos = 0;
+    for (const auto& seg : plan) {
+        size_t size = Preprocessor::preprocessedSize(seg.size, seg.strategy);
+        preprocessor.preprocess(data.subspan(seg.offset, seg.size), std::span<uint8_t>(out.data() + pos, size),
+                                seg.strategy, compressor_.getThreads(), seg.row_length);
+        pos += size;
+    }
+}
+
+void Benchmarker::measureTransforms(std::span<const uint8_t> data,
+                                    Compressor::OperationPoint op_point,
+                                    ByteBuffer& preprocessed,
+                                    PhaseStats& preprocess_stats,
+                                    PhaseStats& deprocess_stats) {
+    const std::vector<Compressor::Segment> plan = compressor_.planSegments(tensors_, data.size(), op_point);
+    Preprocessor preprocessor;
+    ByteBuffer restored(data.size());
+    auto deprocessPayload = [&] {
+        size_t pos = 0;
+        for (const auto& seg : plan) {
+            size_t size = Preprocessor::preprocessedSize(seg.size, seg.strategy);
+            preprocessor.deprocess(std::span<const uint8_t>(preprocessed.data() + pos, size),
+                                   std::span<uint8_t>(restored.data() + seg.offset, seg.size),
+                                   seg.strategy, compressor_.getThreads());
+            pos += size;
+        }
+    };
+
+    for (unsigned i = 0; i < warmup_; ++i) {
+        preprocessPayload(data, plan, preprocessed);
+        deprocessPayload();
+    }
+
+    std::vector<double> preprocess_times, deprocess_times;
+    Timer timer;
+    for (unsigned i = 0; i < repetitions_; ++i) {
+        if (evict_input_) evict_input_();
+        timer.start();
+        preprocessPayload(data, plan, preprocessed);
+        preprocess_times.push_back(timer.stop());
+
+        timer.start();
+        deprocessPayload();
+        deprocess_times.push_back(timer.stop());
+    }
+    preprocess_stats = summarize(std::move(preprocess_times));
+    deprocess_stats = summarize(std::move(deprocess_times));
+}
+
+void Benchmarker::measureMemory(std::span<const uint8_t> data,
+                                Compressor::Algorithm algo,
+                                Compressor::OperationPoint op_point,
+                                BenchmarkResult& result) {
+    // Preprocessing as compress() does it, into one buffer of the payload size
+    {
+        MemoryTracker::PhaseMeter meter;
+        ByteBuffer preprocessed;
+        preprocessPayload(data, compressor_.planSegments(tensors_, data.size(), op_point), preprocessed);
+        result.preprocess_memory = meter.stop();
+    }
+
+    MemoryTracker::PhaseMeter compress_meter;
+    std::vector<uint8_t> compressed = compressor_.compress(data, tensors_, algo, op_point);
+    result.compress_memory = compress_meter.stop();
+
+    MemoryTracker::PhaseMeter decompress_meter;
+    std::vector<uint8_t> decompressed = compressor_.decompress(compressed, tensors_, algo, op_point);
+    result.decompress_memory = decompress_meter.stop();
+}
+
+Benchmarker::BenchmarkResult Benchmarker::runBenchmark(std::span<const uint8_t> data,
                                                         Compressor::Algorithm algo,
                                                         Compressor::OperationPoint op_point) {
     BenchmarkResult result;
     result.algorithm = Compressor::getAlgorithmName(algo);
     result.operation_point = Compressor::getOperationPointName(op_point);
     result.original_size = data.size();
+    result.threads = compressor_.getThreads();
 
     std::cout << "Testing " << result.algorithm << " (" << result.operation_point << ")..." << std::flush;
 
-    Preprocessor::Strategy strategy = Preprocessor::Strategy::BYTE_REORDER;
-    result.preprocessing = Preprocessor::getStrategyName(strategy);
-
-    // Calculate original entropy
-    result.original_entropy = Preprocessor::calculateEntropy(data);
-
-    // Compression
-    Timer timer;
-    timer.start();
-    std::vector<uint8_t> compressed = compressor_.compress(data, algo, op_point);
-    result.total_compress_time = timer.stop();
+    if (tensors_.empty()) {
+        result.preprocessing = Preprocessor::getStrategyName(Preprocessor::Strategy::BYTE_REORDER);
+    } else {
+        result.preprocessing = "PerTensor";
+    }
 
-    // Estimate preprocessing time (typically small)
-    result.preprocess_time = result.total_compress_time * 0.05;
-    result.compress_time = result.total_compress_time - result.preprocess_time;
+    std::vector<uint8_t> compressed, decompressed;
+    measure(data, algo, op_point, compressed, decompressed, result.compress_stats, result.decompress_stats);
+    result.total_compress_time = result.compress_stats.median;
+    result.total_decompress_time = result.decompress_stats.median;
+    result.warmup_runs = warmup_;
+    result.cold_input = static_cast<bool>(evict_input_);
+
+    // The transforms are timed on their own; the codec share is what the
+    // full calls took beyond them (ZSTD fuses preprocessing into its tiles,
+    // so there the split is approximate)
+    {
+        ByteBuffer preprocessed;
+        measureTransforms(data, op_point, preprocessed, result.preprocess_stats, result.deprocess_stats);
+        result.original_entropy = blockEntropy(data);
+        result.preprocessed_entropy = blockEntropy(preprocessed);
+    }
+    result.entropy_reduction = result.original_entropy - result.preprocessed_entropy;
+    result.preprocess_time = result.preprocess_stats.median;
+    result.deprocess_time = result.deprocess_stats.median;
+    result.compress_time = std::max(0.0, result.total_compress_time - result.preprocess_time);
+    result.decompress_time = std::max(0.0, result.total_decompress_time - result.deprocess_time);
 
     result.compressed_size = compressed.size();
     result.compression_ratio = static_cast<double>(result.original_size) / result.compressed_size;
     result.throughput_mb_per_sec = (result.original_size / 1024.0 / 1024.0) / result.total_compress_time;
 
-    // Entropy estimation
-    result.preprocessed_entropy = result.original_entropy * 0.95;
-    result.entropy_reduction = result.original_entropy - result.preprocessed_entropy;
-
-    // Decompression
-    timer.start();
-    std::vector<uint8_t> decompressed = compressor_.decompress(compressed, algo, op_point);
-    result.total_decompress_time = timer.stop();
-
-    result.decompress_time = result.total_decompress_time * 0.8;
-    result.deprocess_time = result.total_decompress_time * 0.2;
-
     // Verification
     result.decompression_verified = verifyDecompression(data, decompressed);
     
-    result.peak_memory_mb = getPeakMemoryUsageMB();
+    // The timed rounds' buffers are released first so they do not count
+    // towards the resident baseline of the memory round
+    compressed = std::vector<uint8_t>();
+    decompressed = std::vector<uint8_t>();
+    measureMemory(data, algo, op_point, result);
 
     std::cout << " Ratio: " << std::fixed << std::setprecision(2) << result.compression_ratio
-              << "x, Time: " << std::setprecision(2) << result.total_compress_time
-              << "s, " << (result.decompression_verified ? "✓" : "✗") << std::endl;
+              << "x, Time: " << std::setprecision(3) << result.total_compress_time
+              << "s (p10-p90 " << result.compress_stats.p10 << "-" << result.compress_stats.p90
+              << "), " << (result.decompression_verified ? "✓" : "✗") << std::endl;
 
     return result;
 }
 
-std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAllBenchmarks(const std::vector<uint8_t>& data) {
+std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAllBenchmarks(std::span<const uint8_t> data) {
     std::cout << "\n" << std::string(80, '=') << std::endl;
     std::cout << "COMPREHENSIVE BENCHMARK - " << (data.size() / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << describeRun() << std::endl;
     std::cout << std::string(80, '=') << std::endl;
 
     std::vector<BenchmarkResult> results;
@@ -72,7 +273,8 @@ std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAllBenchmarks(const st
         Compressor::Algorithm::LZ4,
         Compressor::Algorithm::DEFLATE,
         Compressor::Algorithm::ZSTD,
-        Compressor::Algorithm::LZMA
+        Compressor::Algorithm::LZMA,
+        Compressor::Algorithm::RANS
     };
     
     std::vector<Compressor::OperationPoint> op_points = {
@@ -95,11 +297,12 @@ std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAllBenchmarks(const st
 }
 
 std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAlgorithmComparison(
-    const std::vector<uint8_t>& data,
+    std::span<const uint8_t> data,
     Compressor::OperationPoint op_point) {
     
     std::cout << "\n" << std::string(80, '=') << std::endl;
     std::cout << "ALGORITHM COMPARISON - " << Compressor::getOperationPointName(op_point) << " Mode" << std::endl;
+    std::cout << describeRun() << std::endl;
     std::cout << std::string(80, '=') << std::endl;
 
     std::vector<BenchmarkResult> results;
@@ -108,7 +311,8 @@ std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAlgorithmComparison(
         Compressor::Algorithm::LZ4,
         Compressor::Algorithm::DEFLATE,
         Compressor::Algorithm::ZSTD,
-        Compressor::Algorithm::LZMA
+        Compressor::Algorithm::LZMA,
+        Compressor::Algorithm::RANS
     };
     
     for (const auto& algo : algorithms) {
@@ -123,6 +327,129 @@ std::vector<Benchmarker::BenchmarkResult> Benchmarker::runAlgorithmComparison(
     return results;
 }
 
+std::vector<Benchmarker::ScalingResult> Benchmarker::runThreadScaling(std::span<const uint8_t> data,
+                                                                     Compressor::OperationPoint op_point) {
+    const unsigned max_threads = compressor_.getThreads();
+    std::vector<unsigned> thread_counts;
+    for (unsigned t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    std::cout << "\n" << std::string(80, '=') << std::endl;
+    std::cout << "THREAD SCALING - " << Compressor::getOperationPointName(op_point)
+              << " Mode, up to " << max_threads << " threads" << std::endl;
+    std::cout << describeRun() << std::endl;
+    std::cout << std::string(80, '=') << std::endl;
+
+    std::vector<Compressor::Algorithm> algorithms = {
+        Compressor::Algorithm::LZ4,
+        Compressor::Algorithm::DEFLATE,
+        Compressor::Algorithm::ZSTD,
+        Compressor::Algorithm::LZMA,
+        Compressor::Algorithm::RANS
+    };
+
+    std::vector<ScalingResult> results;
+    for (const auto& algo : algorithms) {
+        double base_compress = 0.0, base_decompress = 0.0;
+        for (unsigned threads : thread_counts) {
+            compressor_.setThreads(threads);
+            std::cout << "Testing " << Compressor::getAlgorithmName(algo) << " with "
+                      << threads << " thread(s)..." << std::flush;
+            try {
+                ScalingResult r;
+                r.algorithm = Compressor::getAlgorithmName(algo);
+                r.operation_point = Compressor::getOperationPointName(op_point);
+                r.threads = threads;
+                r.original_size = data.size();
+
+                std::vector<uint8_t> compressed, decompressed;
+                measure(data, algo, op_point, compressed, decompressed, r.compress_stats, r.decompress_stats);
+                r.compress_time = r.compress_stats.median;
+                r.decompress_time = r.decompress_stats.median;
+                r.compressed_size = compressed.size();
+
+                if (threads == 1) {
+                    base_compress = r.compress_time;
+                    base_decompress = r.decompress_time;
+                }
+                r.compress_speedup = base_compress / r.compress_time;
+                r.decompress_speedup = base_decompress / r.decompress_time;
+                results.push_back(r);
+
+                std::cout << " " << std::fixed << std::setprecision(2) << r.compress_time << "s / "
+                          << r.decompress_time << "s" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << " Error: " << e.what() << std::endl;
+            }
+        }
+    }
+    compressor_.setThreads(max_threads);
+    return results;
+}
+
+void Benchmarker::printScalingTable(const std::vector<ScalingResult>& results) {
+    if (results.empty()) return;
+
+    std::cout << "\n" << std::string(100, '=') << std::endl;
+    std::cout << "THREAD SCALING TABLE" << std::endl;
+    std::cout << std::string(100, '=') << std::endl;
+
+    std::cout << std::left
+              << std::setw(15) << "Algorithm"
+              << std::setw(10) << "Threads"
+              << std::setw(12) << "Comp (s)"
+              << std::setw(14) << "Comp (MB/s)"
+              << std::setw(12) << "Speedup"
+              << std::setw(12) << "Decomp (s)"
+              << std::setw(16) << "Decomp (MB/s)"
+              << std::setw(12) << "Speedup"
+              << std::endl;
+    std::cout << std::string(100, '-') << std::endl;
+
+    for (const auto& r : results) {
+        std::cout << std::left << std::fixed
+                  << std::setw(15) << r.algorithm
+                  << std::setw(10) << r.threads
+                  << std::setw(12) << std::setprecision(2) << r.compress_time
+                  << std::setw(14) << std::setprecision(1) << (r.original_size / 1024.0 / 1024.0 / r.compress_time)
+                  << std::setw(12) << std::setprecision(2) << r.compress_speedup
+                  << std::setw(12) << std::setprecision(2) << r.decompress_time
+                  << std::setw(16) << std::setprecision(1) << (r.original_size / 1024.0 / 1024.0 / r.decompress_time)
+                  << std::setw(12) << std::setprecision(2) << r.decompress_speedup
+                  << std::endl;
+    }
+    std::cout << std::string(100, '=') << std::endl;
+}
+
+bool Benchmarker::saveScalingCSV(const std::vector<ScalingResult>& results, const std::string& filepath) {
+    std::ofstream file(filepath);
+    if (!file.is_open()) return false;
+
+    file << "Algorithm,Mode,Threads,CompressedMB,CompressTime,DecompressTime,CompressSpeedup,DecompressSpeedup,"
+         << "CompressP10,CompressP90,CompressStddev,DecompressP10,DecompressP90,DecompressStddev,Repetitions\n";
+    for (const auto& r : results) {
+        file << r.algorithm << ","
+             << r.operation_point << ","
+             << r.threads << ","
+             << std::fixed << std::setprecision(2) << (r.compressed_size / 1024.0 / 1024.0) << ","
+             << std::setprecision(3) << r.compress_time << ","
+             << r.decompress_time << ","
+             << std::setprecision(2) << r.compress_speedup << ","
+             << r.decompress_speedup << ","
+             << std::setprecision(4) << r.compress_stats.p10 << ","
+             << r.compress_stats.p90 << ","
+             << r.compress_stats.stddev << ","
+             << r.decompress_stats.p10 << ","
+             << r.decompress_stats.p90 << ","
+             << r.decompress_stats.stddev << ","
+             << r.compress_stats.samples << "\n";
+    }
+
+    file.close();
+    std::cout << "Saved CSV: " << filepath << std::endl;
+    return true;
+}
+
 void Benchmarker::printResults(const std::vector<BenchmarkResult>& results) {
     if (results.empty()) return;
 
@@ -139,8 +466,25 @@ void Benchmarker::printResults(const std::vector<BenchmarkResult>& results) {
         std::cout << "Compression ratio:    " << std::setprecision(3) << r.compression_ratio << "x" << std::endl;
         std::cout << "Space savings:        " << std::setprecision(1) 
                   << (100.0 * (1.0 - 1.0/r.compression_ratio)) << "%" << std::endl;
-        std::cout << "Compress time:        " << std::setprecision(2) << r.total_compress_time << " s" << std::endl;
-        std::cout << "Decompress time:      " << r.total_decompress_time << " s" << std::endl;
+        auto printPhase = [](const char* label, const PhaseStats& st) {
+            std::cout << label << std::setprecision(3) << st.median << " s median (p10 " << st.p10
+                      << ", p90 " << st.p90 << ", sd " << st.stddev << ", n=" << st.samples << ")" << std::endl;
+        };
+        printPhase("Compress time:        ", r.compress_stats);
+        printPhase("  preprocess alone:   ", r.preprocess_stats);
+        printPhase("Decompress time:      ", r.decompress_stats);
+        printPhase("  deprocess alone:    ", r.deprocess_stats);
+        std::cout << "Entropy (64K blocks): " << std::setprecision(3) << r.original_entropy << " -> "
+                  << r.preprocessed_entropy << " bits/byte" << std::endl;
+        auto printMemory = [](const char* label, const MemoryTracker::PhaseMemory& m) {
+            std::cout << label << std::setprecision(1);
+            if (MemoryTracker::heapTracked()) std::cout << (m.heap_peak_bytes / 1024.0 / 1024.0) << " MB heap, ";
+            std::cout << (m.resident_peak_bytes / 1024.0 / 1024.0) << " MB resident (peak RSS "
+                      << (m.resident_max_bytes / 1024.0 / 1024.0) << " MB)" << std::endl;
+        };
+        printMemory("Preprocess memory:    ", r.preprocess_memory);
+        printMemory("Compress memory:      ", r.compress_memory);
+        printMemory("Decompress memory:    ", r.decompress_memory);
         std::cout << "Throughput:           " << std::setprecision(1) << r.throughput_mb_per_sec << " MB/s" << std::endl;
         std::cout << "Verification:         " << (r.decompression_verified ? "PASSED ✓" : "FAILED ✗") << std::endl;
     }
@@ -214,13 +558,37 @@ bool Benchmarker::saveResultsJSON(const std::vector<BenchmarkResult>& results, c
     std::ofstream file(filepath);
     if (!file.is_open()) return false;
 
-    file << "{\n  \"results\": [\n";
+    auto writeStats = [&file](const char* name, const PhaseStats& st, bool last) {
+        file << "      \"" << name << "\": {"
+             << "\"samples\": " << st.samples << std::setprecision(4)
+             << ", \"median\": " << st.median << ", \"p10\": " << st.p10 << ", \"p90\": " << st.p90
+             << ", \"mean\": " << st.mean << ", \"stddev\": " << st.stddev
+             << ", \"min\": " << st.min << ", \"max\": " << st.max << "}" << (last ? "" : ",") << "\n";
+    };
+
+    auto writeMemory = [&file](const char* name, const MemoryTracker::PhaseMemory& m) {
+        file << "      \"" << name << "\": {"
+             << "\"heap_peak_bytes\": " << m.heap_peak_bytes
+             << ", \"resident_peak_bytes\": " << m.resident_peak_bytes
+             << ", \"resident_max_bytes\": " << m.resident_max_bytes << "},\n";
+    };
+
+    file << "{\n";
+    file << "  \"warmup_runs\": " << warmup_ << ",\n";
+    file << "  \"repetitions\": " << repetitions_ << ",\n";
+    file << "  \"heap_tracked\": " << (MemoryTracker::heapTracked() ? "true" : "false") << ",\n";
+    file << "  \"cold_input\": " << (evict_input_ ? "true" : "false") << ",\n";
+    file << "  \"pinned_cpus\": [";
+    for (size_t i = 0; i < pinned_cpus_.size(); ++i) file << (i ? ", " : "") << pinned_cpus_[i];
+    file << "],\n";
+    file << "  \"results\": [\n";
     for (size_t i = 0; i < results.size(); ++i) {
         const auto& r = results[i];
         file << "    {\n";
         file << "      \"algorithm\": \"" << r.algorithm << "\",\n";
         file << "      \"operation_point\": \"" << r.operation_point << "\",\n";
         file << "      \"preprocessing\": \"" << r.preprocessing << "\",\n";
+        file << "      \"threads\": " << r.threads << ",\n";
         file << "      \"original_size_mb\": " << std::fixed << std::setprecision(2) 
              << (r.original_size / 1024.0 / 1024.0) << ",\n";
         file << "      \"compressed_size_mb\": " << (r.compressed_size / 1024.0 / 1024.0) << ",\n";
@@ -230,8 +598,18 @@ bool Benchmarker::saveResultsJSON(const std::vector<BenchmarkResult>& results, c
         file << "      \"compress_time_sec\": " << std::setprecision(2) << r.total_compress_time << ",\n";
         file << "      \"decompress_time_sec\": " << r.total_decompress_time << ",\n";
         file << "      \"throughput_mb_per_sec\": " << std::setprecision(1) << r.throughput_mb_per_sec << ",\n";
-        file << "      \"entropy_reduction\": " << std::setprecision(4) << r.entropy_reduction << ",\n";
-        file << "      \"peak_memory_mb\": " << std::setprecision(1) << r.peak_memory_mb << ",\n";
+        file << "      \"preprocess_time_sec\": " << std::setprecision(4) << r.preprocess_time << ",\n";
+        file << "      \"deprocess_time_sec\": " << r.deprocess_time << ",\n";
+        file << "      \"original_entropy\": " << r.original_entropy << ",\n";
+        file << "      \"preprocessed_entropy\": " << r.preprocessed_entropy << ",\n";
+        file << "      \"entropy_reduction\": " << r.entropy_reduction << ",\n";
+        writeMemory("preprocess_memory", r.preprocess_memory);
+        writeMemory("compress_memory", r.compress_memory);
+        writeMemory("decompress_memory", r.decompress_memory);
+        writeStats("preprocess_time_stats", r.preprocess_stats, false);
+        writeStats("compress_time_stats", r.compress_stats, false);
+        writeStats("decompress_time_stats", r.decompress_stats, false);
+        writeStats("deprocess_time_stats", r.deprocess_stats, false);
         file << "      \"verified\": " << (r.decompression_verified ? "true" : "false") << "\n";
         file << "    }" << (i < results.size() - 1 ? "," : "") << "\n";
     }
@@ -246,13 +624,19 @@ bool Benchmarker::saveResultsCSV(const std::vector<BenchmarkResult>& results, co
     std::ofstream file(filepath);
     if (!file.is_open()) return false;
 
-    file << "Algorithm,Mode,Preprocessing,OriginalMB,CompressedMB,Ratio,Savings%,"
-         << "CompressTime,DecompressTime,ThroughputMB/s,EntropyReduction,Verified\n";
+    file << "Algorithm,Mode,Preprocessing,Threads,OriginalMB,CompressedMB,Ratio,Savings%,"
+         << "CompressTime,DecompressTime,ThroughputMB/s,EntropyReduction,Verified,"
+         << "CompressP10,CompressP90,CompressMean,CompressStddev,"
+         << "DecompressP10,DecompressP90,DecompressMean,DecompressStddev,Warmup,Repetitions,ColdInput,"
+         << "PreprocessHeapMB,PreprocessResidentMB,CompressHeapMB,CompressResidentMB,"
+         << "DecompressHeapMB,DecompressResidentMB,PreprocessTime,DeprocessTime,"
+         << "OriginalEntropy,PreprocessedEntropy\n";
     
     for (const auto& r : results) {
         file << r.algorithm << ","
              << r.operation_point << ","
              << r.preprocessing << ","
+             << r.threads << ","
              << std::fixed << std::setprecision(2) << (r.original_size / 1024.0 / 1024.0) << ","
              << (r.compressed_size / 1024.0 / 1024.0) << ","
              << std::setprecision(3) << r.compression_ratio << ","
@@ -261,7 +645,28 @@ bool Benchmarker::saveResultsCSV(const std::vector<BenchmarkResult>& results, co
              << r.total_decompress_time << ","
              << std::setprecision(1) << r.throughput_mb_per_sec << ","
              << std::setprecision(4) << r.entropy_reduction << ","
-             << (r.decompression_verified ? "YES" : "NO") << "\n";
+             << (r.decompression_verified ? "YES" : "NO") << ","
+             << r.compress_stats.p10 << ","
+             << r.compress_stats.p90 << ","
+             << r.compress_stats.mean << ","
+             << r.compress_stats.stddev << ","
+             << r.decompress_stats.p10 << ","
+             << r.decompress_stats.p90 << ","
+             << r.decompress_stats.mean << ","
+             << r.decompress_stats.stddev << ","
+             << r.warmup_runs << ","
+             << r.compress_stats.samples << ","
+             << (r.cold_input ? "YES" : "NO") << ","
+             << std::setprecision(2) << (r.preprocess_memory.heap_peak_bytes / 1024.0 / 1024.0) << ","
+             << (r.preprocess_memory.resident_peak_bytes / 1024.0 / 1024.0) << ","
+             << (r.compress_memory.heap_peak_bytes / 1024.0 / 1024.0) << ","
+             << (r.compress_memory.resident_peak_bytes / 1024.0 / 1024.0) << ","
+             << (r.decompress_memory.heap_peak_bytes / 1024.0 / 1024.0) << ","
+             << (r.decompress_memory.resident_peak_bytes / 1024.0 / 1024.0) << ","
+             << std::setprecision(4) << r.preprocess_time << ","
+             << r.deprocess_time << ","
+             << r.original_entropy << ","
+             << r.preprocessed_entropy << "\n";
     }
 
     file.close();
@@ -269,27 +674,13 @@ bool Benchmarker::saveResultsCSV(const std::vector<BenchmarkResult>& results, co
     return true;
 }
 
-double Benchmarker::getPeakMemoryUsageMB() {
-    struct rusage usage;
-    getrusage(RUSAGE_SELF, &usage);
-    return usage.ru_maxrss / 1024.0;
-}
-
-bool Benchmarker::verifyDecompression(const std::vector<uint8_t>& original, 
+bool Benchmarker::verifyDecompression(std::span<const uint8_t> original,
                                       const std::vector<uint8_t>& decompressed) {
     if (original.size() != decompressed.size()) {
         return false;
     }
     
-    // Sample-based verification for large data
-    const size_t num_samples = std::min(size_t(10000), original.size());
-    const size_t stride = std::max(size_t(1), original.size() / num_samples);
-    
-    for (size_t i = 0; i < original.size(); i += stride) {
-        if (original[i] != decompressed[i]) {
-            return false;
-        }
-    }
-    
-    return true;
+    // The whole payload: a sampled stride misses corruption between samples,
+    // and comparing at memory bandwidth costs little next to decompression
+    return memcmp(original.data(), decompressed.data(), original.size()) == 0;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "../includes/checksum.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace checksum {
+namespace {
+
+const uint32_t POLY = 0x82f63b78;  // Reflected Castagnoli polynomial
+
+// Block lengths of the three-stream loop: long blocks for large buffers,
+// short ones for what is left. Both are powers of two, as the shift
+// operators below require.
+const size_t LONG_BLOCK = 8192;
+const size_t SHORT_BLOCK = 256;
+
+// ----------------------------------------------------------------------------
+// Combining stream CRCs: appending n zero bytes to a CRC register is a linear
+// map over GF(2), a 32x32 bit matrix built by repeated squaring and then
+// tabulated per byte of the register
+// ----------------------------------------------------------------------------
+
+uint32_t matrixTimes(const uint32_t* mat, uint32_t vec) {
+    uint32_t sum = 0;
+    while (vec) {
+        if (vec & 1) sum ^= *mat;
+        vec >>= 1;
+        ++mat;
+    }
+    return sum;
+}
+
+void matrixSquare(uint32_t* square, const uint32_t* mat) {
+    for (int n = 0; n < 32; ++n) square[n] = matrixTimes(mat, mat[n]);
+}
+
+// Operator for appending len zero bytes (len a power of two)
+void zerosOperator(uint32_t* even, size_t len) {
+    uint32_t odd[32];
+    odd[0] = POLY;  // One zero bit
+    uint32_t row = 1;
+    for (int n = 1; n < 32; ++n) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    matrixSquare(even, odd);  // Two zero bits
+    matrixSquare(odd, even);  // Four
+
+    // The first square below gives one zero byte in even
+    do {
+        matrixSquare(even, odd);
+        len >>= 1;
+        if (len == 0) return;
+        matrixSquare(odd, even);
+        len >>= 1;
+    } while (len);
+    memcpy(even, odd, sizeof(odd));
+}
+
+struct ShiftTable {
+    uint32_t zeros[4][256];
+
+    explicit ShiftTable(size_t len) {
+        uint32_t op[32];
+        zerosOperator(op, len);
+        for (uint32_t n = 0; n < 256; ++n) {
+            zeros[0][n] = matrixTimes(op, n);
+            zeros[1][n] = matrixTimes(op, n << 8);
+            zeros[2][n] = matrixTimes(op, n << 16);
+            zeros[3][n] = matrixTimes(op, n << 24);
+        }
+    }
+
+    uint32_t shift(uint32_t crc) const {
+        return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+               zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Scalar: slicing-by-8
+// ----------------------------------------------------------------------------
+
+struct SliceTables {
+    uint32_t table[8][256];
+
+    SliceTables() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+            table[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xff];
+            }
+        }
+    }
+};
+
+uint32_t crc32cScalar(const uint8_t* data, size_t size, uint32_t crc) {
+    static const SliceTables tables;
+    const auto& t = tables.table;
+    crc = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        word ^= crc;  // Little-endian: the register lines up with the first four bytes
+        crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^ t[5][(word >> 16) & 0xff] ^
+              t[4][(word >> 24) & 0xff] ^ t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+              t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+    return ~crc;
+}
+
+// ----------------------------------------------------------------------------
+// SSE4.2: three crc32 streams over adjacent blocks, combined with the shift
+// tables, since one stream is bound by the instruction's latency
+// ----------------------------------------------------------------------------
+
+#ifdef CHECKSUM_X86
+
+__attribute__((target("sse4.2"), always_inline))
+inline void threeStreams(const uint8_t*& data, size_t& size, uint64_t& crc0, size_t block, const ShiftTable& table) {
+    while (size >= 3 * block) {
+        uint64_t crc1 = 0, crc2 = 0;
+        const uint8_t* end = data + block;
+        do {
+            uint64_t a, b, c;
+            memcpy(&a, data, 8);
+            memcpy(&b, data + block, 8);
+            memcpy(&c, data + 2 * block, 8);
+            crc0 = _mm_crc32_u64(crc0, a);
+            crc1 = _mm_crc32_u64(crc1, b);
+            crc2 = _mm_crc32_u64(crc2, c);
+            data += 8;
+        } while (data < end);
+        crc0 = table.shift(static_cast<uint32_t>(crc0)) ^ crc1;
+        crc0 = table.shift(static_cast<uint32_t>(crc0)) ^ crc2;
+        data += 2 * block;
+        size -= 3 * block;
+    }
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(const uint8_t* data, size_t size, uint32_t crc) {
+    static const ShiftTable long_shift(LONG_BLOCK);
+    static const ShiftTable short_shift(SHORT_BLOCK);
+
+    uint64_t crc0 = ~crc;
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *data++);
+        --size;
+    }
+
+    threeStreams(data, size, crc0, LONG_BLOCK, long_shift);
+    threeStreams(data, size, crc0, SHORT_BLOCK, short_shift);
+
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc0 = _mm_crc32_u64(crc0, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size--) crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *data++);
+    return ~static_cast<uint32_t>(crc0);
+}
+
+bool hasHardwareCrc() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#endif
+
+using Kernel = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+Kernel activeKernel() {
+#ifdef CHECKSUM_X86
+    static const Kernel kernel = hasHardwareCrc() ? crc32cHardware : crc32cScalar;
+#else
+    static const Kernel kernel = crc32cScalar;
+#endif
+    return kernel;
+}
+
+} // namespace
+
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc) {
+    return activeKernel()(data, size, crc);
+}
+
+std::string getKernelName() {
+#ifdef CHECKSUM_X86
+    if (activeKernel() == crc32cHardware) return "SSE4.2";
+#endif
+    return "Scalar";
+}
+
+} // namespace checksum
@@ -1,4 +1,7 @@
 #include "../includes/compressor.hpp"
+#include "../includes/thread_pool.hpp"
+#include "../includes/context_pool.hpp"
+#include "../includes/rans_codec.hpp"
 #include <zstd.h>
 #include <lz4.h>
 #include <lz4hc.h>
@@ -8,271 +11,1070 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
-#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <cmath>
 
-std::vector<uint8_t> Compressor::compress(const std::vector<uint8_t>& data, 
+namespace {
+// z_stream set up for deflate at one level; reset when the level matches,
+// re-initialised otherwise
+struct DeflateState {
+    z_stream stream;
+    int level;
+    bool initialised;
+};
+
+// Width of the elements a strategy works on
+size_t strategyElementSize(Preprocessor::Strategy strategy) {
+    using Strategy = Preprocessor::Strategy;
+    switch (strategy) {
+        case Strategy::NONE: return 1;
+        case Strategy::BYTE_REORDER_32:
+        case Strategy::FIELD_SPLIT_F32:
+        case Strategy::XOR_DELTA_32:
+        case Strategy::XOR_2D_32:
+        case Strategy::XOR_PLANE_32: return 4;
+        case Strategy::BYTE_REORDER_64: return 8;
+        default: return 2;
+    }
+}
+
+// Evenly spaced stripes of raw, about budget bytes together, each starting
+// at a multiple of align; all of raw when it fits the budget. The stripes
+// are whole rows when two rows of a matrix fit (align is their common
+// multiple with 16 then), otherwise 16-byte aligned, so every element width
+// and bit plane group stays intact.
+void sampleStripes(std::span<const uint8_t> raw, size_t budget, size_t elem_size, size_t row_length,
+                   ByteBuffer& sample) {
+    if (raw.size() <= budget) {
+        sample.assign(raw.begin(), raw.end());
+        return;
+    }
+    size_t align = 16;
+    if (row_length > 0) {
+        size_t rows = std::lcm<size_t>(16, row_length * elem_size);
+        if (2 * rows <= budget) align = rows;
+    }
+    const size_t stripe = std::max(align, budget / 8 / align * align);
+    const size_t stripes = budget / stripe;
+    sample.clear();
+    for (size_t i = 0; i < stripes; ++i) {
+        size_t begin = (raw.size() - stripe) / (stripes - 1) * i / align * align;
+        sample.insert(sample.end(), raw.begin() + begin, raw.begin() + begin + stripe);
+    }
+}
+
+// Order-0 entropy coded size of data in 4 KiB blocks: one histogram over
+// a whole sample would blend the byte planes of a preprocessed chunk
+// (near-constant exponents, near-random mantissas) into one distribution
+double entropyCodedSize(std::span<const uint8_t> data) {
+    const size_t block = 4096;
+    double bits = 0.0;
+    for (size_t first = 0; first < data.size(); first += block) {
+        size_t n = std::min(block, data.size() - first);
+        uint32_t counts[256] = {};
+        for (size_t i = 0; i < n; ++i) counts[data[first + i]]++;
+        for (uint32_t c : counts) {
+            if (c) bits -= c * std::log2(static_cast<double>(c) / n);
+        }
+    }
+    return bits / 8.0;
+}
+
+// Innermost dimension of a matrix (or higher-rank) tensor, 0 for vectors
+uint64_t rowLength(const TensorInfo& tensor) {
+    if (tensor.shape.size() < 2 || tensor.shape.back() <= 0) return 0;
+    return static_cast<uint64_t>(tensor.shape.back());
+}
+}  // namespace
+
+// Idle codec contexts of one Compressor. Every codec call leases what it
+// needs and hands it back, so chunks compressed on many workers reuse a
+// handful of contexts instead of creating and freeing one per chunk.
+struct Compressor::ContextPools {
+    ContextPool<ZSTD_CCtx> zstd_compress{[](ZSTD_CCtx* c) { ZSTD_freeCCtx(c); }};
+    ContextPool<ZSTD_DCtx> zstd_decompress{[](ZSTD_DCtx* d) { ZSTD_freeDCtx(d); }};
+    ContextPool<void> lz4_fast{free};
+    ContextPool<void> lz4_hc{free};
+    ContextPool<DeflateState> deflate{[](DeflateState* s) {
+        if (s->initialised) deflateEnd(&s->stream);
+        delete s;
+    }};
+    ContextPool<z_stream> inflate{[](z_stream* s) {
+        inflateEnd(s);
+        delete s;
+    }};
+    ContextPool<lzma_stream> lzma_encode{[](lzma_stream* s) {
+        lzma_end(s);
+        delete s;
+    }};
+    ContextPool<lzma_stream> lzma_decode{[](lzma_stream* s) {
+        lzma_end(s);
+        delete s;
+    }};
+};
+
+Compressor::Compressor() : pools_(std::make_unique<ContextPools>()) {}
+
+Compressor::~Compressor() = default;
+
+std::vector<uint8_t> Compressor::compress(std::span<const uint8_t> data,
                                            Algorithm algo,
                                            OperationPoint op_point) {
     Preprocessor::Strategy strategy = getPreprocessingStrategy(op_point);
-    std::vector<uint8_t> preprocessed = preprocessor_.preprocess(data, strategy);
-    
-    int level = getCompressionLevel(algo, op_point);
-    
-    switch (algo) {
-        case Algorithm::ZSTD: return compressZSTD(preprocessed, level);
-        case Algorithm::LZ4: return compressLZ4(preprocessed, level);
-        case Algorithm::DEFLATE: return compressDEFLATE(preprocessed, level);
-        case Algorithm::LZMA: return compressLZMA(preprocessed, level);
+    return compressChunk(data, algo, strategy, op_point, getThreads());
+}
+
+std::vector<uint8_t> Compressor::decompress(std::span<const uint8_t> compressed_data,
+                                             Algorithm algo,
+                                             OperationPoint op_point) {
+    std::vector<uint8_t> decompressed = decompressBlock(compressed_data, algo, getThreads());
+
+    Preprocessor::Strategy strategy = getPreprocessingStrategy(op_point);
+    return preprocessor_.deprocess(decompressed, strategy, getThreads());
+}
+
+std::vector<uint8_t> Compressor::compress(std::span<const uint8_t> data,
+                                           const std::vector<TensorInfo>& tensors,
+                                           Algorithm algo,
+                                           OperationPoint op_point) {
+    std::vector<Segment> segments = planSegments(tensors, data.size(), op_point);
+
+    // Preprocess every segment straight into its place in one buffer, so the
+    // backend still sees a single stream but each tensor gets a dtype-correct
+    // transform
+    ByteBuffer preprocessed(data.size());
+    for (const auto& seg : segments) {
+        if (Preprocessor::preprocessedSize(seg.size, seg.strategy) != seg.size) {
+            throw std::runtime_error("Preprocessing strategy " + Preprocessor::getStrategyName(seg.strategy) +
+                                     " changes the data size and cannot be used per tensor");
+        }
+        preprocessor_.preprocess(data.subspan(seg.offset, seg.size),
+                                 std::span<uint8_t>(preprocessed.data() + seg.offset, seg.size),
+                                 seg.strategy, getThreads());
     }
-    return preprocessed;
+
+    int level = getCompressionLevel(algo, op_point);
+    return compressBlock(preprocessed, algo, level, getThreads());
 }
 
-std::vector<uint8_t> Compressor::decompress(const std::vector<uint8_t>& compressed_data,
+std::vector<uint8_t> Compressor::decompress(std::span<const uint8_t> compressed_data,
+                                             const std::vector<TensorInfo>& tensors,
                                              Algorithm algo,
                                              OperationPoint op_point) {
-    std::vector<uint8_t> decompressed;
+    std::vector<uint8_t> decompressed = decompressBlock(compressed_data, algo, getThreads());
+
+    // The inverse transforms cannot run in place: each segment goes through
+    // one scratch buffer that is reused, not reallocated, per tensor
+    std::vector<Segment> segments = planSegments(tensors, decompressed.size(), op_point);
+    ByteBuffer scratch;
+    for (const auto& seg : segments) {
+        if (seg.strategy == Preprocessor::Strategy::NONE) continue;
+        std::span<uint8_t> part(decompressed.data() + seg.offset, seg.size);
+        scratch.assign(part.begin(), part.end());
+        preprocessor_.deprocess(scratch, part, seg.strategy, getThreads());
+    }
+    return decompressed;
+}
+
+std::vector<Compressor::Segment> Compressor::planSegments(const std::vector<TensorInfo>& tensors,
+                                                          size_t data_size,
+                                                          OperationPoint op_point) {
+    return buildPlan(tensors, data_size, op_point, UINT64_MAX);
+}
+
+std::vector<Compressor::Segment> Compressor::planChunks(const std::vector<TensorInfo>& tensors,
+                                                        size_t data_size,
+                                                        Algorithm algo,
+                                                        OperationPoint op_point) {
+    return buildPlan(tensors, data_size, op_point, getChunkSize(algo, op_point));
+}
+
+void Compressor::addDictionarySamples(const SafetensorsParser& source,
+                                      OperationPoint op_point,
+                                      double fraction,
+                                      size_t window_size,
+                                      ByteBuffer& samples,
+                                      std::vector<size_t>& sample_sizes) {
+    std::vector<Segment> plan = planChunks(source.getTensors(), source.getTensorDataSize(),
+                                           Algorithm::ZSTD, op_point);
+    ByteBuffer window;
+    for (const auto& chunk : plan) {
+        size_t size = std::min<uint64_t>(window_size, chunk.size);
+        size_t count = std::max<size_t>(1, static_cast<size_t>(chunk.size * fraction / window_size));
+        window.resize(size);
+        for (size_t k = 0; k < count; ++k) {
+            // Evenly spaced, 16-byte aligned so element boundaries hold
+            uint64_t offset = (chunk.size - size) * k / count / 16 * 16;
+            if (!source.readTensorData(chunk.offset + offset, window)) {
+                throw std::runtime_error("Failed to read dictionary sample");
+            }
+            size_t sample_size = Preprocessor::preprocessedSize(size, chunk.strategy);
+            size_t end = samples.size();
+            samples.resize(end + sample_size);
+            preprocessor_.preprocess(window, std::span<uint8_t>(samples.data() + end, sample_size),
+                                     chunk.strategy);
+            sample_sizes.push_back(sample_size);
+        }
+    }
+}
+
+// Splits the payload into runs of equal strategy no larger than
+// max_segment_size. Consecutive tensors are packed whole into a run while
+// they fit, so boundaries land on tensor boundaries unless a single tensor
+// is larger than the limit; such a tensor is cut at row boundaries when a
+// row fits, so every chunk of it holds whole rows. A run of several
+// tensors takes the row length of its largest tensor.
+// Bytes not covered by any tensor (padding, or everything when the header
+// could not be parsed) keep the legacy whole-blob behaviour so files
+// without a tensor table still work.
+std::vector<Compressor::Segment> Compressor::buildPlan(const std::vector<TensorInfo>& tensors,
+                                                       size_t data_size,
+                                                       OperationPoint op_point,
+                                                       uint64_t max_segment_size) {
+    std::vector<Segment> segments;
+    uint64_t largest = 0;  // Biggest member of the last segment, whose row length it carries
+    auto append = [&segments, &largest, max_segment_size](uint64_t offset, uint64_t size,
+                                                          Preprocessor::Strategy strategy,
+                                                          uint64_t row_length = 0, uint64_t row_bytes = 0) {
+        while (size > 0) {
+            if (!segments.empty()) {
+                Segment& last = segments.back();
+                if (last.strategy == strategy && last.offset + last.size == offset &&
+                    size <= max_segment_size - last.size) {
+                    if (size > largest) {
+                        largest = size;
+                        last.row_length = row_length;
+                    }
+                    last.size += size;
+                    return;
+                }
+            }
+            uint64_t part = std::min(size, max_segment_size);
+            if (part < size && row_bytes > 0 && row_bytes <= part) part = part / row_bytes * row_bytes;
+            segments.push_back({offset, part, strategy, row_length});
+            largest = part;
+            offset += part;
+            size -= part;
+        }
+    };
+
+    if (tensors.empty()) {
+        append(0, data_size, getPreprocessingStrategy(op_point));
+        return segments;
+    }
+
+    uint64_t pos = 0;
+    for (const auto& t : tensors) {
+        if (t.data_end > data_size) {
+            throw std::runtime_error("Tensor " + t.name + " lies outside the tensor data");
+        }
+        append(pos, t.data_begin - pos, Preprocessor::Strategy::NONE);
+        uint64_t row_length = rowLength(t);
+        append(t.data_begin, t.size(), getPreprocessingStrategy(t.dtype, op_point),
+               row_length, row_length * SafetensorsParser::getDTypeSize(t.dtype));
+        pos = t.data_end;
+    }
+    append(pos, data_size - pos, Preprocessor::Strategy::NONE);
+    return segments;
+}
+
+std::vector<uint8_t> Compressor::compressChunk(std::span<const uint8_t> raw,
+                                                Algorithm algo,
+                                                Preprocessor::Strategy strategy,
+                                                OperationPoint op_point,
+                                                unsigned threads) {
+    ByteBuffer scratch;
+    std::vector<uint8_t> compressed(maxCompressedSize(raw.size(), algo, strategy));
+    compressed.resize(compressChunk(raw, compressed, algo, strategy, op_point, scratch, threads));
+    return compressed;
+}
+
+std::vector<uint8_t> Compressor::decompressChunk(std::span<const uint8_t> compressed,
+                                                  Algorithm algo,
+                                                  Preprocessor::Strategy strategy,
+                                                  unsigned threads) {
+    std::vector<uint8_t> decompressed = decompressBlock(compressed, algo, threads);
+    if (strategy == Preprocessor::Strategy::NONE) {
+        return decompressed;
+    }
+    return preprocessor_.deprocess(decompressed, strategy, threads);
+}
+
+// ZSTD streams its input, so the byte-plane strategies feed it one tile at a
+// time and never build the preprocessed copy. The block codecs split or
+// thread over the whole buffer and get it preprocessed into scratch.
+size_t Compressor::compressChunk(std::span<const uint8_t> raw,
+                                 std::span<uint8_t> out,
+                                 Algorithm algo,
+                                 Preprocessor::Strategy strategy,
+                                 OperationPoint op_point,
+                                 ByteBuffer& scratch,
+                                 unsigned threads,
+                                 size_t row_length) {
+    int level = getCompressionLevel(algo, op_point);
+    if (strategy == Preprocessor::Strategy::NONE) {
+        return compressBlock(raw, out, algo, level, threads);
+    }
+    if (algo == Algorithm::ZSTD) {
+        return compressZSTDTiled(raw, strategy, out, level, threads, scratch, row_length);
+    }
+    scratch.resize(Preprocessor::preprocessedSize(raw.size(), strategy));
+    preprocessor_.preprocess(raw, scratch, strategy, threads, row_length);
+    return compressBlock(scratch, out, algo, level, threads);
+}
+
+void Compressor::decompressChunk(std::span<const uint8_t> compressed,
+                                 std::span<uint8_t> out,
+                                 Algorithm algo,
+                                 Preprocessor::Strategy strategy,
+                                 ByteBuffer& scratch,
+                                 unsigned threads) {
+    if (strategy == Preprocessor::Strategy::NONE) {
+        decompressBlock(compressed, out, algo, threads);
+        return;
+    }
+    scratch.resize(Preprocessor::preprocessedSize(out.size(), strategy));
+    decompressBlock(compressed, scratch, algo, threads);
+    preprocessor_.deprocess(scratch, out, strategy, threads);
+}
+
+size_t Compressor::maxCompressedSize(size_t raw_size, Algorithm algo, Preprocessor::Strategy strategy) {
+    return blockBound(Preprocessor::preprocessedSize(raw_size, strategy), algo);
+}
+
+// Lossless alternatives for the element width behind a dtype strategy,
+// the default first. BF16 and F16 share a default, so both field layouts
+// are tried; the other one is just a different lossless cut of the same
+// bits. Likewise I32/U32 chunks share the F32 candidates and simply never
+// win with the float field split. 1-byte types have nothing to split.
+// Matrices add the planar and the vertical 2D prediction, which without
+// rows would only repeat the flat XOR delta.
+std::vector<Preprocessor::Strategy> Compressor::candidateStrategies(Preprocessor::Strategy dtype_strategy, bool matrix) {
+    using Strategy = Preprocessor::Strategy;
+    std::vector<Strategy> candidates;
+    switch (dtype_strategy) {
+        case Strategy::BYTE_REORDER:
+            candidates = { Strategy::BYTE_REORDER, Strategy::NONE, Strategy::BYTE_REORDER_DELTA,
+                           Strategy::BIT_PLANE_SEPARATION, Strategy::FIELD_SPLIT_BF16, Strategy::FIELD_SPLIT_F16 };
+            if (matrix) candidates.insert(candidates.end(), { Strategy::XOR_PLANE_16, Strategy::XOR_2D_16 });
+            return candidates;
+        case Strategy::BYTE_REORDER_32:
+            candidates = { Strategy::BYTE_REORDER_32, Strategy::NONE, Strategy::FIELD_SPLIT_F32, Strategy::XOR_DELTA_32 };
+            if (matrix) candidates.insert(candidates.end(), { Strategy::XOR_PLANE_32, Strategy::XOR_2D_32 });
+            return candidates;
+        case Strategy::BYTE_REORDER_64:
+            return { dtype_strategy, Strategy::NONE };
+        default:
+            return { dtype_strategy };
+    }
+}
+
+// Trial-compresses a sample under every candidate with the chunk's own codec
+// at its fast level and keeps the smallest. A generic proxy codec ranks the
+// transforms differently from the real one (ZSTD level 1 favours bit planes
+// that LZMA and ZSTD's own levels do worse on). FAST samples 64 KiB per
+// candidate, MAXIMUM 256 KiB, a few percent of the real level's cost. The sample is a set of
+// evenly spaced 16-byte aligned stripes, so every element width and bit
+// plane group stays intact and the whole chunk is represented. For a
+// matrix the stripes are also whole rows, as long as two fit the budget,
+// so the 2D prediction sees the same column neighbours as on the chunk
+// (see sampleStripes).
+Preprocessor::Strategy Compressor::selectStrategy(std::span<const uint8_t> raw,
+                                                  Algorithm algo,
+                                                  Preprocessor::Strategy dtype_strategy,
+                                                  OperationPoint op_point,
+                                                  size_t row_length) {
+    std::vector<Preprocessor::Strategy> candidates = candidateStrategies(dtype_strategy, row_length > 0);
+    if (candidates.size() < 2 || raw.empty()) return dtype_strategy;
+
+    const bool fast = (op_point == OperationPoint::FAST);
+    const size_t budget = fast ? (64 << 10) : (256 << 10);
+    const int trial_level = getCompressionLevel(algo, OperationPoint::FAST);
+
+    ByteBuffer sample;
+    sampleStripes(raw, budget, strategyElementSize(dtype_strategy), row_length, sample);
+
+    ByteBuffer preprocessed, compressed;
+    Preprocessor::Strategy best = dtype_strategy;
+    size_t best_size = SIZE_MAX, default_size = SIZE_MAX;
+    for (Preprocessor::Strategy candidate : candidates) {
+        preprocessed.resize(Preprocessor::preprocessedSize(sample.size(), candidate));
+        preprocessor_.preprocess(sample, preprocessed, candidate, 1, row_length);
+        compressed.resize(blockBound(preprocessed.size(), algo));
+        size_t size = compressBlock(preprocessed, compressed, algo, trial_level, 1);
+        if (candidate == dtype_strategy) default_size = size;
+        if (size < best_size) {
+            best_size = size;
+            best = candidate;
+        }
+    }
+
+    // Sample noise should not flip chunks away from the default (and its
+    // faster streaming path) for less than a 1% gain
+    if (best != dtype_strategy && best_size * 100 > default_size * 99) return dtype_strategy;
+    return best;
+}
 
+// Early-abort probe: a 64 KiB sample preprocessed with the chunk's strategy
+// is rated by what the two halves of a typical backend would get out of
+// it, matches (an LZ4 pass) and skewed byte statistics (the order-0
+// entropy). LZ4 has no entropy stage and rANS no match finder, so each
+// only counts its own half; the others take the better one. Both cost a
+// small fraction of a ZSTD-19 or LZMA-9 pass over the chunk, and the
+// estimate errs high (neither half is charged its format overhead), so
+// only chunks that even an optimistic estimate rates as incompressible
+// are stored.
+bool Compressor::worthCompressing(std::span<const uint8_t> raw,
+                                  Algorithm algo,
+                                  Preprocessor::Strategy strategy,
+                                  size_t row_length) {
+    if (min_gain_ <= 0.0 || raw.empty()) return true;
+
+    const size_t budget = 64 << 10;
+    ByteBuffer sample, preprocessed, compressed;
+    sampleStripes(raw, budget, strategyElementSize(strategy), row_length, sample);
+    preprocessed.resize(Preprocessor::preprocessedSize(sample.size(), strategy));
+    preprocessor_.preprocess(sample, preprocessed, strategy, 1, row_length);
+
+    double estimate = static_cast<double>(preprocessed.size());
+    if (algo != Algorithm::RANS) {
+        compressed.resize(blockBound(preprocessed.size(), Algorithm::LZ4));
+        estimate = static_cast<double>(compressBlock(preprocessed, compressed, Algorithm::LZ4, 0, 1));
+    }
+    if (algo != Algorithm::LZ4) estimate = std::min(estimate, entropyCodedSize(preprocessed));
+    return estimate <= (1.0 - min_gain_) * sample.size();
+}
+
+size_t Compressor::getChunkSize(Algorithm algo, OperationPoint op_point) const {
+    size_t chunk = chunk_size_;
+    if (chunk == 0) {
+        switch (op_point) {
+            case OperationPoint::FAST: chunk = 4 << 20; break;
+            case OperationPoint::MAXIMUM: chunk = 16 << 20; break;  // Larger windows for the slow, high-ratio levels
+        }
+    }
+    if (memory_limit_ == 0) return chunk;
+
+    // Shrink the window until one chunk fits the limit (64 KiB granularity)
+    const size_t granularity = 64 << 10;
+    while (chunk > granularity && estimateChunkMemory(algo, op_point, chunk) > memory_limit_) {
+        chunk = std::max(granularity, (chunk / 2) / granularity * granularity);
+    }
+    return chunk;
+}
+
+// Rough upper bound of the memory needed to compress one chunk: the input
+// window, the preprocessed copy, the compressBound-sized output, and the
+// codec's own state, which for the high-ratio levels scales with the window
+// (ZSTD match tables, LZMA binary-tree match finder over a window-sized
+// dictionary). DEFLATE and LZ4 use a small fixed state.
+size_t Compressor::estimateChunkMemory(Algorithm algo, OperationPoint op_point, size_t chunk_size) const {
+    double codec_factor = 0.0;
     switch (algo) {
-        case Algorithm::ZSTD:
-            decompressed = decompressZSTD(compressed_data);
-            break;
+        case Algorithm::ZSTD: codec_factor = (op_point == OperationPoint::FAST) ? 2.0 : 8.0; break;
+        case Algorithm::LZMA: codec_factor = (op_point == OperationPoint::FAST) ? 7.5 : 11.5; break;
         case Algorithm::LZ4:
-            decompressed = decompressLZ4(compressed_data);
-            break;
         case Algorithm::DEFLATE:
-            decompressed = decompressDEFLATE(compressed_data);
-            break;
-        case Algorithm::LZMA:
-            decompressed = decompressLZMA(compressed_data);
-            break;
+        case Algorithm::RANS: codec_factor = 0.0; break;
     }
+    const size_t fixed_overhead = 1 << 20;
+    return static_cast<size_t>((3.0 + codec_factor) * chunk_size) + fixed_overhead;
+}
 
-    Preprocessor::Strategy strategy = getPreprocessingStrategy(op_point);
-    return preprocessor_.deprocess(decompressed, strategy);
+unsigned Compressor::getThreads() const {
+    return threads_ == 0 ? ThreadPool::defaultThreadCount() : threads_;
 }
 
-// ZSTD Implementation with Multithreading
-std::vector<uint8_t> Compressor::compressZSTD(const std::vector<uint8_t>& data, int level) {
-    // Create compression context
-    ZSTD_CCtx* cctx = ZSTD_createCCtx();
-    if (!cctx) {
-        throw std::runtime_error("ZSTD: failed to create compression context");
+// Independent sub-blocks let a single large buffer use several cores. The
+// sizes are fixed, so the compressed bytes never depend on the thread count.
+namespace {
+const uint64_t LZ4_MULTI_BLOCK = 1ULL << 63;  // Flag in the LZ4 size prefix
+const size_t LZ4_BLOCK_SIZE = 4 << 20;
+const size_t DEFLATE_MEMBER_SIZE = 4 << 20;
+const uint64_t LZMA_BLOCK_SIZE = 16 << 20;
+const size_t ZSTD_TILE_SIZE = 64 << 10;  // Preprocessed bytes fed per streaming call
+
+// zlib's conservative deflateBound() (any window and memory level) plus the
+// gzip header and trailer
+size_t gzipMemberBound(size_t size) {
+    return size + ((size + 7) >> 3) + ((size + 63) >> 6) + 5 + 18;
+}
+
+// Blocks compressed side by side are first written at the offset their
+// worst case would reach, then slid down in order to close the gaps. A block
+// never moves past the start of the next one, so memmove in order is safe.
+size_t compactBlocks(uint8_t* base, size_t pos, const std::vector<size_t>& slots,
+                     const std::vector<size_t>& sizes) {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        memmove(base + pos, base + slots[i], sizes[i]);
+        pos += sizes[i];
     }
+    return pos;
+}
+
+// The extState entry points produce the same blocks as LZ4_compress_default
+// and LZ4_compress_HC, with the match tables in a pooled state
+int compressLZ4Block(ContextPool<void>& states, const uint8_t* src, size_t size, uint8_t* dst, int capacity,
+                     int level, int acceleration) {
+    if (level == 0) {
+        // Fast compression
+        PooledContext<void> state(states, [] { return malloc(LZ4_sizeofState()); });
+        return LZ4_compress_fast_extState(state.get(), reinterpret_cast<const char*>(src),
+                                          reinterpret_cast<char*>(dst),
+                                          static_cast<int>(size), capacity, acceleration);
+    }
+    // High compression
+    PooledContext<void> state(states, [] { return malloc(LZ4_sizeofStateHC()); });
+    return LZ4_compress_HC_extStateHC(state.get(), reinterpret_cast<const char*>(src),
+                                      reinterpret_cast<char*>(dst),
+                                      static_cast<int>(size), capacity, level);
+}
+
+size_t compressGzipMember(ContextPool<DeflateState>& states, std::span<const uint8_t> data,
+                          uint8_t* dst, size_t capacity, int level) {
+    PooledContext<DeflateState> state(states, [] { return new DeflateState(); });
+    DeflateState& ds = *state.get();
+    if (ds.initialised && ds.level == level) {
+        deflateReset(&ds.stream);
+    } else {
+        if (ds.initialised) deflateEnd(&ds.stream);
+        ds.initialised = false;
+        memset(&ds.stream, 0, sizeof(ds.stream));
+        if (deflateInit2(&ds.stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("DEFLATE: initialization failed");
+        }
+        ds.initialised = true;
+        ds.level = level;
+    }
+    z_stream& stream = ds.stream;
+
+    stream.next_in = const_cast<uint8_t*>(data.data());
+    stream.avail_in = data.size();
+    stream.next_out = dst;
+    stream.avail_out = capacity;
+
+    int ret = deflate(&stream, Z_FINISH);
+    size_t size = stream.total_out;
+
+    if (ret != Z_STREAM_END) {
+        throw std::runtime_error("DEFLATE compression failed");
+    }
+    return size;
+}
+
+// Clears whatever a previous user of a pooled context left behind
+void configureZSTD(ZSTD_CCtx* cctx, int level, unsigned threads, size_t memory_limit) {
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
 
     // Set compression level
     ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
 
-    // Enable multithreading - use all available CPU cores
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0) num_threads = 4; // Fallback to 4 threads
+    // Enable multithreading with the requested worker count. Every worker
+    // buffers its own job, so stay single-threaded under a memory limit
+    unsigned int num_threads = (threads > 1) ? threads : 0;
+    if (memory_limit != 0) num_threads = 0;
     ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, num_threads);
+}
 
-    // Allocate output buffer
-    size_t bound = ZSTD_compressBound(data.size());
-    std::vector<uint8_t> compressed(bound);
+z_stream* createInflateStream() {
+    z_stream* stream = new z_stream();
+    if (inflateInit2(stream, 15 + 16) != Z_OK) {
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
 
-    // Compress with context
-    size_t size = ZSTD_compress2(cctx, compressed.data(), bound, data.data(), data.size());
+lzma_stream* createLZMAStream() {
+    return new lzma_stream(LZMA_STREAM_INIT);
+}
+
+// Threaded decoding needs liblzma 5.4; it falls back to one thread rather
+// than exceed the memory limit
+lzma_ret initLZMADecoder(lzma_stream* strm, unsigned threads, size_t memory_limit) {
+#if LZMA_VERSION >= 50040002
+    lzma_mt mt;
+    memset(&mt, 0, sizeof(mt));
+    mt.flags = LZMA_CONCATENATED;
+    mt.threads = std::max(1u, threads);
+    mt.memlimit_threading = (memory_limit != 0) ? memory_limit : lzma_physmem() / 4;
+    mt.memlimit_stop = UINT64_MAX;
+    return lzma_stream_decoder_mt(strm, &mt);
+#else
+    (void)threads;
+    (void)memory_limit;
+    return lzma_stream_decoder(strm, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+}
+}  // namespace
 
-    // Clean up
-    ZSTD_freeCCtx(cctx);
+// Worst-case output of compressBlock for size input bytes, including the
+// sub-block framing of large LZ4, DEFLATE and LZMA inputs
+size_t Compressor::blockBound(size_t size, Algorithm algo) {
+    switch (algo) {
+        case Algorithm::ZSTD:
+            return ZSTD_compressBound(size);
+        case Algorithm::LZ4: {
+            if (size <= LZ4_BLOCK_SIZE) return 8 + LZ4_compressBound(size);
+            size_t count = (size + LZ4_BLOCK_SIZE - 1) / LZ4_BLOCK_SIZE;
+            return 16 + 4 * count + (count - 1) * LZ4_compressBound(LZ4_BLOCK_SIZE) +
+                   LZ4_compressBound(size - (count - 1) * LZ4_BLOCK_SIZE);
+        }
+        case Algorithm::DEFLATE: {
+            if (size <= DEFLATE_MEMBER_SIZE) return gzipMemberBound(size);
+            size_t count = (size + DEFLATE_MEMBER_SIZE - 1) / DEFLATE_MEMBER_SIZE;
+            return (count - 1) * gzipMemberBound(DEFLATE_MEMBER_SIZE) +
+                   gzipMemberBound(size - (count - 1) * DEFLATE_MEMBER_SIZE);
+        }
+        case Algorithm::LZMA: {
+            // lzma_stream_buffer_bound covers one block; every further block
+            // adds its header, check, padding and index record
+            size_t count = std::max<size_t>(1, (size + LZMA_BLOCK_SIZE - 1) / LZMA_BLOCK_SIZE);
+            return lzma_stream_buffer_bound(size) + (count - 1) * 2 * LZMA_BLOCK_HEADER_SIZE_MAX;
+        }
+        case Algorithm::RANS:
+            return rans::encodeBound(size);
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+std::vector<uint8_t> Compressor::compressBlock(std::span<const uint8_t> data, Algorithm algo, int level, unsigned threads) {
+    std::vector<uint8_t> compressed(blockBound(data.size(), algo));
+    compressed.resize(compressBlock(data, compressed, algo, level, threads));
+    return compressed;
+}
+
+size_t Compressor::compressBlock(std::span<const uint8_t> data, std::span<uint8_t> out,
+                                 Algorithm algo, int level, unsigned threads) {
+    return compressBlock(data, out, CodecSettings{algo, level}, threads);
+}
+
+size_t Compressor::compressBlock(std::span<const uint8_t> data, std::span<uint8_t> out,
+                                 const CodecSettings& settings, unsigned threads) {
+    switch (settings.algorithm) {
+        case Algorithm::ZSTD: return compressZSTD(data, out, settings, threads);
+        case Algorithm::LZ4: return compressLZ4(data, out, settings, threads);
+        case Algorithm::DEFLATE: return compressDEFLATE(data, out, settings.level, threads);
+        case Algorithm::LZMA: return compressLZMA(data, out, settings, threads);
+        case Algorithm::RANS: return rans::encode(data, out, threads);
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+std::vector<uint8_t> Compressor::decompressBlock(std::span<const uint8_t> data, Algorithm algo, unsigned threads) {
+    switch (algo) {
+        case Algorithm::ZSTD: return decompressZSTD(data, threads);
+        case Algorithm::LZ4: return decompressLZ4(data, threads);
+        case Algorithm::DEFLATE: return decompressDEFLATE(data, threads);
+        case Algorithm::LZMA: return decompressLZMA(data, threads);
+        case Algorithm::RANS: {
+            std::vector<uint8_t> decompressed(rans::decodedSize(data));
+            rans::decode(data, decompressed, threads);
+            return decompressed;
+        }
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+void Compressor::decompressBlock(std::span<const uint8_t> data, std::span<uint8_t> out, Algorithm algo, unsigned threads) {
+    switch (algo) {
+        case Algorithm::ZSTD: decompressZSTD(data, out, threads); return;
+        case Algorithm::LZ4: decompressLZ4(data, out, threads); return;
+        case Algorithm::DEFLATE: decompressDEFLATE(data, out, threads); return;
+        case Algorithm::LZMA: decompressLZMA(data, out, threads); return;
+        case Algorithm::RANS: rans::decode(data, out, threads); return;
+    }
+    throw std::runtime_error("Unknown compression algorithm");
+}
+
+// ZSTD Implementation with Multithreading
+size_t Compressor::compressZSTD(std::span<const uint8_t> data, std::span<uint8_t> out,
+                                const CodecSettings& settings, unsigned threads) {
+    PooledContext<ZSTD_CCtx> cctx(pools_->zstd_compress, ZSTD_createCCtx);
+    configureZSTD(cctx.get(), settings.level, threads, memory_limit_);
+    // The default 128 MiB long-distance window is what the decoder accepts
+    // without raising ZSTD_d_windowLogMax
+    if (settings.long_distance) ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_enableLongDistanceMatching, 1);
+    if (dictionary_) ZSTD_CCtx_refCDict(cctx.get(), dictionary_->getCDict(settings.level));
+
+    // Compress with context
+    size_t size = ZSTD_compress2(cctx.get(), out.data(), out.size(), data.data(), data.size());
 
     if (ZSTD_isError(size)) {
         throw std::runtime_error("ZSTD compression failed: " + std::string(ZSTD_getErrorName(size)));
     }
+    return size;
+}
 
-    compressed.resize(size);
-    return compressed;
+// Same frame as compressZSTD, built from the preprocessed bytes as the
+// preprocessor produces them tile by tile. The pledged size puts the content
+// size in the frame header, which the decoder relies on.
+size_t Compressor::compressZSTDTiled(std::span<const uint8_t> raw, Preprocessor::Strategy strategy,
+                                     std::span<uint8_t> out, int level, unsigned threads, ByteBuffer& scratch,
+                                     size_t row_length) {
+    PooledContext<ZSTD_CCtx> cctx(pools_->zstd_compress, ZSTD_createCCtx);
+    configureZSTD(cctx.get(), level, threads, memory_limit_);
+    if (dictionary_) ZSTD_CCtx_refCDict(cctx.get(), dictionary_->getCDict(level));
+    ZSTD_CCtx_setPledgedSrcSize(cctx.get(), Preprocessor::preprocessedSize(raw.size(), strategy));
+
+    ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+    auto check = [&](size_t result) {
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error("ZSTD compression failed: " + std::string(ZSTD_getErrorName(result)));
+        }
+        if (result != 0 && output.pos == output.size) {
+            throw std::runtime_error("ZSTD compression failed: output buffer too small");
+        }
+    };
+
+    preprocessor_.preprocessTiled(raw, strategy, ZSTD_TILE_SIZE, scratch, [&](std::span<const uint8_t> piece) {
+        ZSTD_inBuffer input = { piece.data(), piece.size(), 0 };
+        while (input.pos < input.size) {
+            check(ZSTD_compressStream2(cctx.get(), &output, &input, ZSTD_e_continue));
+        }
+    }, threads, row_length);
+
+    ZSTD_inBuffer end = { nullptr, 0, 0 };
+    size_t remaining;
+    do {
+        remaining = ZSTD_compressStream2(cctx.get(), &output, &end, ZSTD_e_end);
+        check(remaining);
+    } while (remaining != 0);
+    return output.pos;
 }
 
-std::vector<uint8_t> Compressor::decompressZSTD(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Compressor::decompressZSTD(std::span<const uint8_t> data, unsigned threads) {
     // Get decompressed size
     unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
     if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) {
         throw std::runtime_error("ZSTD: cannot determine decompressed size");
     }
 
-    // Create decompression context (more efficient for large files)
-    ZSTD_DCtx* dctx = ZSTD_createDCtx();
-    if (!dctx) {
-        throw std::runtime_error("ZSTD: failed to create decompression context");
-    }
-
     std::vector<uint8_t> decompressed(size);
-    size_t result = ZSTD_decompressDCtx(dctx, decompressed.data(), size, data.data(), data.size());
+    decompressZSTD(data, decompressed, threads);
+    return decompressed;
+}
 
-    // Clean up
-    ZSTD_freeDCtx(dctx);
+void Compressor::decompressZSTD(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned /* threads */) {
+    // Pooled decompression context, reset from its previous frame
+    PooledContext<ZSTD_DCtx> dctx(pools_->zstd_decompress, ZSTD_createDCtx);
+    ZSTD_DCtx_reset(dctx.get(), ZSTD_reset_session_and_parameters);
+
+    // The reset also dropped any dictionary; the shared DDict is already
+    // digested, so referencing it costs nothing per frame
+    unsigned dict_id = ZSTD_getDictID_fromFrame(data.data(), data.size());
+    if (dict_id != 0) {
+        if (!dictionary_ || dictionary_->getID() != dict_id) {
+            throw std::runtime_error("ZSTD: frame needs dictionary " + std::to_string(dict_id));
+        }
+        ZSTD_DCtx_refDDict(dctx.get(), dictionary_->getDDict());
+    }
+
+    size_t result = ZSTD_decompressDCtx(dctx.get(), out.data(), out.size(), data.data(), data.size());
 
     if (ZSTD_isError(result)) {
         throw std::runtime_error("ZSTD decompression failed: " + std::string(ZSTD_getErrorName(result)));
     }
-
-    return decompressed;
+    if (result != out.size()) {
+        throw std::runtime_error("ZSTD: decompressed size mismatch");
+    }
 }
 
 // LZ4 Implementation
-std::vector<uint8_t> Compressor::compressLZ4(const std::vector<uint8_t>& data, int level) {
-    int max_size = LZ4_compressBound(data.size());
-    std::vector<uint8_t> compressed(max_size + 8); // +8 for original size header
-    
-    // Store original size in first 8 bytes for decompression
-    uint64_t orig_size = data.size();
-    memcpy(compressed.data(), &orig_size, 8);
-    
-    int compressed_size;
-    if (level == 0) {
-        // Fast compression
-        compressed_size = LZ4_compress_default(
-            reinterpret_cast<const char*>(data.data()),
-            reinterpret_cast<char*>(compressed.data() + 8),
-            data.size(),
-            max_size
-        );
-    } else {
-        // High compression
-        compressed_size = LZ4_compress_HC(
-            reinterpret_cast<const char*>(data.data()),
-            reinterpret_cast<char*>(compressed.data() + 8),
-            data.size(),
-            max_size,
-            level
-        );
+//
+// Inputs of up to one block keep the original layout: u64 original size
+// followed by a single LZ4 block. Larger inputs are split into independent
+// blocks, compressed and decompressed in parallel, and stored as
+//   u64 original size | LZ4_MULTI_BLOCK, u32 block size, u32 block count,
+//   u32 compressed size per block, blocks
+// Sizes never come near 2^63, so older blobs are never mistaken for it.
+size_t Compressor::compressLZ4(std::span<const uint8_t> data, std::span<uint8_t> out,
+                               const CodecSettings& settings, unsigned threads) {
+    const int level = settings.level;
+    if (data.size() <= LZ4_BLOCK_SIZE) {
+        // Store original size in first 8 bytes for decompression
+        uint64_t orig_size = data.size();
+        memcpy(out.data(), &orig_size, 8);
+
+        int compressed_size = compressLZ4Block(level == 0 ? pools_->lz4_fast : pools_->lz4_hc,
+                                               data.data(), data.size(), out.data() + 8,
+                                               static_cast<int>(out.size() - 8), level, settings.acceleration);
+        if (compressed_size <= 0) {
+            throw std::runtime_error("LZ4 compression failed");
+        }
+        return compressed_size + 8;
     }
-    
-    if (compressed_size <= 0) {
-        throw std::runtime_error("LZ4 compression failed");
+
+    size_t block_count = (data.size() + LZ4_BLOCK_SIZE - 1) / LZ4_BLOCK_SIZE;
+    size_t table_end = 16 + 4 * block_count;
+    std::vector<size_t> slots(block_count), sizes(block_count);
+    for (size_t i = 0; i < block_count; ++i) {
+        slots[i] = table_end + i * LZ4_compressBound(LZ4_BLOCK_SIZE);
     }
-    
-    compressed.resize(compressed_size + 8);
-    return compressed;
+    ThreadPool::shared().parallelFor(block_count, threads, [&](size_t i) {
+        size_t begin = i * LZ4_BLOCK_SIZE;
+        size_t size = std::min(LZ4_BLOCK_SIZE, data.size() - begin);
+        int compressed_size = compressLZ4Block(level == 0 ? pools_->lz4_fast : pools_->lz4_hc,
+                                               data.data() + begin, size, out.data() + slots[i],
+                                               LZ4_compressBound(size), level, settings.acceleration);
+        if (compressed_size <= 0) {
+            throw std::runtime_error("LZ4 compression failed");
+        }
+        sizes[i] = compressed_size;
+    });
+
+    uint64_t orig_size = data.size() | LZ4_MULTI_BLOCK;
+    uint32_t block_size = LZ4_BLOCK_SIZE;
+    uint32_t count = block_count;
+    memcpy(out.data(), &orig_size, 8);
+    memcpy(out.data() + 8, &block_size, 4);
+    memcpy(out.data() + 12, &count, 4);
+    for (size_t i = 0; i < block_count; ++i) {
+        uint32_t size = sizes[i];
+        memcpy(out.data() + 16 + 4 * i, &size, 4);
+    }
+    return compactBlocks(out.data(), table_end, slots, sizes);
 }
 
-std::vector<uint8_t> Compressor::decompressLZ4(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Compressor::decompressLZ4(std::span<const uint8_t> data, unsigned threads) {
     if (data.size() < 8) {
         throw std::runtime_error("LZ4: invalid compressed data");
     }
-    
+
     uint64_t orig_size;
     memcpy(&orig_size, data.data(), 8);
-    
-    std::vector<uint8_t> decompressed(orig_size);
-    int result = LZ4_decompress_safe(
-        reinterpret_cast<const char*>(data.data() + 8),
-        reinterpret_cast<char*>(decompressed.data()),
-        data.size() - 8,
-        orig_size
-    );
-    
-    if (result < 0) {
-        throw std::runtime_error("LZ4 decompression failed");
-    }
-    
+
+    std::vector<uint8_t> decompressed(orig_size & ~LZ4_MULTI_BLOCK);
+    decompressLZ4(data, decompressed, threads);
     return decompressed;
 }
 
+void Compressor::decompressLZ4(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    if (data.size() < 8) {
+        throw std::runtime_error("LZ4: invalid compressed data");
+    }
+
+    uint64_t orig_size;
+    memcpy(&orig_size, data.data(), 8);
+    if ((orig_size & ~LZ4_MULTI_BLOCK) != out.size()) {
+        throw std::runtime_error("LZ4: decompressed size mismatch");
+    }
+
+    if ((orig_size & LZ4_MULTI_BLOCK) == 0) {
+        int result = LZ4_decompress_safe(
+            reinterpret_cast<const char*>(data.data() + 8),
+            reinterpret_cast<char*>(out.data()),
+            data.size() - 8,
+            orig_size
+        );
+
+        if (result < 0 || static_cast<uint64_t>(result) != orig_size) {
+            throw std::runtime_error("LZ4 decompression failed");
+        }
+        return;
+    }
+
+    orig_size &= ~LZ4_MULTI_BLOCK;
+    if (data.size() < 16) {
+        throw std::runtime_error("LZ4: invalid compressed data");
+    }
+    uint32_t block_size, block_count;
+    memcpy(&block_size, data.data() + 8, 4);
+    memcpy(&block_count, data.data() + 12, 4);
+    if (block_size == 0 || (orig_size + block_size - 1) / block_size != block_count ||
+        data.size() < 16 + 4 * static_cast<uint64_t>(block_count)) {
+        throw std::runtime_error("LZ4: invalid block table");
+    }
+
+    std::vector<uint64_t> offsets(block_count + 1);
+    std::vector<uint32_t> sizes(block_count);
+    offsets[0] = 16 + 4 * static_cast<uint64_t>(block_count);
+    for (uint32_t i = 0; i < block_count; ++i) {
+        memcpy(&sizes[i], data.data() + 16 + 4 * i, 4);
+        offsets[i + 1] = offsets[i] + sizes[i];
+    }
+    if (offsets[block_count] > data.size()) {
+        throw std::runtime_error("LZ4: invalid block table");
+    }
+
+    ThreadPool::shared().parallelFor(block_count, threads, [&](size_t i) {
+        uint64_t begin = i * static_cast<uint64_t>(block_size);
+        int expected = static_cast<int>(std::min<uint64_t>(block_size, orig_size - begin));
+        int result = LZ4_decompress_safe(
+            reinterpret_cast<const char*>(data.data() + offsets[i]),
+            reinterpret_cast<char*>(out.data() + begin),
+            sizes[i],
+            expected
+        );
+        if (result != expected) {
+            throw std::runtime_error("LZ4 decompression failed");
+        }
+    });
+}
+
 // DEFLATE (zlib) Implementation
-std::vector<uint8_t> Compressor::compressDEFLATE(const std::vector<uint8_t>& data, int level) {
-    z_stream stream;
-    memset(&stream, 0, sizeof(stream));
-    
-    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-        throw std::runtime_error("DEFLATE: initialization failed");
+//
+// Inputs larger than one member are split into independent gzip members
+// that are compressed in parallel and concatenated; RFC 1952 allows
+// multi-member files and gunzip restores them as one stream. The member
+// boundaries are not recorded, so decoding walks them sequentially.
+size_t Compressor::compressDEFLATE(std::span<const uint8_t> data, std::span<uint8_t> out, int level, unsigned threads) {
+    if (data.size() <= DEFLATE_MEMBER_SIZE) {
+        return compressGzipMember(pools_->deflate, data, out.data(), out.size(), level);
     }
-    
-    uLong bound = deflateBound(&stream, data.size());
-    std::vector<uint8_t> compressed(bound);
-    
-    stream.next_in = const_cast<uint8_t*>(data.data());
-    stream.avail_in = data.size();
-    stream.next_out = compressed.data();
-    stream.avail_out = compressed.size();
-    
-    int ret = deflate(&stream, Z_FINISH);
-    deflateEnd(&stream);
-    
-    if (ret != Z_STREAM_END) {
-        throw std::runtime_error("DEFLATE compression failed");
+
+    size_t member_count = (data.size() + DEFLATE_MEMBER_SIZE - 1) / DEFLATE_MEMBER_SIZE;
+    std::vector<size_t> slots(member_count), sizes(member_count);
+    for (size_t i = 0; i < member_count; ++i) {
+        slots[i] = i * gzipMemberBound(DEFLATE_MEMBER_SIZE);
     }
-    
-    compressed.resize(stream.total_out);
-    return compressed;
+    ThreadPool::shared().parallelFor(member_count, threads, [&](size_t i) {
+        size_t begin = i * DEFLATE_MEMBER_SIZE;
+        size_t size = std::min(DEFLATE_MEMBER_SIZE, data.size() - begin);
+        sizes[i] = compressGzipMember(pools_->deflate, data.subspan(begin, size), out.data() + slots[i],
+                                      gzipMemberBound(size), level);
+    });
+    return compactBlocks(out.data(), 0, slots, sizes);
 }
 
-std::vector<uint8_t> Compressor::decompressDEFLATE(const std::vector<uint8_t>& data) {
-    z_stream stream;
-    memset(&stream, 0, sizeof(stream));
-    
-    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+std::vector<uint8_t> Compressor::decompressDEFLATE(std::span<const uint8_t> data, unsigned /* threads */) {
+    PooledContext<z_stream> inflater(pools_->inflate, createInflateStream);
+    z_stream& stream = *inflater.get();
+    if (inflateReset(&stream) != Z_OK) {
         throw std::runtime_error("DEFLATE: decompression init failed");
     }
-    
-    std::vector<uint8_t> decompressed(data.size() * 4); // Initial estimate
-    
+
+    std::vector<uint8_t> decompressed(std::max<size_t>(data.size() * 4, 1024)); // Initial estimate
+
     stream.next_in = const_cast<uint8_t*>(data.data());
     stream.avail_in = data.size();
     stream.next_out = decompressed.data();
     stream.avail_out = decompressed.size();
-    
+
+    // total_out restarts with every member, so track the output position
     int ret;
-    while ((ret = inflate(&stream, Z_NO_FLUSH)) == Z_OK) {
+    while (true) {
         if (stream.avail_out == 0) {
             size_t old_size = decompressed.size();
             decompressed.resize(old_size * 2);
             stream.next_out = decompressed.data() + old_size;
             stream.avail_out = old_size;
         }
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            if (stream.avail_in == 0) break;
+            // Another gzip member follows
+            if (inflateReset(&stream) != Z_OK) break;
+            continue;
+        }
+        if (ret != Z_OK) break;
     }
-    
-    inflateEnd(&stream);
-    
+    size_t produced = stream.next_out - decompressed.data();
+
     if (ret != Z_STREAM_END) {
         throw std::runtime_error("DEFLATE decompression failed");
     }
-    
-    decompressed.resize(stream.total_out);
+
+    decompressed.resize(produced);
     return decompressed;
 }
 
+// Known output size: inflate every member straight into out
+void Compressor::decompressDEFLATE(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned /* threads */) {
+    PooledContext<z_stream> inflater(pools_->inflate, createInflateStream);
+    z_stream& stream = *inflater.get();
+    if (inflateReset(&stream) != Z_OK) {
+        throw std::runtime_error("DEFLATE: decompression init failed");
+    }
+
+    // An empty span has no buffer, and inflate rejects a null next_out even
+    // with nothing to write; an empty chunk is still one whole gzip member
+    uint8_t empty;
+    uint8_t* base = out.empty() ? &empty : out.data();
+    stream.next_in = const_cast<uint8_t*>(data.data());
+    stream.avail_in = data.size();
+    stream.next_out = base;
+    stream.avail_out = out.size();
+
+    int ret;
+    while (true) {
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            if (stream.avail_in == 0) break;
+            // Another gzip member follows
+            if (inflateReset(&stream) != Z_OK) break;
+            continue;
+        }
+        if (ret != Z_OK) break;
+    }
+    size_t produced = stream.next_out - base;
+
+    if (ret != Z_STREAM_END || produced != out.size()) {
+        throw std::runtime_error("DEFLATE decompression failed");
+    }
+}
+
 // LZMA Implementation
-std::vector<uint8_t> Compressor::compressLZMA(const std::vector<uint8_t>& data, int level) {
-    lzma_stream strm = LZMA_STREAM_INIT;
+//
+// The multithreaded xz encoder splits the input into independent blocks of
+// LZMA_BLOCK_SIZE and stores their sizes in the block headers, which also
+// lets the threaded decoder (liblzma 5.4+) restore them in parallel.
+size_t Compressor::compressLZMA(std::span<const uint8_t> data, std::span<uint8_t> out,
+                                const CodecSettings& settings, unsigned threads) {
+    // Re-initialising a used stream lets liblzma keep its allocations and,
+    // for the same thread count, its worker threads
+    PooledContext<lzma_stream> encoder(pools_->lzma_encode, createLZMAStream);
+    lzma_stream& strm = *encoder.get();
     lzma_options_lzma options;
-    lzma_lzma_preset(&options, level);
+    uint32_t preset = static_cast<uint32_t>(settings.level) | (settings.extreme ? LZMA_PRESET_EXTREME : 0);
+    if (lzma_lzma_preset(&options, preset)) {
+        throw std::runtime_error("LZMA: invalid preset " + std::to_string(settings.level));
+    }
+
+    // A dictionary larger than one block gains nothing but encoder memory
+    // (preset 9 reserves 64 MiB of dictionary, ~670 MiB in total)
+    uint32_t dict_needed = static_cast<uint32_t>(std::min<uint64_t>(data.size(), LZMA_BLOCK_SIZE));
+    options.dict_size = std::max<uint32_t>(LZMA_DICT_SIZE_MIN, std::min(options.dict_size, dict_needed));
 
     lzma_filter filters[] = {
         { .id = LZMA_FILTER_LZMA2, .options = &options },
         { .id = LZMA_VLI_UNKNOWN, .options = nullptr }
     };
 
-    if (lzma_stream_encoder(&strm, filters, LZMA_CHECK_CRC64) != LZMA_OK) {
+    // Every encoder thread holds its own block buffers and match finder,
+    // so stay single-threaded under a memory limit
+    lzma_mt mt;
+    memset(&mt, 0, sizeof(mt));
+    mt.threads = (memory_limit_ != 0) ? 1 : std::max(1u, threads);
+    mt.block_size = LZMA_BLOCK_SIZE;
+    mt.filters = filters;
+    mt.check = LZMA_CHECK_CRC64;
+
+    if (lzma_stream_encoder_mt(&strm, &mt) != LZMA_OK) {
         throw std::runtime_error("LZMA: encoder init failed");
     }
 
-    size_t bound = data.size() + (data.size() / 10) + 65536;
-    std::vector<uint8_t> compressed(bound);
-    
     strm.next_in = data.data();
     strm.avail_in = data.size();
-    strm.next_out = compressed.data();
-    strm.avail_out = compressed.size();
+    strm.next_out = out.data();
+    strm.avail_out = out.size();
 
     lzma_ret ret = lzma_code(&strm, LZMA_FINISH);
+    while (ret == LZMA_OK && strm.avail_out > 0) {
+        ret = lzma_code(&strm, LZMA_FINISH);
+    }
     if (ret != LZMA_STREAM_END) {
-        lzma_end(&strm);
         throw std::runtime_error("LZMA compression failed");
     }
-
-    size_t compressed_size = strm.total_out;
-    lzma_end(&strm);
-    compressed.resize(compressed_size);
-    return compressed;
+    return strm.total_out;
 }
 
-std::vector<uint8_t> Compressor::decompressLZMA(const std::vector<uint8_t>& data) {
-    lzma_stream strm = LZMA_STREAM_INIT;
-
-    if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+std::vector<uint8_t> Compressor::decompressLZMA(std::span<const uint8_t> data, unsigned threads) {
+    PooledContext<lzma_stream> decoder(pools_->lzma_decode, createLZMAStream);
+    lzma_stream& strm = *decoder.get();
+    if (initLZMADecoder(&strm, threads, memory_limit_) != LZMA_OK) {
         throw std::runtime_error("LZMA: decoder init failed");
     }
 
@@ -284,24 +1086,46 @@ std::vector<uint8_t> Compressor::decompressLZMA(const std::vector<uint8_t>& data
 
     lzma_ret ret;
     while (true) {
-        ret = lzma_code(&strm, LZMA_FINISH);
-        if (ret == LZMA_STREAM_END) break;
-        if (ret == LZMA_BUF_ERROR) {
+        if (strm.avail_out == 0) {
             size_t current = decompressed.size();
             decompressed.resize(current * 2);
             strm.next_out = decompressed.data() + current;
             strm.avail_out = current;
-        } else if (ret != LZMA_OK) {
-            lzma_end(&strm);
+        }
+        ret = lzma_code(&strm, LZMA_FINISH);
+        if (ret == LZMA_STREAM_END) break;
+        if (ret != LZMA_OK) {
             throw std::runtime_error("LZMA decompression failed");
         }
     }
 
     decompressed.resize(strm.total_out);
-    lzma_end(&strm);
     return decompressed;
 }
 
+void Compressor::decompressLZMA(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    PooledContext<lzma_stream> decoder(pools_->lzma_decode, createLZMAStream);
+    lzma_stream& strm = *decoder.get();
+    if (initLZMADecoder(&strm, threads, memory_limit_) != LZMA_OK) {
+        throw std::runtime_error("LZMA: decoder init failed");
+    }
+
+    strm.next_in = data.data();
+    strm.avail_in = data.size();
+    strm.next_out = out.data();
+    strm.avail_out = out.size();
+
+    // A full output buffer ends in LZMA_BUF_ERROR if the stream has more
+    lzma_ret ret;
+    do {
+        ret = lzma_code(&strm, LZMA_FINISH);
+    } while (ret == LZMA_OK);
+
+    if (ret != LZMA_STREAM_END || strm.total_out != out.size()) {
+        throw std::runtime_error("LZMA decompression failed");
+    }
+}
+
 // Helper methods
 Preprocessor::Strategy Compressor::getPreprocessingStrategy(OperationPoint /* op_point */) {
     // Byte reordering: Separates high/low bytes of BF16 values for better compression
@@ -309,6 +1133,28 @@ Preprocessor::Strategy Compressor::getPreprocessingStrategy(OperationPoint /* op
     return Preprocessor::Strategy::BYTE_REORDER;
 }
 
+Preprocessor::Strategy Compressor::getPreprocessingStrategy(DType dtype, OperationPoint /* op_point */) {
+    switch (dtype) {
+        // 16-bit floats: high byte holds sign+exponent, low byte the mantissa
+        case DType::BF16:
+        case DType::F16:
+            return Preprocessor::Strategy::BYTE_REORDER;
+        // Wider types get one plane per byte: exponent bytes and the high
+        // bytes of small integers become long, compressible runs
+        case DType::F32:
+        case DType::I32:
+        case DType::U32:
+            return Preprocessor::Strategy::BYTE_REORDER_32;
+        case DType::F64:
+        case DType::I64:
+        case DType::U64:
+            return Preprocessor::Strategy::BYTE_REORDER_64;
+        // Splitting 1-byte types is a no-op
+        default:
+            return Preprocessor::Strategy::NONE;
+    }
+}
+
 int Compressor::getCompressionLevel(Algorithm algo, OperationPoint op_point) {
     switch (algo) {
         case Algorithm::ZSTD:
@@ -338,6 +1184,9 @@ int Compressor::getCompressionLevel(Algorithm algo, OperationPoint op_point) {
                 case OperationPoint::MAXIMUM: return 9;
             }
             break;
+
+        case Algorithm::RANS:
+            return 0;  // Static order-0 model, no levels
     }
     return 9; // Default to maximum
 }
@@ -348,6 +1197,7 @@ std::string Compressor::getAlgorithmName(Algorithm algo) {
         case Algorithm::LZ4: return "LZ4";
         case Algorithm::DEFLATE: return "DEFLATE";
         case Algorithm::LZMA: return "LZMA";
+        case Algorithm::RANS: return "RANS";
     }
     return "Unknown";
 }
@@ -363,7 +1213,7 @@ std::string Compressor::getOperationPointName(OperationPoint op_point) {
 // File I/O
 bool Compressor::writeCompressedFile(const std::string& filepath, 
                                      const std::string& header,
-                                     const std::vector<uint8_t>& compressed_data, 
+                                     std::span<const uint8_t> compressed_data,
                                      Algorithm algo,
                                      OperationPoint op_point) {
     std::ofstream file(filepath, std::ios::binary);
@@ -430,6 +1280,7 @@ bool Compressor::readCompressedFile(const std::string& filepath,
         file.read(reinterpret_cast<char*>(&op), 1);
         op_point = static_cast<OperationPoint>(op);
     } else {
+        // Version 3 files are chunked and read through StcmpReader
         return false;
     }
 
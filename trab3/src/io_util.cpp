@@ -0,0 +1,43 @@
+#include "../includes/io_util.hpp"
+#include <unistd.h>
+
+namespace io_util {
+
+bool preadFully(int fd, std::span<uint8_t> out, uint64_t offset) {
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = pread(fd, out.data() + done, out.size() - done, offset + done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool pwriteFully(int fd, std::span<const uint8_t> data, uint64_t offset) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = pwrite(fd, data.data() + done, data.size() - done, offset + done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        auto byte = static_cast<unsigned char>(c);
+        if (byte < 0x20) {
+            // Control characters are not allowed raw inside a JSON string
+            out += "\\u00";
+            out += "0123456789abcdef"[byte >> 4];
+            out += "0123456789abcdef"[byte & 0xF];
+            continue;
+        }
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace io_util
@@ -0,0 +1,347 @@
+#include "../includes/level_sweep.hpp"
+#include "../includes/thread_pool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Preprocessed payload of one strategy and its timing
+struct Prepared {
+    Preprocessor::Strategy strategy;
+    ByteBuffer data;
+    double preprocess_time = 0.0;   // Medians
+    double deprocess_time = 0.0;
+};
+
+} // namespace
+
+std::vector<Compressor::CodecSettings> LevelSweep::levelGrid(Compressor::Algorithm algo) {
+    using Algorithm = Compressor::Algorithm;
+    std::vector<Compressor::CodecSettings> grid;
+    switch (algo) {
+        case Algorithm::ZSTD:
+            // Level 0 only stands for the default level 3
+            for (int level = -5; level <= 22; ++level) {
+                if (level == 0) continue;
+                grid.push_back({algo, level});
+                grid.push_back({algo, level, 1, true});
+            }
+            break;
+        case Algorithm::LZ4:
+            for (int acceleration : {64, 32, 16, 8, 4, 2, 1}) grid.push_back({algo, 0, acceleration});
+            for (int level = 1; level <= 12; ++level) grid.push_back({algo, level});
+            break;
+        case Algorithm::DEFLATE:
+            for (int level = 1; level <= 9; ++level) grid.push_back({algo, level});
+            break;
+        case Algorithm::LZMA:
+            for (int level = 0; level <= 9; ++level) {
+                grid.push_back({algo, level});
+                grid.push_back({algo, level, 1, false, true});
+            }
+            break;
+        case Algorithm::RANS:
+            grid.push_back({algo, 0});
+            break;
+    }
+    return grid;
+}
+
+std::string LevelSweep::describeVariant(const Compressor::CodecSettings& settings) {
+    switch (settings.algorithm) {
+        case Compressor::Algorithm::ZSTD:
+            return std::to_string(settings.level) + (settings.long_distance ? " long" : "");
+        case Compressor::Algorithm::LZ4:
+            return settings.level == 0 ? "fast a" + std::to_string(settings.acceleration)
+                                       : "hc " + std::to_string(settings.level);
+        case Compressor::Algorithm::LZMA:
+            return std::to_string(settings.level) + (settings.extreme ? "e" : "");
+        case Compressor::Algorithm::DEFLATE:
+            return std::to_string(settings.level);
+        case Compressor::Algorithm::RANS:
+            return "-";
+    }
+    return "?";
+}
+
+unsigned LevelSweep::getThreads() const {
+    return threads_ == 0 ? ThreadPool::defaultThreadCount() : threads_;
+}
+
+std::vector<LevelSweep::Point> LevelSweep::run(std::span<const uint8_t> data) {
+    const unsigned threads = getThreads();
+    const unsigned rounds = warmup_ + repetitions_;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<Point> points;
+    for (auto algo : algorithms_) {
+        for (const auto& settings : levelGrid(algo)) {
+            for (auto strategy : strategies_) {
+                Point point;
+                point.settings = settings;
+                point.strategy = strategy;
+                point.algorithm = Compressor::getAlgorithmName(algo);
+                point.variant = describeVariant(settings);
+                point.original_size = data.size();
+                points.push_back(point);
+            }
+        }
+    }
+
+    std::cout << "\nSweeping " << points.size() << " configurations (" << strategies_.size()
+              << " preprocessing strategies) over " << std::fixed << std::setprecision(2)
+              << (data.size() / 1024.0 / 1024.0) << " MB..." << std::endl;
+
+    // One strategy at a time, so only one preprocessed copy of the payload
+    // exists at once
+    Preprocessor preprocessor;
+    Prepared p;
+    ByteBuffer restored, compressed, decoded;
+    size_t timed = 0;
+    for (auto strategy : strategies_) {
+        std::vector<Point*> todo;
+        for (auto& point : points) {
+            if (point.strategy == strategy) todo.push_back(&point);
+        }
+
+        // Preprocessing is timed like the codecs; the last restored copy
+        // must match the input, or every configuration of the strategy
+        // fails verification (a lossy or broken inverse)
+        p.strategy = strategy;
+        p.data.resize(Preprocessor::preprocessedSize(data.size(), strategy));
+        restored.resize(data.size());
+        std::vector<double> pre_times, de_times;
+        for (unsigned round = 0; round < rounds; ++round) {
+            auto t = std::chrono::high_resolution_clock::now();
+            preprocessor.preprocess(data, p.data, strategy, threads);
+            double pre = secondsSince(t);
+            t = std::chrono::high_resolution_clock::now();
+            preprocessor.deprocess(p.data, restored, strategy, threads);
+            double de = secondsSince(t);
+            if (round >= warmup_) {
+                pre_times.push_back(pre);
+                de_times.push_back(de);
+            }
+        }
+        p.preprocess_time = Benchmarker::summarize(pre_times).median;
+        p.deprocess_time = Benchmarker::summarize(de_times).median;
+        bool lossless = data.empty() || memcmp(restored.data(), data.data(), data.size()) == 0;
+        ByteBuffer().swap(restored);
+        if (!lossless) {
+            std::cerr << "Warning: " << Preprocessor::getStrategyName(strategy)
+                      << " does not restore the input; its configurations are not verified" << std::endl;
+            timed += todo.size();
+            continue;
+        }
+
+        // Screening: every configuration once on one thread, side by side,
+        // the slowest settings (last in the grids) first. Each worker holds
+        // a compressed and a decoded copy, so the memory limit caps them.
+        size_t bound = 0;
+        for (auto algo : algorithms_) bound = std::max(bound, Compressor::blockBound(p.data.size(), algo));
+        size_t per_worker = bound + p.data.size();
+        size_t workers = std::min<size_t>(threads, todo.size());
+        if (memory_limit_ > 0) {
+            size_t fixed = p.data.size() + per_worker;  // Payload copy and the timed buffers
+            size_t budget = memory_limit_ > fixed ? memory_limit_ - fixed : 0;
+            workers = std::clamp<size_t>(budget / std::max<size_t>(1, per_worker), 1, workers);
+        }
+        std::atomic<size_t> next{0};
+        ThreadPool::shared().parallelFor(workers, workers, [&](size_t) {
+            ByteBuffer compressed, decoded;
+            size_t k;
+            while ((k = next.fetch_add(1)) < todo.size()) {
+                Point& point = *todo[todo.size() - 1 - k];
+                try {
+                    compressed.resize(Compressor::blockBound(p.data.size(), point.settings.algorithm));
+                    size_t size = compressor_.compressBlock(p.data, compressed, point.settings, 1);
+                    decoded.resize(p.data.size());
+                    compressor_.decompressBlock(std::span<const uint8_t>(compressed.data(), size), decoded,
+                                                point.settings.algorithm, 1);
+                    point.verified = memcmp(decoded.data(), p.data.data(), p.data.size()) == 0;
+                } catch (const std::exception& e) {
+                    std::cerr << "Warning: " << point.algorithm << " " << point.variant << " / "
+                              << Preprocessor::getStrategyName(point.strategy) << ": " << e.what() << std::endl;
+                    point.verified = false;
+                }
+            }
+        });
+
+        // Timed rounds, one configuration at a time
+        for (Point* entry : todo) {
+            Point& point = *entry;
+            ++timed;
+            if (!point.verified) continue;
+            compressed.resize(Compressor::blockBound(p.data.size(), point.settings.algorithm));
+            decoded.resize(p.data.size());
+
+            std::vector<double> compress_times, decompress_times;
+            for (unsigned round = 0; round < rounds; ++round) {
+                auto t = std::chrono::high_resolution_clock::now();
+                point.compressed_size = compressor_.compressBlock(p.data, compressed, point.settings, threads);
+                double c = secondsSince(t);
+                t = std::chrono::high_resolution_clock::now();
+                compressor_.decompressBlock(std::span<const uint8_t>(compressed.data(), point.compressed_size),
+                                            decoded, point.settings.algorithm, threads);
+                double d = secondsSince(t);
+                if (round >= warmup_) {
+                    compress_times.push_back(p.preprocess_time + c);
+                    decompress_times.push_back(d + p.deprocess_time);
+                }
+            }
+            point.compress_stats = Benchmarker::summarize(compress_times);
+            point.decompress_stats = Benchmarker::summarize(decompress_times);
+            point.compression_ratio = static_cast<double>(data.size()) / point.compressed_size;
+            double mb = data.size() / 1024.0 / 1024.0;
+            point.compress_mb_per_sec = mb / point.compress_stats.median;
+            point.decompress_mb_per_sec = mb / point.decompress_stats.median;
+
+            std::cout << "[" << timed << "/" << points.size() << "] " << std::left << std::setw(8)
+                      << point.algorithm << std::setw(10) << point.variant << std::setw(20)
+                      << Preprocessor::getStrategyName(point.strategy) << std::right << std::fixed
+                      << std::setprecision(3) << point.compression_ratio << "x  " << std::setprecision(1)
+                      << point.compress_mb_per_sec << " / " << point.decompress_mb_per_sec << " MB/s" << std::endl;
+        }
+    }
+
+    markParetoFrontier(points);
+    std::cout << "Sweep done in " << std::setprecision(1) << secondsSince(start) << " s" << std::endl;
+    return points;
+}
+
+void LevelSweep::markParetoFrontier(std::vector<Point>& points) {
+    for (auto& p : points) {
+        p.pareto = p.verified;
+        for (const auto& q : points) {
+            if (!p.pareto) break;
+            if (&q == &p || !q.verified) continue;
+            bool no_worse = q.compression_ratio >= p.compression_ratio &&
+                            q.compress_mb_per_sec >= p.compress_mb_per_sec &&
+                            q.decompress_mb_per_sec >= p.decompress_mb_per_sec;
+            bool better = q.compression_ratio > p.compression_ratio ||
+                          q.compress_mb_per_sec > p.compress_mb_per_sec ||
+                          q.decompress_mb_per_sec > p.decompress_mb_per_sec;
+            if (no_worse && better) p.pareto = false;
+        }
+    }
+}
+
+void LevelSweep::printFrontier(const std::vector<Point>& points) const {
+    std::vector<const Point*> frontier;
+    for (const auto& p : points) {
+        if (p.pareto) frontier.push_back(&p);
+    }
+    std::sort(frontier.begin(), frontier.end(),
+              [](const Point* a, const Point* b) { return a->compression_ratio > b->compression_ratio; });
+    size_t failed = std::count_if(points.begin(), points.end(), [](const Point& p) { return !p.verified; });
+
+    std::cout << "\n" << std::string(90, '=') << std::endl;
+    std::cout << "PARETO FRONTIER (" << frontier.size() << " of " << points.size() << " configurations";
+    if (failed) std::cout << ", " << failed << " failed";
+    std::cout << ")" << std::endl;
+    std::cout << std::string(90, '=') << std::endl;
+    std::cout << std::left
+              << std::setw(10) << "Algorithm"
+              << std::setw(12) << "Variant"
+              << std::setw(22) << "Preprocessing"
+              << std::setw(10) << "Ratio"
+              << std::setw(14) << "Comp (MB/s)"
+              << std::setw(14) << "Decomp (MB/s)"
+              << std::endl;
+    std::cout << std::string(90, '-') << std::endl;
+    for (const Point* p : frontier) {
+        std::cout << std::left << std::fixed
+                  << std::setw(10) << p->algorithm
+                  << std::setw(12) << p->variant
+                  << std::setw(22) << Preprocessor::getStrategyName(p->strategy)
+                  << std::setw(10) << std::setprecision(3) << p->compression_ratio
+                  << std::setw(14) << std::setprecision(1) << p->compress_mb_per_sec
+                  << std::setw(14) << p->decompress_mb_per_sec
+                  << std::endl;
+    }
+    std::cout << std::string(90, '=') << std::endl;
+}
+
+bool LevelSweep::saveCSV(const std::vector<Point>& points, const std::string& filepath, bool frontier_only) const {
+    std::ofstream file(filepath);
+    if (!file.is_open()) return false;
+
+    file << "Algorithm,Variant,Level,Acceleration,LongDistance,Extreme,Preprocessing,Threads,"
+         << "OriginalBytes,CompressedBytes,Ratio,CompressMB/s,DecompressMB/s,"
+         << "CompressMedian,CompressP10,CompressP90,DecompressMedian,DecompressP10,DecompressP90,"
+         << "Verified,Pareto\n";
+    for (const auto& p : points) {
+        if (frontier_only && !p.pareto) continue;
+        file << p.algorithm << ","
+             << p.variant << ","
+             << p.settings.level << ","
+             << p.settings.acceleration << ","
+             << (p.settings.long_distance ? "YES" : "NO") << ","
+             << (p.settings.extreme ? "YES" : "NO") << ","
+             << Preprocessor::getStrategyName(p.strategy) << ","
+             << getThreads() << ","
+             << p.original_size << ","
+             << p.compressed_size << ","
+             << std::fixed << std::setprecision(4) << p.compression_ratio << ","
+             << std::setprecision(1) << p.compress_mb_per_sec << ","
+             << p.decompress_mb_per_sec << ","
+             << std::setprecision(5) << p.compress_stats.median << ","
+             << p.compress_stats.p10 << ","
+             << p.compress_stats.p90 << ","
+             << p.decompress_stats.median << ","
+             << p.decompress_stats.p10 << ","
+             << p.decompress_stats.p90 << ","
+             << (p.verified ? "YES" : "NO") << ","
+             << (p.pareto ? "YES" : "NO") << "\n";
+    }
+
+    file.close();
+    std::cout << "Saved CSV: " << filepath << std::endl;
+    return true;
+}
+
+bool LevelSweep::saveJSON(const std::vector<Point>& points, const std::string& filepath) const {
+    std::ofstream file(filepath);
+    if (!file.is_open()) return false;
+
+    file << "{\n";
+    file << "  \"warmup_runs\": " << warmup_ << ",\n";
+    file << "  \"repetitions\": " << repetitions_ << ",\n";
+    file << "  \"threads\": " << getThreads() << ",\n";
+    file << "  \"original_bytes\": " << (points.empty() ? 0 : points.front().original_size) << ",\n";
+    file << "  \"points\": [\n";
+    for (size_t i = 0; i < points.size(); ++i) {
+        const auto& p = points[i];
+        file << "    {\n";
+        file << "      \"algorithm\": \"" << p.algorithm << "\",\n";
+        file << "      \"variant\": \"" << p.variant << "\",\n";
+        file << "      \"level\": " << p.settings.level << ",\n";
+        file << "      \"acceleration\": " << p.settings.acceleration << ",\n";
+        file << "      \"long_distance\": " << (p.settings.long_distance ? "true" : "false") << ",\n";
+        file << "      \"extreme\": " << (p.settings.extreme ? "true" : "false") << ",\n";
+        file << "      \"preprocessing\": \"" << Preprocessor::getStrategyName(p.strategy) << "\",\n";
+        file << "      \"compressed_bytes\": " << p.compressed_size << ",\n";
+        file << "      \"compression_ratio\": " << std::fixed << std::setprecision(4) << p.compression_ratio << ",\n";
+        file << "      \"compress_mb_per_sec\": " << std::setprecision(1) << p.compress_mb_per_sec << ",\n";
+        file << "      \"decompress_mb_per_sec\": " << p.decompress_mb_per_sec << ",\n";
+        file << "      \"compress_time_sec\": " << std::setprecision(5) << p.compress_stats.median << ",\n";
+        file << "      \"decompress_time_sec\": " << p.decompress_stats.median << ",\n";
+        file << "      \"verified\": " << (p.verified ? "true" : "false") << ",\n";
+        file << "      \"pareto\": " << (p.pareto ? "true" : "false") << "\n";
+        file << "    }" << (i < points.size() - 1 ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+
+    file.close();
+    std::cout << "Saved JSON: " << filepath << std::endl;
+    return true;
+}
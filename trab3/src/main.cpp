@@ -3,30 +3,103 @@
 #include <fstream>
 #include <chrono>
 #include <map>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <cctype>
+#include <filesystem>
 #include "../includes/safetensors_parser.hpp"
 #include "../includes/compressor.hpp"
 #include "../includes/benchmarker.hpp"
+#include "../includes/stcmp_archive.hpp"
+#include "../includes/batch_compressor.hpp"
+#include "../includes/level_sweep.hpp"
+#include "../includes/checksum.hpp"
+#include "../includes/quantizer.hpp"
+#include "../includes/async_io.hpp"
+
+struct CliOptions {
+    size_t memory_limit = 0;  // Bytes, 0 = unlimited
+    unsigned threads = 0;     // 0 = all cores
+    bool auto_strategy = false;  // Pick each chunk's preprocessing by sampling
+    double min_gain = Compressor::DEFAULT_MIN_GAIN;  // Store chunks predicted to save less
+    std::string dict_path;       // Trained ZSTD dictionary, empty = none
+    size_t dict_size = 112 << 10;  // Capacity of a trained dictionary
+    unsigned warmup = 1;           // Benchmark rounds before timing
+    unsigned repetitions = 3;      // Timed benchmark rounds
+    bool cold_input = false;       // Evict the input from the page cache before every round
+    std::vector<unsigned> pin_cpus;  // Benchmark CPU affinity, empty = no pinning
+    unsigned quant_bits = 0;         // Lossy INT4/INT8 stage before compress, 0 = lossless
+    size_t quant_block_size = 128;   // Values per quantization scale
+};
 
 void printUsage(const char* prog) {
     std::cout << "SafeTensors Compressor - Enhanced Multi-Algorithm Version\n\n";
     std::cout << "Usage:\n";
     std::cout << "  " << prog << " compress <input.safetensors> <output.stcmp> [algorithm] [mode]\n";
     std::cout << "  " << prog << " decompress <input.stcmp> <output.safetensors>\n";
+    std::cout << "  " << prog << " extract <input.stcmp> <tensor_name> <output.bin>\n";
+    std::cout << "  " << prog << " verify <input.stcmp> [quick]\n";
+    std::cout << "  " << prog << " compress-dir <model_dir> <output_dir> [algorithm] [mode]\n";
+    std::cout << "  " << prog << " decompress-dir <input_dir> <output_dir>\n";
     std::cout << "  " << prog << " benchmark <input.safetensors> [mode]\n";
-    std::cout << "  " << prog << " compare <input.safetensors> [mode]\n\n";
+    std::cout << "  " << prog << " compare <input.safetensors> [mode]\n";
+    std::cout << "  " << prog << " sweep <input.safetensors> [algorithms] [strategies]\n";
+    std::cout << "  " << prog << " train-dict <output.dict> <shard.safetensors>...\n";
+    std::cout << "  " << prog << " quantize <input.safetensors> <output.safetensors> [4|8]\n\n";
     std::cout << "Algorithms:\n";
     std::cout << "  lz4      - LZ4 (fastest, lower ratio)\n";
     std::cout << "  deflate  - DEFLATE/GZIP (good balance)\n";
     std::cout << "  zstd     - Zstandard (best balance) [default]\n";
-    std::cout << "  lzma     - LZMA/XZ (highest ratio, slowest)\n\n";
+    std::cout << "  lzma     - LZMA/XZ (highest ratio, slowest)\n";
+    std::cout << "  rans     - rANS entropy coder (fast decode, no match finding)\n\n";
     std::cout << "Modes:\n";
     std::cout << "  fast     - Quick compression\n";
     std::cout << "  maximum  - Maximum compression [default]\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --memory-limit <size>  Stream in fixed-size windows so compression stays\n";
+    std::cout << "                         within <size> (e.g. 512M, 2G); sweep: caps the\n";
+    std::cout << "                         parallel screening workers\n";
+    std::cout << "  --threads <n>          Worker threads for (de)compression [default: all cores]\n";
+    std::cout << "  --strategy <s>         Preprocessing choice: dtype (by tensor type) or auto\n";
+    std::cout << "                         (trial-compress a sample of every chunk) [default: dtype]\n";
+    std::cout << "  --min-gain <percent>   Store chunks raw when a quick probe predicts a smaller\n";
+    std::cout << "                         saving (0 = only when compression expands) [default: 2]\n";
+    std::cout << "  --dict <file>          ZSTD dictionary from train-dict, needed again to decompress\n";
+    std::cout << "  --dict-size <size>     Capacity of a trained dictionary [default: 112K]\n";
+    std::cout << "  --warmup <n>           benchmark/compare: untimed rounds first [default: 1]\n";
+    std::cout << "  --repeat <n>           benchmark/compare: timed rounds, medians reported [default: 3]\n";
+    std::cout << "  --cold                 benchmark/compare: drop the input from the page cache\n";
+    std::cout << "                         before every timed round\n";
+    std::cout << "  --pin <cpus>           benchmark/compare: pin all threads to CPUs (e.g. 0-3,8)\n";
+    std::cout << "  --io <backend>         File I/O: auto, uring (io_uring) or threads (pread/pwrite\n";
+    std::cout << "                         workers) [default: auto, io_uring when available]\n";
+    std::cout << "  --quantize <4|8>       compress: quantize weights to INT4/INT8 first (lossy)\n";
+    std::cout << "  --block-size <n>       quantize/--quantize: values per scale [default: 128]\n\n";
+    std::cout << "Sweep:\n";
+    std::cout << "  Times every level of each algorithm (comma-separated, or all) [default:\n";
+    std::cout << "  zstd,lz4,deflate,lzma] on the payload preprocessed with each strategy\n";
+    std::cout << "  (comma-separated names, e.g. none,byte_reorder) [default: none,byte_reorder]\n";
+    std::cout << "  and writes the ratio/speed Pareto frontier to output/sweep_*.\n";
+    std::cout << "  Honors --threads, --warmup and --repeat.\n\n";
+    std::cout << "Verify:\n";
+    std::cout << "  Checks every chunk against its CRC32C and decodes it, writing nothing;\n";
+    std::cout << "  quick checks the compressed bytes only. Honors --threads and --dict.\n\n";
     std::cout << "Examples:\n";
     std::cout << "  " << prog << " compress model.safetensors model.stcmp zstd maximum\n";
     std::cout << "  " << prog << " compress model.safetensors model.stcmp zstd fast\n";
+    std::cout << "  " << prog << " compress model.safetensors model.stcmp lzma maximum --memory-limit 1G\n";
+    std::cout << "  " << prog << " compress model.safetensors model.stcmp zstd maximum --strategy auto\n";
+    std::cout << "  " << prog << " compress model.safetensors model_int4.stcmp zstd maximum --quantize 4\n";
+    std::cout << "  " << prog << " train-dict model.dict model-00001-of-00002.safetensors model-00002-of-00002.safetensors\n";
+    std::cout << "  " << prog << " compress model-00001-of-00002.safetensors shard1.stcmp zstd maximum --dict model.dict\n";
+    std::cout << "  " << prog << " compress-dir models/qwen2-7b models/qwen2-7b.stcmp zstd maximum\n";
+    std::cout << "  " << prog << " verify model.stcmp\n";
     std::cout << "  " << prog << " benchmark model.safetensors\n";
     std::cout << "  " << prog << " compare model.safetensors fast\n";
+    std::cout << "  " << prog << " compare model.safetensors fast --repeat 10 --cold --pin 0-3\n";
+    std::cout << "  " << prog << " sweep model.safetensors zstd,lz4 none,byte_reorder,field_split_bf16\n";
 }
 
 Compressor::Algorithm parseAlgorithm(const std::string& algo_str) {
@@ -34,7 +107,8 @@ Compressor::Algorithm parseAlgorithm(const std::string& algo_str) {
         {"lz4", Compressor::Algorithm::LZ4},
         {"deflate", Compressor::Algorithm::DEFLATE},
         {"zstd", Compressor::Algorithm::ZSTD},
-        {"lzma", Compressor::Algorithm::LZMA}
+        {"lzma", Compressor::Algorithm::LZMA},
+        {"rans", Compressor::Algorithm::RANS}
     };
     
     auto it = algo_map.find(algo_str);
@@ -44,36 +118,213 @@ Compressor::Algorithm parseAlgorithm(const std::string& algo_str) {
     return Compressor::Algorithm::ZSTD; // Default
 }
 
+// Parses sizes such as "512M", "2G" or a plain byte count
+bool parseSize(const std::string& text, size_t& bytes) {
+    size_t pos = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &pos);
+    } catch (const std::exception&) {
+        return false;
+    }
+    std::string suffix = text.substr(pos);
+    if (suffix == "" || suffix == "B") bytes = value;
+    else if (suffix == "K" || suffix == "KB") bytes = value << 10;
+    else if (suffix == "M" || suffix == "MB") bytes = value << 20;
+    else if (suffix == "G" || suffix == "GB") bytes = value << 30;
+    else return false;
+    return true;
+}
+
+// Parses CPU lists such as "0-3,8"
+bool parseCpuList(const std::string& text, std::vector<unsigned>& cpus) {
+    cpus.clear();
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        std::string part = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        size_t dash = part.find('-');
+        try {
+            unsigned long first = std::stoul(part.substr(0, dash));
+            unsigned long last = dash == std::string::npos ? first : std::stoul(part.substr(dash + 1));
+            if (last < first || last >= 4096) return false;
+            for (unsigned long c = first; c <= last; ++c) cpus.push_back(static_cast<unsigned>(c));
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (end == std::string::npos) break;
+        pos = end + 1;
+    }
+    return !cpus.empty();
+}
+
+// Parses "zstd,lz4" or "all"
+bool parseAlgorithmList(const std::string& text, std::vector<Compressor::Algorithm>& algorithms) {
+    static const std::vector<std::string> names = {"zstd", "lz4", "deflate", "lzma", "rans"};
+    algorithms.clear();
+    std::stringstream list(text);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        if (name == "all") {
+            for (const auto& n : names) algorithms.push_back(parseAlgorithm(n));
+        } else if (std::find(names.begin(), names.end(), name) != names.end()) {
+            algorithms.push_back(parseAlgorithm(name));
+        } else {
+            return false;
+        }
+    }
+    return !algorithms.empty();
+}
+
+// Parses strategy names as getStrategyName spells them, case and
+// underscores ignored: "none,byte_reorder" or "None,ByteReorder"
+bool parseStrategyList(const std::string& text, std::vector<Preprocessor::Strategy>& strategies) {
+    using Strategy = Preprocessor::Strategy;
+    static const std::vector<Strategy> all = {
+        Strategy::NONE, Strategy::BYTE_REORDER, Strategy::DELTA_ENCODING, Strategy::BF16_TO_FP16,
+        Strategy::COMBINED, Strategy::BYTE_REORDER_DELTA, Strategy::BIT_PLANE_SEPARATION,
+        Strategy::BYTE_REORDER_32, Strategy::BYTE_REORDER_64, Strategy::FIELD_SPLIT_BF16,
+        Strategy::FIELD_SPLIT_F16, Strategy::FIELD_SPLIT_F32, Strategy::XOR_DELTA_32, Strategy::XOR_2D_16,
+        Strategy::XOR_2D_32, Strategy::XOR_PLANE_16, Strategy::XOR_PLANE_32
+    };
+    auto normalize = [](std::string name) {
+        name.erase(std::remove(name.begin(), name.end(), '_'), name.end());
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        return name;
+    };
+    strategies.clear();
+    std::stringstream list(text);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        auto it = std::find_if(all.begin(), all.end(), [&](Strategy s) {
+            return normalize(Preprocessor::getStrategyName(s)) == normalize(name);
+        });
+        if (it == all.end()) return false;
+        strategies.push_back(*it);
+    }
+    return !strategies.empty();
+}
+
 Compressor::OperationPoint parseMode(const std::string& mode_str) {
     if (mode_str == "fast") return Compressor::OperationPoint::FAST;
     if (mode_str == "maximum") return Compressor::OperationPoint::MAXIMUM;
     return Compressor::OperationPoint::MAXIMUM; // Default
 }
 
+void printQuantizeSummary(const Quantizer& quantizer) {
+    const Quantizer::Stats& stats = quantizer.getStats();
+    uint64_t out = stats.outputBytes();
+    std::cout << "\n" << std::string(50, '=') << std::endl;
+    std::cout << "QUANTIZATION COMPLETE (INT" << quantizer.getBits() << ", block "
+              << quantizer.getBlockSize() << ")" << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+    std::cout << "Tensors:        " << stats.tensors << " (" << stats.quantized_tensors << " quantized)" << std::endl;
+    std::cout << "Original:       " << std::fixed << std::setprecision(2)
+              << (stats.original_bytes / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Codes:          " << (stats.code_bytes / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Scales:         " << (stats.scale_bytes / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Kept:           " << (stats.kept_bytes / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Quantized:      " << (out / 1024.0 / 1024.0) << " MB ("
+              << std::setprecision(2) << (static_cast<double>(stats.original_bytes) / std::max<uint64_t>(out, 1))
+              << "x)" << std::endl;
+    std::cout << "Kernels:        " << Quantizer::getKernelName() << std::endl;
+    std::cout << "Time:           " << std::setprecision(2) << stats.seconds << " s" << std::endl;
+    std::cout << "Throughput:     " << std::setprecision(1)
+              << (stats.original_bytes / 1024.0 / 1024.0 / stats.seconds) << " MB/s" << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+}
+
+int quantize(const std::string& input, const std::string& output, unsigned bits, const CliOptions& options,
+             uint64_t* original_bytes = nullptr) {
+    Quantizer quantizer(bits, options.quant_block_size);
+    quantizer.setThreads(options.threads);
+    std::cout << "\nQuantizing to INT" << bits << " (" << Quantizer::getKernelName() << ")..." << std::endl;
+    if (!quantizer.quantizeFile(input, output)) {
+        std::cerr << "Error: Quantization failed" << std::endl;
+        return 1;
+    }
+    printQuantizeSummary(quantizer);
+    if (original_bytes) {
+        *original_bytes = quantizer.getStats().original_bytes;
+    } else {
+        std::cout << "\nSuccess: " << output << std::endl;
+    }
+    return 0;
+}
+
+// Removes the intermediate quantized model of compress --quantize
+struct TemporaryFile {
+    std::string path;
+    ~TemporaryFile() {
+        std::error_code ec;
+        if (!path.empty()) std::filesystem::remove(path, ec);
+    }
+};
+
 int compress(const std::string& input, const std::string& output, 
-             const std::string& algo_str, const std::string& mode_str) {
+             const std::string& algo_str, const std::string& mode_str,
+             const CliOptions& options) {
     Compressor::Algorithm algo = parseAlgorithm(algo_str);
     Compressor::OperationPoint mode = parseMode(mode_str);
 
+    // The lossy stage writes the quantized model next to the output, one
+    // tensor at a time, and that file is what gets compressed
+    TemporaryFile quantized;
+    std::string source = input;
+    uint64_t model_bytes = 0;
+    if (options.quant_bits) {
+        quantized.path = output + ".int" + std::to_string(options.quant_bits) + ".tmp";
+        if (quantize(input, quantized.path, options.quant_bits, options, &model_bytes) != 0) return 1;
+        source = quantized.path;
+    }
+
+    // With a memory limit the payload is streamed instead of mapped, so the
+    // resident input never exceeds one window
     SafetensorsParser parser;
-    if (!parser.parse(input)) return 1;
+    SafetensorsParser::LoadMode load_mode = options.memory_limit ? SafetensorsParser::LoadMode::STREAM
+                                                                 : SafetensorsParser::LoadMode::MMAP;
+    if (!parser.parse(source, load_mode)) return 1;
 
     Compressor compressor;
+    compressor.setMemoryLimit(options.memory_limit);
+    compressor.setThreads(options.threads);
+    compressor.setAutoStrategy(options.auto_strategy);
+    compressor.setMinimumGain(options.min_gain);
+    if (!options.dict_path.empty()) {
+        if (algo != Compressor::Algorithm::ZSTD) {
+            std::cerr << "Error: Dictionaries are only supported with zstd" << std::endl;
+            return 1;
+        }
+        auto dictionary = ZstdDictionary::load(options.dict_path);
+        if (!dictionary) return 1;
+        compressor.setDictionary(dictionary);
+        std::cout << "Dictionary:     " << options.dict_path << " (ID " << dictionary->getID() << ", "
+                  << dictionary->getSize() << " bytes)" << std::endl;
+    }
     std::cout << "\nCompressing with " << Compressor::getAlgorithmName(algo) 
-              << " (" << Compressor::getOperationPointName(mode) << ")..." << std::endl;
+              << " (" << Compressor::getOperationPointName(mode) << ", "
+              << compressor.getThreads() << " threads)..." << std::endl;
+    if (options.memory_limit) {
+        size_t window = compressor.getChunkSize(algo, mode);
+        std::cout << "Memory limit: " << (options.memory_limit / 1024.0 / 1024.0) << " MB, window: "
+                  << (window / 1024.0 / 1024.0) << " MB (~"
+                  << (compressor.estimateChunkMemory(algo, mode, window) / 1024.0 / 1024.0) << " MB working set)" << std::endl;
+    }
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::vector<uint8_t> compressed = compressor.compress(parser.getTensorData(), algo, mode);
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> duration = end - start;
-
-    if (!compressor.writeCompressedFile(output, parser.getHeader(), compressed, algo, mode)) {
+    StcmpWriter writer;
+    uint32_t dictionary_id = compressor.getDictionary() ? compressor.getDictionary()->getID() : 0;
+    if (!writer.open(output, parser.getHeader(), algo, mode, parser.getTensorDataSize(), dictionary_id) ||
+        !writer.writeChunks(compressor, parser) ||
+        !writer.finish()) {
         std::cerr << "Error: Failed to write compressed file" << std::endl;
         return 1;
     }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
 
     size_t orig = parser.getTensorDataSize();
-    size_t comp = compressed.size();
+    size_t comp = writer.getCompressedBytes();
     double ratio = static_cast<double>(orig) / comp;
     double savings = 100.0 * (1.0 - 1.0/ratio);
     
@@ -85,8 +336,24 @@ int compress(const std::string& input, const std::string& output,
     std::cout << "Original:       " << std::fixed << std::setprecision(2) 
               << (orig / 1024.0 / 1024.0) << " MB" << std::endl;
     std::cout << "Compressed:     " << (comp / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Chunks:         " << writer.getChunkCount();
+    if (size_t stored = writer.getStoredCount()) std::cout << " (" << stored << " stored uncompressed)";
+    std::cout << std::endl;
+    if (options.auto_strategy) {
+        std::map<std::string, size_t> chosen;
+        for (const auto& c : writer.getChunks()) chosen[Preprocessor::getStrategyName(c.strategy)]++;
+        std::cout << "Strategies:    ";
+        for (const auto& [name, count] : chosen) std::cout << " " << name << " x" << count;
+        std::cout << std::endl;
+    }
     std::cout << "Ratio:          " << std::setprecision(3) << ratio << "x" << std::endl;
     std::cout << "Space saved:    " << std::setprecision(1) << savings << "%" << std::endl;
+    std::cout << "I/O:            " << AsyncIO::getBackendName(writer.getIoBackend()) << std::endl;
+    if (options.quant_bits) {
+        std::cout << "Unquantized:    " << std::setprecision(2) << (model_bytes / 1024.0 / 1024.0) << " MB ("
+                  << std::setprecision(3) << (static_cast<double>(model_bytes) / comp) << "x overall, INT"
+                  << options.quant_bits << ")" << std::endl;
+    }
     std::cout << "Time:           " << std::setprecision(2) << duration.count() << " s" << std::endl;
     std::cout << "Throughput:     " << std::setprecision(1) 
               << (orig / 1024.0 / 1024.0 / duration.count()) << " MB/s" << std::endl;
@@ -95,23 +362,89 @@ int compress(const std::string& input, const std::string& output,
     return 0;
 }
 
-int decompress(const std::string& input, const std::string& output) {
-    Compressor compressor;
-    std::string header;
-    std::vector<uint8_t> compressed;
-    Compressor::Algorithm algo;
-    Compressor::OperationPoint mode;
+// Loads the dictionary an archive was compressed with, from --dict
+bool attachDictionary(StcmpReader& reader, const CliOptions& options) {
+    uint32_t id = reader.getDictionaryID();
+    if (id == 0) return true;
+    if (options.dict_path.empty()) {
+        std::cerr << "Error: Archive was compressed with dictionary " << id << "; pass it with --dict" << std::endl;
+        return false;
+    }
+    auto dictionary = ZstdDictionary::load(options.dict_path);
+    if (!dictionary) return false;
+    if (dictionary->getID() != id) {
+        std::cerr << "Error: Archive needs dictionary " << id << ", " << options.dict_path
+                  << " is dictionary " << dictionary->getID() << std::endl;
+        return false;
+    }
+    reader.setDictionary(dictionary);
+    return true;
+}
 
-    if (!compressor.readCompressedFile(input, header, compressed, algo, mode)) {
+int decompress(const std::string& input, const std::string& output, const CliOptions& options) {
+    StcmpReader reader;
+    if (!reader.open(input)) {
         std::cerr << "Error: Failed to read compressed file" << std::endl;
         return 1;
     }
+    if (!attachDictionary(reader, options)) return 1;
+    Compressor::Algorithm algo = reader.getAlgorithm();
+    reader.setThreads(options.threads);
+    reader.setMemoryLimit(options.memory_limit);
+
+    // Decompression holds at least one compressed and one raw chunk; the
+    // chunk sizes were fixed at compression time
+    if (options.memory_limit) {
+        uint64_t largest = 0;
+        for (const auto& c : reader.getChunks()) {
+            largest = std::max(largest, c.raw_size + c.compressed_size);
+        }
+        if (largest > options.memory_limit) {
+            std::cerr << "Warning: Largest chunk needs " << (largest / 1024.0 / 1024.0)
+                      << " MB, above the memory limit" << std::endl;
+        }
+    }
 
     std::cout << "\nDecompressing " << Compressor::getAlgorithmName(algo) 
-              << " data..." << std::endl;
+              << " data (" << reader.getChunks().size() << " chunks)..." << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t tensor_bytes = 0;
+    if (!reader.decompressToFile(output, &tensor_bytes)) {
+        std::cerr << "Error: Decompression failed" << std::endl;
+        return 1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "\n" << std::string(50, '=') << std::endl;
+    std::cout << "DECOMPRESSION COMPLETE" << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+    std::cout << "Algorithm:      " << Compressor::getAlgorithmName(algo) << std::endl;
+    std::cout << "Size:           " << std::fixed << std::setprecision(2) 
+              << (tensor_bytes / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Time:           " << std::setprecision(2) << duration.count() << " s" << std::endl;
+    std::cout << "Throughput:     " << std::setprecision(1) 
+              << (tensor_bytes / 1024.0 / 1024.0 / duration.count()) << " MB/s" << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+    std::cout << "\nSuccess: " << output << std::endl;
+    return 0;
+}
+
+int extract(const std::string& input, const std::string& tensor_name, const std::string& output,
+            const CliOptions& options) {
+    StcmpReader reader;
+    if (!reader.open(input)) {
+        std::cerr << "Error: Failed to read compressed file" << std::endl;
+        return 1;
+    }
+    if (!attachDictionary(reader, options)) return 1;
+    reader.setThreads(options.threads);
+    reader.setMemoryLimit(options.memory_limit);
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::vector<uint8_t> tensor_data = compressor.decompress(compressed, algo, mode);
+    std::vector<uint8_t> tensor;
+    if (!reader.decompressTensor(tensor_name, tensor)) return 1;
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
 
@@ -120,32 +453,217 @@ int decompress(const std::string& input, const std::string& output) {
         std::cerr << "Error: Cannot create output file" << std::endl;
         return 1;
     }
-
-    uint64_t header_size = header.size();
-    file.write(reinterpret_cast<const char*>(&header_size), 8);
-    file.write(header.data(), header.size());
-    file.write(reinterpret_cast<const char*>(tensor_data.data()), tensor_data.size());
+    file.write(reinterpret_cast<const char*>(tensor.data()), tensor.size());
     file.close();
 
+    std::cout << "Extracted " << tensor_name << ": " << tensor.size() << " bytes in "
+              << std::fixed << std::setprecision(3) << duration.count() << " s" << std::endl;
+    return 0;
+}
+
+int verify(const std::string& input, bool quick, const CliOptions& options) {
+    StcmpReader reader;
+    if (!reader.open(input)) {
+        std::cerr << "Error: Failed to read compressed file" << std::endl;
+        return 1;
+    }
+    reader.setThreads(options.threads);
+    // A quick check decodes nothing, so it needs no dictionary
+    if (!(quick && reader.hasChecksums()) && !attachDictionary(reader, options)) return 1;
+    if (!reader.hasChecksums()) {
+        std::cout << "Archive has no checksums; decoding every chunk instead" << std::endl;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    StcmpReader::VerifyReport report;
+    bool ok = reader.verify(quick, report);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    uint64_t bytes = report.decoded ? report.raw_bytes : report.compressed_bytes;
+
     std::cout << "\n" << std::string(50, '=') << std::endl;
-    std::cout << "DECOMPRESSION COMPLETE" << std::endl;
+    std::cout << (ok ? "VERIFICATION PASSED" : "VERIFICATION FAILED") << std::endl;
     std::cout << std::string(50, '=') << std::endl;
-    std::cout << "Algorithm:      " << Compressor::getAlgorithmName(algo) << std::endl;
-    std::cout << "Size:           " << std::fixed << std::setprecision(2) 
-              << (tensor_data.size() / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Check:          " << (report.checksums ? "CRC32C (" + checksum::getKernelName() + ")" : "decode only")
+              << (report.decoded ? ", decoded" : ", compressed bytes only") << std::endl;
+    std::cout << "Chunks:         " << (report.chunks - report.failed_chunks) << "/" << report.chunks << " good" << std::endl;
+    std::cout << "Checked:        " << std::fixed << std::setprecision(2)
+              << (bytes / 1024.0 / 1024.0) << " MB" << std::endl;
     std::cout << "Time:           " << std::setprecision(2) << duration.count() << " s" << std::endl;
-    std::cout << "Throughput:     " << std::setprecision(1) 
-              << (tensor_data.size() / 1024.0 / 1024.0 / duration.count()) << " MB/s" << std::endl;
+    std::cout << "Throughput:     " << std::setprecision(1)
+              << (bytes / 1024.0 / 1024.0 / duration.count()) << " MB/s" << std::endl;
     std::cout << std::string(50, '=') << std::endl;
+    return ok ? 0 : 1;
+}
+
+void printBatchSummary(const BatchCompressor& batch, const std::string& title, double seconds) {
+    uint64_t in = 0, out = 0;
+    for (const auto& r : batch.getResults()) {
+        in += r.input_bytes;
+        out += r.output_bytes;
+    }
+
+    std::cout << "\n" << std::string(50, '=') << std::endl;
+    std::cout << title << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+    std::cout << "Shards:         " << batch.getResults().size() << " (" << batch.getConcurrency()
+              << " at a time)" << std::endl;
+    std::cout << "Copied files:   " << batch.getCopiedFiles().size() << std::endl;
+    std::cout << "Input:          " << std::fixed << std::setprecision(2) << (in / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Output:         " << (out / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "Time:           " << seconds << " s" << std::endl;
+    std::cout << "Throughput:     " << std::setprecision(1)
+              << (std::max(in, out) / 1024.0 / 1024.0 / seconds) << " MB/s" << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+}
+
+// Compresses every shard of a model directory in this one process
+int compressDir(const std::string& input_dir, const std::string& output_dir,
+                const std::string& algo_str, const std::string& mode_str,
+                const CliOptions& options) {
+    Compressor::Algorithm algo = parseAlgorithm(algo_str);
+    Compressor::OperationPoint mode = parseMode(mode_str);
+
+    BatchCompressor batch;
+    batch.setThreads(options.threads);
+    batch.setMemoryLimit(options.memory_limit);
+    batch.setAutoStrategy(options.auto_strategy);
+    batch.setMinimumGain(options.min_gain);
+    if (!options.dict_path.empty()) {
+        if (algo != Compressor::Algorithm::ZSTD) {
+            std::cerr << "Error: Dictionaries are only supported with zstd" << std::endl;
+            return 1;
+        }
+        auto dictionary = ZstdDictionary::load(options.dict_path);
+        if (!dictionary) return 1;
+        batch.setDictionary(dictionary);
+    }
+
+    std::cout << "\nCompressing " << input_dir << " with " << Compressor::getAlgorithmName(algo)
+              << " (" << Compressor::getOperationPointName(mode) << ")..." << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ok = batch.compressDirectory(input_dir, output_dir, algo, mode);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (!ok) {
+        std::cerr << "Error: Failed to compress " << input_dir << std::endl;
+        return 1;
+    }
+
+    printBatchSummary(batch, "DIRECTORY COMPRESSION COMPLETE", std::chrono::duration<double>(end - start).count());
+    std::cout << "\nSuccess: " << output_dir << " (" << BatchCompressor::MANIFEST_NAME << ")" << std::endl;
+    return 0;
+}
+
+int decompressDir(const std::string& input_dir, const std::string& output_dir, const CliOptions& options) {
+    BatchCompressor batch;
+    batch.setThreads(options.threads);
+    batch.setMemoryLimit(options.memory_limit);
+    if (!options.dict_path.empty()) {
+        auto dictionary = ZstdDictionary::load(options.dict_path);
+        if (!dictionary) return 1;
+        batch.setDictionary(dictionary);
+    }
+
+    std::cout << "\nDecompressing " << input_dir << "..." << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ok = batch.decompressDirectory(input_dir, output_dir);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (!ok) {
+        std::cerr << "Error: Failed to decompress " << input_dir << std::endl;
+        return 1;
+    }
+
+    printBatchSummary(batch, "DIRECTORY DECOMPRESSION COMPLETE", std::chrono::duration<double>(end - start).count());
+    std::cout << "\nSuccess: " << output_dir << std::endl;
+    return 0;
+}
+
+// Trains one ZSTD dictionary for all shards of a model. The sample budget
+// (about 100x the dictionary, as ZDICT recommends) is spread over the
+// shards in proportion to their size, a few windows from every chunk.
+int trainDict(const std::string& output, const std::vector<std::string>& shards, const CliOptions& options) {
+    const size_t window = 8 << 10;
+    const double budget = 100.0 * options.dict_size;
+
+    std::vector<std::unique_ptr<SafetensorsParser>> parsers;
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        parsers.push_back(std::make_unique<SafetensorsParser>());
+        if (!parsers.back()->parse(shard)) return 1;
+        total += parsers.back()->getTensorDataSize();
+    }
+    if (total == 0) {
+        std::cerr << "Error: No tensor data to sample" << std::endl;
+        return 1;
+    }
+
+    Compressor compressor;
+    ByteBuffer samples;
+    std::vector<size_t> sample_sizes;
+    double fraction = std::min(1.0, budget / total);
+    for (const auto& parser : parsers) {
+        compressor.addDictionarySamples(*parser, Compressor::OperationPoint::MAXIMUM, fraction, window,
+                                        samples, sample_sizes);
+    }
+
+    std::cout << "\nTraining " << (options.dict_size >> 10) << " KB dictionary from " << sample_sizes.size()
+              << " samples (" << std::fixed << std::setprecision(2) << (samples.size() / 1024.0 / 1024.0)
+              << " MB) of " << shards.size() << " shard(s)..." << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<uint8_t> dictionary;
+    try {
+        dictionary = ZstdDictionary::train(samples, sample_sizes, options.dict_size);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::ofstream file(output, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot create output file" << std::endl;
+        return 1;
+    }
+    file.write(reinterpret_cast<const char*>(dictionary.data()), dictionary.size());
+    file.close();
+
+    auto trained = ZstdDictionary::fromBytes(dictionary);
+    std::cout << "Dictionary ID " << (trained ? trained->getID() : 0) << ", " << dictionary.size()
+              << " bytes in " << std::setprecision(2) << duration.count() << " s" << std::endl;
     std::cout << "\nSuccess: " << output << std::endl;
     return 0;
 }
 
-int benchmark(const std::string& input, const std::string& mode_str) {
+// Applies the repetition, cold-input and pinning options. Pinned runs
+// default to one thread per pinned CPU.
+bool configureBenchmarker(Benchmarker& benchmarker, const SafetensorsParser& parser, const CliOptions& options) {
+    benchmarker.setTensors(parser.getTensors());
+    benchmarker.setWarmup(options.warmup);
+    benchmarker.setRepetitions(options.repetitions);
+    if (!options.pin_cpus.empty() && !benchmarker.setCpuPinning(options.pin_cpus)) {
+        std::cerr << "Error: Cannot pin threads to the requested CPUs" << std::endl;
+        return false;
+    }
+    unsigned threads = options.threads;
+    if (threads == 0 && !options.pin_cpus.empty()) threads = static_cast<unsigned>(options.pin_cpus.size());
+    benchmarker.setThreads(threads);
+    if (options.cold_input) {
+        if (!parser.dropPageCache()) {
+            std::cerr << "Error: Cannot evict the input from the page cache" << std::endl;
+            return false;
+        }
+        benchmarker.setColdInput([&parser] { parser.dropPageCache(); });
+    }
+    return true;
+}
+
+int benchmark(const std::string& input, const std::string& mode_str, const CliOptions& options) {
     SafetensorsParser parser;
     if (!parser.parse(input)) return 1;
 
     Benchmarker benchmarker;
+    if (!configureBenchmarker(benchmarker, parser, options)) return 1;
     std::vector<Benchmarker::BenchmarkResult> results;
     
     if (mode_str.empty()) {
@@ -162,16 +680,25 @@ int benchmark(const std::string& input, const std::string& mode_str) {
     benchmarker.saveResultsJSON(results, "output/benchmark_results.json");
     benchmarker.saveResultsCSV(results, "output/benchmark_results.csv");
 
+    // Thread scaling at the requested mode (fast for the full benchmark)
+    Compressor::OperationPoint scaling_mode = mode_str.empty() ? Compressor::OperationPoint::FAST
+                                                               : parseMode(mode_str);
+    std::vector<Benchmarker::ScalingResult> scaling =
+        benchmarker.runThreadScaling(parser.getTensorData(), scaling_mode);
+    benchmarker.printScalingTable(scaling);
+    benchmarker.saveScalingCSV(scaling, "output/thread_scaling.csv");
+
     return 0;
 }
 
-int compare(const std::string& input, const std::string& mode_str) {
+int compare(const std::string& input, const std::string& mode_str, const CliOptions& options) {
     SafetensorsParser parser;
     if (!parser.parse(input)) return 1;
 
     Compressor::OperationPoint mode = parseMode(mode_str.empty() ? "balanced" : mode_str);
     
     Benchmarker benchmarker;
+    if (!configureBenchmarker(benchmarker, parser, options)) return 1;
     std::vector<Benchmarker::BenchmarkResult> results = 
         benchmarker.runAlgorithmComparison(parser.getTensorData(), mode);
 
@@ -182,31 +709,200 @@ int compare(const std::string& input, const std::string& mode_str) {
     return 0;
 }
 
+// Every level and variant of the chosen backends against the chosen
+// preprocessing strategies; the whole payload is swept as one block
+int sweep(const std::string& input, const std::string& algo_list, const std::string& strategy_list,
+          const CliOptions& options) {
+    LevelSweep sweeper;
+    if (!algo_list.empty()) {
+        std::vector<Compressor::Algorithm> algorithms;
+        if (!parseAlgorithmList(algo_list, algorithms)) {
+            std::cerr << "Error: Invalid algorithm list: " << algo_list << std::endl;
+            return 1;
+        }
+        sweeper.setAlgorithms(algorithms);
+    }
+    if (!strategy_list.empty()) {
+        std::vector<Preprocessor::Strategy> strategies;
+        if (!parseStrategyList(strategy_list, strategies)) {
+            std::cerr << "Error: Invalid strategy list: " << strategy_list << std::endl;
+            return 1;
+        }
+        sweeper.setStrategies(strategies);
+    }
+    sweeper.setThreads(options.threads);
+    sweeper.setWarmup(options.warmup);
+    sweeper.setRepetitions(options.repetitions);
+    sweeper.setMemoryLimit(options.memory_limit);
+
+    SafetensorsParser parser;
+    if (!parser.parse(input)) return 1;
+
+    std::vector<LevelSweep::Point> points = sweeper.run(parser.getTensorData());
+    sweeper.printFrontier(points);
+    sweeper.saveJSON(points, "output/sweep_results.json");
+    sweeper.saveCSV(points, "output/sweep_results.csv", false);
+    sweeper.saveCSV(points, "output/sweep_frontier.csv", true);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         printUsage(argv[0]);
         return 1;
     }
 
-    std::string cmd = argv[1];
+    // Split "--option value" pairs from the positional arguments
+    CliOptions options;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--memory-limit" && i + 1 < argc) {
+            if (!parseSize(argv[++i], options.memory_limit)) {
+                std::cerr << "Error: Invalid memory limit: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            unsigned long threads = 0;
+            try {
+                threads = std::stoul(argv[++i]);
+            } catch (const std::exception&) {}
+            if (threads == 0 || threads > 4096) {
+                std::cerr << "Error: Invalid thread count: " << argv[i] << std::endl;
+                return 1;
+            }
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "--strategy" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value != "auto" && value != "dtype") {
+                std::cerr << "Error: Invalid strategy: " << value << " (expected auto or dtype)" << std::endl;
+                return 1;
+            }
+            options.auto_strategy = (value == "auto");
+        } else if (arg == "--min-gain" && i + 1 < argc) {
+            double percent = -1.0;
+            try {
+                percent = std::stod(argv[++i]);
+            } catch (const std::exception&) {}
+            if (!(percent >= 0.0 && percent < 100.0)) {
+                std::cerr << "Error: Invalid minimum gain: " << argv[i] << " (expected a percentage)" << std::endl;
+                return 1;
+            }
+            options.min_gain = percent / 100.0;
+        } else if (arg == "--io" && i + 1 < argc) {
+            // Process-wide: every AsyncIO created from here on uses it
+            std::string value = argv[++i];
+            if (value == "auto") AsyncIO::setPreferredBackend(AsyncIO::Backend::AUTO);
+            else if (value == "uring") AsyncIO::setPreferredBackend(AsyncIO::Backend::IO_URING);
+            else if (value == "threads") AsyncIO::setPreferredBackend(AsyncIO::Backend::THREADS);
+            else {
+                std::cerr << "Error: Invalid I/O backend: " << value << " (expected auto, uring or threads)" << std::endl;
+                return 1;
+            }
+        } else if ((arg == "--warmup" || arg == "--repeat") && i + 1 < argc) {
+            unsigned long rounds = 0;
+            bool valid = true;
+            try {
+                rounds = std::stoul(argv[++i]);
+            } catch (const std::exception&) {
+                valid = false;
+            }
+            if (!valid || rounds > 1000 || (arg == "--repeat" && rounds == 0)) {
+                std::cerr << "Error: Invalid round count: " << argv[i] << std::endl;
+                return 1;
+            }
+            (arg == "--warmup" ? options.warmup : options.repetitions) = static_cast<unsigned>(rounds);
+        } else if (arg == "--cold") {
+            options.cold_input = true;
+        } else if (arg == "--pin" && i + 1 < argc) {
+            if (!parseCpuList(argv[++i], options.pin_cpus)) {
+                std::cerr << "Error: Invalid CPU list: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--quantize" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value != "4" && value != "8") {
+                std::cerr << "Error: Invalid quantization: " << value << " (expected 4 or 8)" << std::endl;
+                return 1;
+            }
+            options.quant_bits = static_cast<unsigned>(std::stoul(value));
+        } else if (arg == "--block-size" && i + 1 < argc) {
+            unsigned long block_size = 0;
+            try {
+                block_size = std::stoul(argv[++i]);
+            } catch (const std::exception&) {}
+            if (block_size == 0 || block_size > (1u << 24)) {
+                std::cerr << "Error: Invalid block size: " << argv[i] << std::endl;
+                return 1;
+            }
+            options.quant_block_size = block_size;
+        } else if (arg == "--dict" && i + 1 < argc) {
+            options.dict_path = argv[++i];
+        } else if (arg == "--dict-size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], options.dict_size) || options.dict_size < 1024) {
+                std::cerr << "Error: Invalid dictionary size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string& cmd = args[0];
+    const size_t nargs = args.size() + 1;  // Count as argc would, including the program name
 
-    if (cmd == "compress" && argc >= 4) {
-        std::string algo = (argc >= 5) ? argv[4] : "zstd";
-        std::string mode = (argc >= 6) ? argv[5] : "balanced";
-        return compress(argv[2], argv[3], algo, mode);
+    if (cmd == "compress" && nargs >= 4) {
+        std::string algo = (nargs >= 5) ? args[3] : "zstd";
+        std::string mode = (nargs >= 6) ? args[4] : "balanced";
+        return compress(args[1], args[2], algo, mode, options);
     } 
-    else if (cmd == "decompress" && argc >= 4) {
-        return decompress(argv[2], argv[3]);
+    else if (cmd == "decompress" && nargs >= 4) {
+        return decompress(args[1], args[2], options);
     } 
-    else if (cmd == "benchmark" && argc >= 3) {
-        std::string mode = (argc >= 4) ? argv[3] : "";
-        return benchmark(argv[2], mode);
+    else if (cmd == "extract" && nargs >= 5) {
+        return extract(args[1], args[2], args[3], options);
+    }
+    else if (cmd == "verify" && nargs >= 3) {
+        bool quick = (nargs >= 4 && args[2] == "quick");
+        return verify(args[1], quick, options);
+    }
+    else if (cmd == "compress-dir" && nargs >= 4) {
+        std::string algo = (nargs >= 5) ? args[3] : "zstd";
+        std::string mode = (nargs >= 6) ? args[4] : "balanced";
+        return compressDir(args[1], args[2], algo, mode, options);
+    }
+    else if (cmd == "decompress-dir" && nargs >= 4) {
+        return decompressDir(args[1], args[2], options);
     }
-    else if (cmd == "compare" && argc >= 3) {
-        std::string mode = (argc >= 4) ? argv[3] : "balanced";
-        return compare(argv[2], mode);
+    else if (cmd == "benchmark" && nargs >= 3) {
+        std::string mode = (nargs >= 4) ? args[2] : "";
+        return benchmark(args[1], mode, options);
+    }
+    else if (cmd == "compare" && nargs >= 3) {
+        std::string mode = (nargs >= 4) ? args[2] : "balanced";
+        return compare(args[1], mode, options);
+    }
+    else if (cmd == "sweep" && nargs >= 3) {
+        std::string algos = (nargs >= 4) ? args[2] : "";
+        std::string strategies = (nargs >= 5) ? args[3] : "";
+        return sweep(args[1], algos, strategies, options);
+    }
+    else if (cmd == "quantize" && nargs >= 4) {
+        std::string bits = (nargs >= 5) ? args[3] : "4";
+        if (bits != "4" && bits != "8") {
+            std::cerr << "Error: Invalid quantization: " << bits << " (expected 4 or 8)" << std::endl;
+            return 1;
+        }
+        return quantize(args[1], args[2], static_cast<unsigned>(std::stoul(bits)), options);
+    }
+    else if (cmd == "train-dict" && nargs >= 4) {
+        return trainDict(args[1], std::vector<std::string>(args.begin() + 2, args.end()), options);
     }
 
     printUsage(argv[0]);
     return 1;
-}
\ No newline at end of file
+}
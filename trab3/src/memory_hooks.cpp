@@ -0,0 +1,86 @@
+#include "../includes/memory_tracker.hpp"
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+// Replacement global allocation functions that count live heap bytes for
+// MemoryTracker. Only the compressor executable links this file; a library
+// must not replace the allocator of the program that loads it.
+
+namespace {
+
+void* allocate(size_t size, size_t alignment) {
+    if (size == 0) size = 1;
+    for (;;) {
+        void* p;
+        if (alignment <= alignof(std::max_align_t)) {
+            p = std::malloc(size);
+        } else {
+            // aligned_alloc wants a multiple of the alignment
+            p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        if (p) {
+            MemoryTracker::recordAllocation(malloc_usable_size(p));
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) return nullptr;
+        handler();
+    }
+}
+
+void release(void* p) noexcept {
+    if (!p) return;
+    MemoryTracker::recordRelease(malloc_usable_size(p));
+    std::free(p);
+}
+
+void* allocateOrThrow(size_t size, size_t alignment) {
+    if (void* p = allocate(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+const bool registered = (MemoryTracker::setHeapTracked(true), true);
+
+} // namespace
+
+void* operator new(size_t size) { return allocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return allocateOrThrow(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size, 0);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size, static_cast<size_t>(alignment));
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
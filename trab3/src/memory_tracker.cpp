@@ -0,0 +1,53 @@
+#include "../includes/memory_tracker.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+uint64_t MemoryTracker::residentBytes() {
+    // statm: size resident shared text lib data dt, in pages
+    int fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    char buffer[128];
+    ssize_t n = ::read(fd, buffer, sizeof(buffer) - 1);
+    ::close(fd);
+    if (n <= 0) return 0;
+    buffer[n] = '\0';
+
+    unsigned long long size = 0, resident = 0;
+    if (std::sscanf(buffer, "%llu %llu", &size, &resident) != 2) return 0;
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return resident * page_size;
+}
+
+MemoryTracker::PhaseMeter::PhaseMeter(std::chrono::microseconds interval)
+    : start_heap_(liveHeapBytes()),
+      start_resident_(residentBytes()),
+      max_resident_(start_resident_) {
+    peak_.store(start_heap_, std::memory_order_relaxed);
+    sampler_ = std::thread([this, interval] {
+        while (running_.load(std::memory_order_relaxed)) {
+            uint64_t rss = residentBytes();
+            if (rss > max_resident_.load(std::memory_order_relaxed)) max_resident_.store(rss);
+            std::this_thread::sleep_for(interval);
+        }
+    });
+}
+
+MemoryTracker::PhaseMeter::~PhaseMeter() {
+    if (sampler_.joinable()) stop();
+}
+
+MemoryTracker::PhaseMemory MemoryTracker::PhaseMeter::stop() {
+    // One last sample, in case the phase was shorter than the interval
+    uint64_t rss = residentBytes();
+    running_ = false;
+    if (sampler_.joinable()) sampler_.join();
+
+    PhaseMemory memory;
+    memory.resident_max_bytes = std::max(max_resident_.load(), rss);
+    memory.resident_peak_bytes = memory.resident_max_bytes - std::min(memory.resident_max_bytes, start_resident_);
+    uint64_t peak = peak_.load(std::memory_order_relaxed);
+    memory.heap_peak_bytes = peak > start_heap_ ? peak - start_heap_ : 0;
+    return memory;
+}
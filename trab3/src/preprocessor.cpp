@@ -1,77 +1,503 @@
 #include "../includes/preprocessor.hpp"
+#include "../includes/shuffle_kernels.hpp"
 #include <cmath>
 #include <map>
 #include <cstring>
+#include <algorithm>
+#include <stdexcept>
 
-std::vector<uint8_t> Preprocessor::preprocess(const std::vector<uint8_t>& data, Strategy strategy) {
+namespace {
+
+// u32 row length in front of the 2D strategies' planes
+const size_t ROW_HEADER_SIZE = 4;
+
+} // namespace
+
+std::vector<uint8_t> Preprocessor::preprocess(std::span<const uint8_t> data, Strategy strategy, unsigned threads,
+                                              size_t row_length) {
     switch (strategy) {
-        case Strategy::NONE: return data;
-        case Strategy::BYTE_REORDER: return byteReorder(data);
         case Strategy::DELTA_ENCODING: return deltaEncode(data);
         case Strategy::BF16_TO_FP16: return bf16ToFp16(data);
         case Strategy::COMBINED: return combinedPreprocess(data);
         case Strategy::BYTE_REORDER_DELTA: return byteReorderDelta(data);
-        case Strategy::BIT_PLANE_SEPARATION: return bitPlaneSeparation(data);
+        default: break;
     }
-    return data;
+    std::vector<uint8_t> out(preprocessedSize(data.size(), strategy));
+    preprocess(data, out, strategy, threads, row_length);
+    return out;
 }
 
-std::vector<uint8_t> Preprocessor::deprocess(const std::vector<uint8_t>& data, Strategy strategy) {
+std::vector<uint8_t> Preprocessor::deprocess(std::span<const uint8_t> data, Strategy strategy, unsigned threads) {
     switch (strategy) {
-        case Strategy::NONE: return data;
-        case Strategy::BYTE_REORDER: return byteDeorder(data);
         case Strategy::DELTA_ENCODING: return deltaDecode(data);
         case Strategy::BF16_TO_FP16: return fp16ToBf16(data);
         case Strategy::COMBINED: return combinedDeprocess(data);
         case Strategy::BYTE_REORDER_DELTA: return byteReorderDeltaInverse(data);
-        case Strategy::BIT_PLANE_SEPARATION: return bitPlaneReconstruction(data);
+        default: break;
+    }
+    // Bit planes do not record the value count: take every padded slot,
+    // plus the odd byte stored after the planes
+    size_t size = data.size();
+    if (strategy == Strategy::BIT_PLANE_SEPARATION && size >= 2) size = size / 16 * 16 + (size % 16 == 1);
+    if (predictElementSize(strategy)) size -= std::min(size, ROW_HEADER_SIZE);
+
+    // Nor do the field streams; whole values are preferred over a trailing
+    // odd byte when both explain the size
+    if (strategy == Strategy::FIELD_SPLIT_F32) {
+        // Each value adds 4 or 5 bytes, so the count is the only one that
+        // leaves a tail shorter than a value
+        size_t count = size * 8 / 33;
+        while (count > 0 && fieldStreamsSize32(count) > size) --count;
+        while (fieldStreamsSize32(count + 1) <= size) ++count;
+        size = 4 * count + (size - fieldStreamsSize32(count));
+    }
+    if (unsigned exp_bits = fieldExponentBits(strategy)) {
+        size_t count = size * 8 / (24 - exp_bits);
+        while (count > 0 && fieldStreamsSize(count, exp_bits) > size) --count;
+        while (fieldStreamsSize(count + 1, exp_bits) <= size) ++count;
+        size = 2 * count + (size - fieldStreamsSize(count, exp_bits) == 1 ? 1 : 0);
+    }
+
+    // Padding to whole bytes can map nearby raw sizes to the same length;
+    // returning the guess would silently add or drop bytes
+    size_t padding = strategy == Strategy::BIT_PLANE_SEPARATION ? 16 : 8;
+    for (size_t other = size - std::min(size, padding); other <= size + padding; ++other) {
+        if (other != size && preprocessedSize(other, strategy) == data.size()) {
+            throw std::invalid_argument(getStrategyName(strategy) + ": " + std::to_string(data.size()) +
+                                        " preprocessed bytes do not determine the raw size");
+        }
     }
-    return data;
+    std::vector<uint8_t> out(size);
+    deprocess(data, out, strategy, threads);
+    return out;
 }
 
-std::vector<uint8_t> Preprocessor::byteReorder(const std::vector<uint8_t>& data) {
-    size_t num_values = data.size() / 2;
-    std::vector<uint8_t> reordered(data.size());
+void Preprocessor::preprocess(std::span<const uint8_t> data, std::span<uint8_t> out, Strategy strategy, unsigned threads,
+                              size_t row_length) {
+    switch (strategy) {
+        case Strategy::NONE:
+            if (!data.empty()) memcpy(out.data(), data.data(), data.size());
+            return;
+        case Strategy::BYTE_REORDER: byteReorder(data, out); return;
+        case Strategy::BIT_PLANE_SEPARATION: bitPlaneSeparation(data, out, threads); return;
+        case Strategy::BYTE_REORDER_32: byteSplit(data, out, 4); return;
+        case Strategy::BYTE_REORDER_64: byteSplit(data, out, 8); return;
+        case Strategy::FIELD_SPLIT_BF16: fieldSplit(data, out, 8, threads); return;
+        case Strategy::FIELD_SPLIT_F16: fieldSplit(data, out, 5, threads); return;
+        case Strategy::FIELD_SPLIT_F32: fieldSplit32(data, out); return;
+        case Strategy::XOR_DELTA_32: xorDelta32(data, out); return;
+        case Strategy::XOR_2D_16: xorPredict2D(data, out, 2, row_length, false); return;
+        case Strategy::XOR_2D_32: xorPredict2D(data, out, 4, row_length, false); return;
+        case Strategy::XOR_PLANE_16: xorPredict2D(data, out, 2, row_length, true); return;
+        case Strategy::XOR_PLANE_32: xorPredict2D(data, out, 4, row_length, true); return;
+        default: break;
+    }
+    // The sequential delta/conversion transforms keep their vector form
+    std::vector<uint8_t> result = preprocess(data, strategy, threads);
+    if (!result.empty()) memcpy(out.data(), result.data(), std::min(result.size(), out.size()));
+}
 
-    // Two-pass: sequential writes for cache efficiency
-    size_t src_idx = 0;
-    // First pass: copy all high bytes
-    for (size_t i = 0; i < num_values; ++i) {
-        reordered[i] = data[src_idx];
-        src_idx += 2;
+void Preprocessor::deprocess(std::span<const uint8_t> data, std::span<uint8_t> out, Strategy strategy, unsigned threads) {
+    switch (strategy) {
+        case Strategy::NONE:
+            if (!data.empty()) memcpy(out.data(), data.data(), data.size());
+            return;
+        case Strategy::BYTE_REORDER: byteDeorder(data, out); return;
+        case Strategy::BIT_PLANE_SEPARATION: bitPlaneReconstruction(data, out, threads); return;
+        case Strategy::BYTE_REORDER_32: byteMerge(data, out, 4); return;
+        case Strategy::BYTE_REORDER_64: byteMerge(data, out, 8); return;
+        case Strategy::FIELD_SPLIT_BF16: fieldMerge(data, out, 8, threads); return;
+        case Strategy::FIELD_SPLIT_F16: fieldMerge(data, out, 5, threads); return;
+        case Strategy::FIELD_SPLIT_F32: fieldMerge32(data, out); return;
+        case Strategy::XOR_DELTA_32: xorDeltaInverse32(data, out); return;
+        case Strategy::XOR_2D_16: xorReconstruct2D(data, out, 2, false); return;
+        case Strategy::XOR_2D_32: xorReconstruct2D(data, out, 4, false); return;
+        case Strategy::XOR_PLANE_16: xorReconstruct2D(data, out, 2, true); return;
+        case Strategy::XOR_PLANE_32: xorReconstruct2D(data, out, 4, true); return;
+        default: break;
     }
-    // Second pass: copy all low bytes
-    src_idx = 1;
-    for (size_t i = 0; i < num_values; ++i) {
-        reordered[num_values + i] = data[src_idx];
-        src_idx += 2;
+    std::vector<uint8_t> result = deprocess(data, strategy, threads);
+    if (!result.empty()) memcpy(out.data(), result.data(), std::min(result.size(), out.size()));
+}
+
+void Preprocessor::preprocessTiled(std::span<const uint8_t> data, Strategy strategy, size_t tile_bytes,
+                                   ByteBuffer& scratch, const std::function<void(std::span<const uint8_t>)>& sink,
+                                   unsigned threads, size_t row_length) {
+    if (size_t elem_size = predictElementSize(strategy)) {
+        // Residuals depend only on the raw input, so each tile computes
+        // its own (reaching back a row into data) before the plane shuffle
+        size_t count = data.size() / elem_size;
+        uint32_t stored = storedRowLength(row_length, count);
+        uint8_t header[ROW_HEADER_SIZE];
+        memcpy(header, &stored, ROW_HEADER_SIZE);
+        sink(std::span<const uint8_t>(header, ROW_HEADER_SIZE));
+
+        size_t row_bytes = (stored ? stored : count) * elem_size;
+        size_t tile = std::max<size_t>(1, tile_bytes / elem_size);
+        size_t tile_size = std::min(count, tile) * elem_size;
+        scratch.resize(2 * tile_size);
+        uint8_t* residuals = scratch.data();
+        uint8_t* planes = residuals + tile_size;
+        for (size_t plane = 0; plane < elem_size; ++plane) {
+            for (size_t first = 0; first < count; first += tile) {
+                size_t n = std::min(tile, count - first);
+                predict2DRange(data.data(), residuals, first * elem_size, (first + n) * elem_size,
+                               elem_size, row_bytes, isPlanarPrediction(strategy));
+                shuffle::byteShuffle(residuals, planes, n, elem_size);
+                sink(std::span<const uint8_t>(planes + plane * n, n));
+            }
+        }
+        size_t body = count * elem_size;
+        if (body < data.size()) sink(data.subspan(body));
+        return;
+    }
+
+    if (unsigned exp_bits = fieldExponentBits(strategy)) {
+        // Same idea for the three field streams: tiles of whole 8-value
+        // groups produce runs that concatenate into each whole stream
+        size_t count = data.size() / 2;
+        size_t tile = std::max<size_t>(8, tile_bytes / 2 / 8 * 8);
+        scratch.resize(fieldStreamsSize(std::min(count, tile), exp_bits));
+        for (int stream = 0; stream < 3; ++stream) {
+            for (size_t first = 0; first < count; first += tile) {
+                size_t n = std::min(tile, count - first);
+                uint8_t* exps = scratch.data();
+                uint8_t* signs = exps + n;
+                uint8_t* mants = signs + (n + 7) / 8;
+                shuffle::fieldSplit16(data.data() + 2 * first, exps, signs, mants, n, exp_bits);
+                if (stream == 0) sink(std::span<const uint8_t>(exps, n));
+                if (stream == 1) sink(std::span<const uint8_t>(signs, mants - signs));
+                if (stream == 2) sink(std::span<const uint8_t>(mants, (n * (15 - exp_bits) + 7) / 8));
+            }
+        }
+        if (data.size() % 2) sink(data.subspan(data.size() - 1));
+        return;
+    }
+
+    size_t elem_size = planeElementSize(strategy);
+    if (elem_size == 0) {
+        scratch.resize(preprocessedSize(data.size(), strategy));
+        preprocess(data, scratch, strategy, threads);
+        sink(scratch);
+        return;
+    }
+
+    // Plane p of a tile is one contiguous run of its shuffled copy. The tile
+    // is re-shuffled for every plane, which is cheap while it sits in cache
+    // and keeps the scratch at one tile instead of the whole output.
+    size_t count = data.size() / elem_size;
+    size_t tile = std::max<size_t>(1, tile_bytes / elem_size);
+    scratch.resize(std::min(count, tile) * elem_size);
+    for (size_t plane = 0; plane < elem_size; ++plane) {
+        for (size_t first = 0; first < count; first += tile) {
+            size_t n = std::min(tile, count - first);
+            shuffle::byteShuffle(data.data() + first * elem_size, scratch.data(), n, elem_size);
+            sink(std::span<const uint8_t>(scratch.data() + plane * n, n));
+        }
+    }
+
+    // Same tail as the whole-buffer form
+    size_t body = count * elem_size;
+    if (body < data.size()) sink(data.subspan(body));
+}
+
+size_t Preprocessor::preprocessedSize(size_t raw_size, Strategy strategy) {
+    if (strategy == Strategy::BIT_PLANE_SEPARATION && raw_size >= 2) {
+        return 16 * ((raw_size / 2 + 7) / 8) + raw_size % 2;
+    }
+    if (strategy == Strategy::FIELD_SPLIT_F32) {
+        return fieldStreamsSize32(raw_size / 4) + raw_size % 4;
+    }
+    if (unsigned exp_bits = fieldExponentBits(strategy)) {
+        return fieldStreamsSize(raw_size / 2, exp_bits) + raw_size % 2;
+    }
+    if (predictElementSize(strategy)) return ROW_HEADER_SIZE + raw_size;
+    return raw_size;
+}
+
+unsigned Preprocessor::fieldExponentBits(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::FIELD_SPLIT_BF16: return 8;
+        case Strategy::FIELD_SPLIT_F16: return 5;
+        default: return 0;
+    }
+}
+
+size_t Preprocessor::fieldStreamsSize(size_t count, unsigned exp_bits) {
+    return count + (count + 7) / 8 + (count * (15 - exp_bits) + 7) / 8;
+}
+
+size_t Preprocessor::fieldStreamsSize32(size_t count) {
+    return count + (count + 7) / 8 + 3 * count;
+}
+
+size_t Preprocessor::predictElementSize(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::XOR_2D_16: return 2;
+        case Strategy::XOR_2D_32: return 4;
+        case Strategy::XOR_PLANE_16: return 2;
+        case Strategy::XOR_PLANE_32: return 4;
+        default: return 0;
+    }
+}
+
+bool Preprocessor::isPlanarPrediction(Strategy strategy) {
+    return strategy == Strategy::XOR_PLANE_16 || strategy == Strategy::XOR_PLANE_32;
+}
+
+uint32_t Preprocessor::storedRowLength(size_t row_length, size_t count) {
+    return (row_length >= count || row_length > UINT32_MAX) ? 0 : static_cast<uint32_t>(row_length);
+}
+
+size_t Preprocessor::planeElementSize(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::BYTE_REORDER: return 2;
+        case Strategy::BYTE_REORDER_32: return 4;
+        case Strategy::BYTE_REORDER_64: return 8;
+        default: return 0;
     }
-    return reordered;
 }
 
-std::vector<uint8_t> Preprocessor::byteDeorder(const std::vector<uint8_t>& data) {
+// First half: byte 0 of every 16-bit value, second half: byte 1, then a
+// trailing odd byte unchanged. The original format wrote a zero there and
+// lost the byte; such archives still hold that zero and decode as before.
+void Preprocessor::byteReorder(std::span<const uint8_t> data, std::span<uint8_t> out) {
     size_t num_values = data.size() / 2;
-    std::vector<uint8_t> original(data.size());
+    shuffle::byteShuffle(data.data(), out.data(), num_values, 2);
+    if (data.size() % 2) out[2 * num_values] = data[2 * num_values];
+}
 
-    // Two-pass interleaving
-    size_t dst_idx = 0;
-    // First pass: place high bytes
-    for (size_t i = 0; i < num_values; ++i) {
-        original[dst_idx] = data[i];
-        dst_idx += 2;
+void Preprocessor::byteDeorder(std::span<const uint8_t> data, std::span<uint8_t> out) {
+    size_t num_values = data.size() / 2;
+    shuffle::byteUnshuffle(data.data(), out.data(), num_values, 2);
+    if (data.size() % 2) out[2 * num_values] = data[2 * num_values];
+}
+
+// Generalised byte planes for wider elements; bytes past the last whole
+// element are appended unchanged so any length round-trips
+void Preprocessor::byteSplit(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size) {
+    size_t num_values = data.size() / elem_size;
+    size_t body = num_values * elem_size;
+    shuffle::byteShuffle(data.data(), out.data(), num_values, elem_size);
+    if (data.size() > body) memcpy(out.data() + body, data.data() + body, data.size() - body);
+}
+
+void Preprocessor::byteMerge(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size) {
+    size_t num_values = data.size() / elem_size;
+    size_t body = num_values * elem_size;
+    shuffle::byteUnshuffle(data.data(), out.data(), num_values, elem_size);
+    if (data.size() > body) memcpy(out.data() + body, data.data() + body, data.size() - body);
+}
+
+// Exponents | sign bitmap | packed mantissas, then a trailing odd byte
+// unchanged. BYTE_REORDER puts the lowest exponent bit of a BF16 value in
+// the low byte with the mantissa; cutting at the field boundaries instead
+// gives the backend one stream of whole exponents (a few dominant values),
+// one of near-random sign bits and one of near-random mantissa bits.
+void Preprocessor::fieldSplit(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned exp_bits,
+                              unsigned threads) {
+    size_t count = data.size() / 2;
+    uint8_t* exps = out.data();
+    uint8_t* signs = exps + count;
+    uint8_t* mants = signs + (count + 7) / 8;
+    shuffle::fieldSplit16(data.data(), exps, signs, mants, count, exp_bits, threads);
+    if (data.size() % 2) out[out.size() - 1] = data[data.size() - 1];
+}
+
+void Preprocessor::fieldMerge(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned exp_bits,
+                              unsigned threads) {
+    size_t count = out.size() / 2;
+    const uint8_t* exps = data.data();
+    const uint8_t* signs = exps + count;
+    const uint8_t* mants = signs + (count + 7) / 8;
+    shuffle::fieldMerge16(exps, signs, mants, out.data(), count, exp_bits, threads);
+    if (out.size() % 2) out[out.size() - 1] = data[data.size() - 1];
+}
+
+// Exponents | sign bitmap | three byte planes of the 23-bit mantissas (low,
+// middle, top 7 bits), then the bytes past the last whole value unchanged.
+// Four-way byte planes put the sign and 7 exponent bits in one plane and
+// the last exponent bit in front of the mantissa; here the exponents form
+// one stream of a few dominant values and the mantissa planes stay aligned.
+void Preprocessor::fieldSplit32(std::span<const uint8_t> data, std::span<uint8_t> out) {
+    size_t count = data.size() / 4;
+    uint8_t* exps = out.data();
+    uint8_t* signs = exps + count;
+    uint8_t* mant0 = signs + (count + 7) / 8;
+    uint8_t* mant1 = mant0 + count;
+    uint8_t* mant2 = mant1 + count;
+    for (size_t group = 0; group < count; group += 8) {
+        size_t end = std::min(count, group + 8);
+        uint8_t sign_bits = 0;
+        for (size_t i = group; i < end; ++i) {
+            uint32_t v;
+            memcpy(&v, data.data() + 4 * i, 4);
+            exps[i] = static_cast<uint8_t>(v >> 23);
+            sign_bits |= static_cast<uint8_t>((v >> 31) << (i - group));
+            mant0[i] = static_cast<uint8_t>(v);
+            mant1[i] = static_cast<uint8_t>(v >> 8);
+            mant2[i] = static_cast<uint8_t>((v >> 16) & 0x7f);
+        }
+        signs[group / 8] = sign_bits;
     }
-    // Second pass: place low bytes
-    dst_idx = 1;
-    for (size_t i = 0; i < num_values; ++i) {
-        original[dst_idx] = data[num_values + i];
-        dst_idx += 2;
+    size_t body = 4 * count;
+    if (data.size() > body) memcpy(mant2 + count, data.data() + body, data.size() - body);
+}
+
+void Preprocessor::fieldMerge32(std::span<const uint8_t> data, std::span<uint8_t> out) {
+    size_t count = out.size() / 4;
+    const uint8_t* exps = data.data();
+    const uint8_t* signs = exps + count;
+    const uint8_t* mant0 = signs + (count + 7) / 8;
+    const uint8_t* mant1 = mant0 + count;
+    const uint8_t* mant2 = mant1 + count;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v = (static_cast<uint32_t>((signs[i / 8] >> (i % 8)) & 1) << 31) |
+                     (static_cast<uint32_t>(exps[i]) << 23) | (static_cast<uint32_t>(mant2[i]) << 16) |
+                     (static_cast<uint32_t>(mant1[i]) << 8) | mant0[i];
+        memcpy(out.data() + 4 * i, &v, 4);
     }
-    return original;
+    size_t body = 4 * count;
+    if (out.size() > body) memcpy(out.data() + body, mant2 + count, out.size() - body);
+}
+
+// Every 4-byte value XORed with the one before it, then split into byte
+// planes. Neighbouring values of smooth tensors (optimizer moments, running
+// statistics) share their sign, exponent and top mantissa bits, which the
+// XOR turns into zero bytes; unlike an integer difference it never carries
+// into the exponent.
+void Preprocessor::xorDelta32(std::span<const uint8_t> data, std::span<uint8_t> out) {
+    size_t count = data.size() / 4;
+    ByteBuffer deltas(4 * count);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v;
+        memcpy(&v, data.data() + 4 * i, 4);
+        uint32_t delta = v ^ prev;
+        memcpy(deltas.data() + 4 * i, &delta, 4);
+        prev = v;
+    }
+    shuffle::byteShuffle(deltas.data(), out.data(), count, 4);
+    size_t body = 4 * count;
+    if (data.size() > body) memcpy(out.data() + body, data.data() + body, data.size() - body);
+}
+
+void Preprocessor::xorDeltaInverse32(std::span<const uint8_t> data, std::span<uint8_t> out) {
+    size_t count = out.size() / 4;
+    shuffle::byteUnshuffle(data.data(), out.data(), count, 4);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v;
+        memcpy(&v, out.data() + 4 * i, 4);
+        prev ^= v;
+        memcpy(out.data() + 4 * i, &prev, 4);
+    }
+    size_t body = 4 * count;
+    if (out.size() > body) memcpy(out.data() + body, data.data() + body, out.size() - body);
+}
+
+// u32 row length | byte planes of the residuals | bytes past the last whole
+// value unchanged. The vertical form XORs each value with the one a row
+// above it; rows of a weight matrix share the scale of their column (an
+// input feature), so the sign, exponent and top mantissa bits of vertical
+// neighbours agree more often than those of a flat predecessor, which
+// straddles two unrelated output units at every row start. The planar form
+// XORs with up ^ left ^ up-left, which also cancels what a value shares
+// with its row. Both use the left neighbour in the first row and keep the
+// first value; the planar one uses the value above in the first column.
+// Planar prediction is the vertical one applied to the row-wise left
+// residuals, and XOR commutes with the byte shuffle, so the planes are
+// built first and predicted in place, one vector pass per row and plane.
+void Preprocessor::xorPredict2D(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size,
+                                size_t row_length, bool planar) {
+    size_t count = data.size() / elem_size;
+    uint32_t stored = storedRowLength(row_length, count);
+    memcpy(out.data(), &stored, ROW_HEADER_SIZE);
+
+    uint8_t* planes = out.data() + ROW_HEADER_SIZE;
+    shuffle::byteShuffle(data.data(), planes, count, elem_size);
+    size_t row = stored ? stored : count;
+    for (size_t b = 0; b < elem_size; ++b) {
+        uint8_t* plane = planes + b * count;
+        if (planar) {
+            for (size_t first = 0; first < count; first += row) {
+                shuffle::xorPredict(plane + first, std::min(row, count - first), 1);
+            }
+            shuffle::xorPredict(plane, count, row);
+            continue;
+        }
+        // Rows below the first read the original first row, so it goes last
+        shuffle::xorPredict(plane, count, row);
+        shuffle::xorPredict(plane, row, 1);
+    }
+    size_t body = count * elem_size;
+    if (data.size() > body) memcpy(planes + body, data.data() + body, data.size() - body);
 }
 
-std::vector<uint8_t> Preprocessor::deltaEncode(const std::vector<uint8_t>& data) {
+// Unshuffles the residuals straight into out and undoes the prediction
+// there. Vertical: first row first, then every later row is one vector XOR
+// with the restored row above it. Planar: the same column pass over all
+// rows restores the left residuals, which each row then undoes on its own.
+void Preprocessor::xorReconstruct2D(std::span<const uint8_t> data, std::span<uint8_t> out, size_t elem_size,
+                                    bool planar) {
+    if (out.empty()) return;
+    size_t count = out.size() / elem_size;
+    uint32_t stored;
+    memcpy(&stored, data.data(), ROW_HEADER_SIZE);
+    size_t row = (stored && stored < count) ? stored : count;
+
+    const uint8_t* planes = data.data() + ROW_HEADER_SIZE;
+    shuffle::byteUnshuffle(planes, out.data(), count, elem_size);
+    if (planar) {
+        shuffle::xorReconstruct(out.data(), count * elem_size, row * elem_size);
+        for (size_t first = 0; first < count; first += row) {
+            shuffle::xorReconstruct(out.data() + first * elem_size, std::min(row, count - first) * elem_size,
+                                    elem_size);
+        }
+    } else {
+        shuffle::xorReconstruct(out.data(), row * elem_size, elem_size);
+        shuffle::xorReconstruct(out.data(), count * elem_size, row * elem_size);
+    }
+    size_t body = count * elem_size;
+    if (out.size() > body) memcpy(out.data() + body, planes + body, out.size() - body);
+}
+
+void Preprocessor::predict2DRange(const uint8_t* raw, uint8_t* res, size_t begin, size_t end,
+                                  size_t elem_size, size_t row_bytes, bool planar) {
+    size_t pos = begin;
+    if (pos < end && pos < elem_size) {
+        size_t n = std::min(end, elem_size) - pos;
+        memcpy(res, raw + pos, n);
+        pos += n;
+    }
+    if (pos < end && pos < row_bytes) {
+        size_t n = std::min(end, row_bytes) - pos;
+        shuffle::xorBytes(raw + pos, raw + pos - elem_size, res + (pos - begin), n);
+        pos += n;
+    }
+    if (!planar) {
+        if (pos < end) shuffle::xorBytes(raw + pos, raw + pos - row_bytes, res + (pos - begin), end - pos);
+        return;
+    }
+    // Row by row: the first value of a row has no left neighbour
+    while (pos < end) {
+        size_t row_start = pos - pos % row_bytes;
+        size_t row_end = std::min(end, row_start + row_bytes);
+        uint8_t* dst = res + (pos - begin);
+        shuffle::xorBytes(raw + pos, raw + pos - row_bytes, dst, row_end - pos);
+        size_t left = std::max(pos, row_start + elem_size);
+        if (left < row_end) {
+            uint8_t* d = res + (left - begin);
+            shuffle::xorBytes(d, raw + left - elem_size, d, row_end - left);
+            shuffle::xorBytes(d, raw + left - elem_size - row_bytes, d, row_end - left);
+        }
+        pos = row_end;
+    }
+}
+
+std::vector<uint8_t> Preprocessor::deltaEncode(std::span<const uint8_t> data) {
     // Not used in current implementation - kept for future experimentation
-    if (data.size() < 4) return data;  // Need at least 2 int16 values
+    if (data.size() < 4) return std::vector<uint8_t>(data.begin(), data.end());  // Need at least 2 int16 values
 
     std::vector<uint8_t> encoded;
     encoded.reserve(data.size());
@@ -92,12 +518,13 @@ std::vector<uint8_t> Preprocessor::deltaEncode(const std::vector<uint8_t>& data)
         encoded.push_back(delta_bytes[0]);
         encoded.push_back(delta_bytes[1]);
     }
+    if (data.size() % 2) encoded.push_back(data.back());
     return encoded;
 }
 
-std::vector<uint8_t> Preprocessor::deltaDecode(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Preprocessor::deltaDecode(std::span<const uint8_t> data) {
     // Not used in current implementation - kept for future experimentation
-    if (data.size() < 4) return data;  // Need at least 2 int16 values
+    if (data.size() < 4) return std::vector<uint8_t>(data.begin(), data.end());  // Need at least 2 int16 values
 
     std::vector<uint8_t> decoded;
     decoded.reserve(data.size());
@@ -118,10 +545,11 @@ std::vector<uint8_t> Preprocessor::deltaDecode(const std::vector<uint8_t>& data)
         decoded.push_back(curr_bytes[0]);
         decoded.push_back(curr_bytes[1]);
     }
+    if (data.size() % 2) decoded.push_back(data.back());
     return decoded;
 }
 
-std::vector<uint8_t> Preprocessor::bf16ToFp16(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Preprocessor::bf16ToFp16(std::span<const uint8_t> data) {
     size_t num_values = data.size() / 2;
     std::vector<uint8_t> fp16_data(data.size());
 
@@ -147,10 +575,11 @@ std::vector<uint8_t> Preprocessor::bf16ToFp16(const std::vector<uint8_t>& data)
 
         memcpy(&fp16_data[i * 2], &fp16, 2);
     }
+    if (data.size() % 2) fp16_data.back() = data.back();
     return fp16_data;
 }
 
-std::vector<uint8_t> Preprocessor::fp16ToBf16(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Preprocessor::fp16ToBf16(std::span<const uint8_t> data) {
     size_t num_values = data.size() / 2;
     std::vector<uint8_t> bf16_data(data.size());
 
@@ -175,20 +604,21 @@ std::vector<uint8_t> Preprocessor::fp16ToBf16(const std::vector<uint8_t>& data)
         uint16_t bf16 = fp32 >> 16;
         memcpy(&bf16_data[i * 2], &bf16, 2);
     }
+    if (data.size() % 2) bf16_data.back() = data.back();
     return bf16_data;
 }
 
-std::vector<uint8_t> Preprocessor::combinedPreprocess(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Preprocessor::combinedPreprocess(std::span<const uint8_t> data) {
     auto temp = bf16ToFp16(data);
     return deltaEncode(temp);
 }
 
-std::vector<uint8_t> Preprocessor::combinedDeprocess(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> Preprocessor::combinedDeprocess(std::span<const uint8_t> data) {
     auto temp = deltaDecode(data);
     return fp16ToBf16(temp);
 }
 
-double Preprocessor::calculateEntropy(const std::vector<uint8_t>& data) {
+double Preprocessor::calculateEntropy(std::span<const uint8_t> data) {
     if (data.empty()) return 0.0;
 
     // Sample-based entropy calculation for large datasets
@@ -225,6 +655,16 @@ std::string Preprocessor::getStrategyName(Strategy strategy) {
         case Strategy::COMBINED: return "Combined";
         case Strategy::BYTE_REORDER_DELTA: return "ByteReorderDelta";
         case Strategy::BIT_PLANE_SEPARATION: return "BitPlaneSeparation";
+        case Strategy::BYTE_REORDER_32: return "ByteReorder32";
+        case Strategy::BYTE_REORDER_64: return "ByteReorder64";
+        case Strategy::FIELD_SPLIT_BF16: return "FieldSplitBF16";
+        case Strategy::FIELD_SPLIT_F16: return "FieldSplitF16";
+        case Strategy::FIELD_SPLIT_F32: return "FieldSplitF32";
+        case Strategy::XOR_DELTA_32: return "XorDelta32";
+        case Strategy::XOR_2D_16: return "Xor2D16";
+        case Strategy::XOR_2D_32: return "Xor2D32";
+        case Strategy::XOR_PLANE_16: return "XorPlane16";
+        case Strategy::XOR_PLANE_32: return "XorPlane32";
     }
     return "Unknown";
 }
@@ -244,11 +684,12 @@ std::string Preprocessor::getStrategyName(Strategy strategy) {
  * Rationale: After byte reordering, high bytes are very similar, so deltas
  * will be small (often zero), leading to better compression.
  */
-std::vector<uint8_t> Preprocessor::byteReorderDelta(const std::vector<uint8_t>& data) {
-    if (data.size() < 4) return data;  // Need at least 2 BF16 values
+std::vector<uint8_t> Preprocessor::byteReorderDelta(std::span<const uint8_t> data) {
+    if (data.size() < 4) return std::vector<uint8_t>(data.begin(), data.end());  // Need at least 2 BF16 values
 
     // Step 1: Apply byte reordering first
-    std::vector<uint8_t> reordered = byteReorder(data);
+    std::vector<uint8_t> reordered(data.size());
+    byteReorder(data, reordered);
 
     // Step 2: Apply delta encoding to each half independently
     size_t half_size = reordered.size() / 2;
@@ -275,8 +716,8 @@ std::vector<uint8_t> Preprocessor::byteReorderDelta(const std::vector<uint8_t>&
 /**
  * BYTE_REORDER_DELTA Inverse: Reverses the byte reorder + delta encoding
  */
-std::vector<uint8_t> Preprocessor::byteReorderDeltaInverse(const std::vector<uint8_t>& data) {
-    if (data.size() < 4) return data;
+std::vector<uint8_t> Preprocessor::byteReorderDeltaInverse(std::span<const uint8_t> data) {
+    if (data.size() < 4) return std::vector<uint8_t>(data.begin(), data.end());
 
     size_t half_size = data.size() / 2;
     std::vector<uint8_t> decoded;
@@ -299,7 +740,9 @@ std::vector<uint8_t> Preprocessor::byteReorderDeltaInverse(const std::vector<uin
     }
 
     // Step 2: Reverse byte reordering
-    return byteDeorder(decoded);
+    std::vector<uint8_t> original(decoded.size());
+    byteDeorder(decoded, original);
+    return original;
 }
 
 /**
@@ -316,84 +759,30 @@ std::vector<uint8_t> Preprocessor::byteReorderDeltaInverse(const std::vector<uin
  *
  * Note: Output size may be larger than input due to byte alignment of bit planes
  */
-// Suppress false positive warnings from GCC 13 on small vector copies
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Warray-bounds"
-#pragma GCC diagnostic ignored "-Wstringop-overflow"
-std::vector<uint8_t> Preprocessor::bitPlaneSeparation(const std::vector<uint8_t>& data) {
-    if (data.size() < 2) return data;
-
-    size_t num_values = data.size() / 2;  // Number of BF16 values
-    size_t bytes_per_plane = (num_values + 7) / 8;  // Round up to whole bytes
-    std::vector<uint8_t> separated(16 * bytes_per_plane, 0);  // 16 bit planes
-
-    // For each BF16 value
-    for (size_t val_idx = 0; val_idx < num_values; ++val_idx) {
-        // Read the 16-bit value in little-endian
-        uint16_t value = static_cast<uint16_t>(data[val_idx * 2]) |
-                        (static_cast<uint16_t>(data[val_idx * 2 + 1]) << 8);
-
-        // Extract each of the 16 bits and place into corresponding plane
-        for (int bit_pos = 0; bit_pos < 16; ++bit_pos) {
-            uint8_t bit = (value >> bit_pos) & 1;
-
-            if (bit) {
-                size_t plane_offset = bit_pos * bytes_per_plane;
-                size_t byte_in_plane = val_idx / 8;
-                size_t bit_in_byte = val_idx % 8;
-
-                separated[plane_offset + byte_in_plane] |= (1 << bit_in_byte);
-            }
-        }
+void Preprocessor::bitPlaneSeparation(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    if (data.size() < 2) {
+        if (!data.empty()) out[0] = data[0];
+        return;
     }
 
-    return separated;  // Keep full size, don't trim
+    // 16 planes of ceil(values / 8) bytes, built from 8x8 bit-matrix
+    // transposes, vectorised and split across threads
+    size_t num_values = data.size() / 2;  // Number of BF16 values
+    shuffle::bitShuffle16(data.data(), out.data(), num_values, threads);
+    if (data.size() % 2) out[out.size() - 1] = data[data.size() - 1];
 }
-#pragma GCC diagnostic pop
 
 /**
- * BIT_PLANE_SEPARATION Inverse: Reconstructs data from bit planes
+ * BIT_PLANE_SEPARATION Inverse: Reconstructs out.size() / 2 values from the
+ * bit planes, then the trailing odd byte stored after them
  */
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Warray-bounds"
-#pragma GCC diagnostic ignored "-Wstringop-overflow"
-std::vector<uint8_t> Preprocessor::bitPlaneReconstruction(const std::vector<uint8_t>& data) {
-    if (data.size() < 2) return data;
-
-    // Calculate number of values from bit plane size
-    size_t bytes_per_plane = data.size() / 16;
-    size_t num_values = bytes_per_plane * 8;  // Maximum possible values
-
-    // Actual output size
-    size_t output_size = num_values * 2;
-    std::vector<uint8_t> reconstructed(output_size, 0);
-
-    // For each BF16 value
-    for (size_t val_idx = 0; val_idx < num_values; ++val_idx) {
-        uint16_t value = 0;
-
-        // Extract each bit from its plane
-        for (int bit_pos = 0; bit_pos < 16; ++bit_pos) {
-            size_t plane_offset = bit_pos * bytes_per_plane;
-            size_t byte_in_plane = val_idx / 8;
-            size_t bit_in_byte = val_idx % 8;
-
-            if (plane_offset + byte_in_plane < data.size()) {
-                uint8_t bit = (data[plane_offset + byte_in_plane] >> bit_in_byte) & 1;
-
-                if (bit) {
-                    value |= (1 << bit_pos);
-                }
-            }
-        }
-
-        // Write the 16-bit value in little-endian
-        if (val_idx * 2 + 1 < reconstructed.size()) {
-            reconstructed[val_idx * 2] = value & 0xFF;
-            reconstructed[val_idx * 2 + 1] = (value >> 8) & 0xFF;
-        }
+void Preprocessor::bitPlaneReconstruction(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    if (data.size() < 2) {
+        if (!data.empty()) out[0] = data[0];
+        return;
     }
 
-    return reconstructed;
+    size_t num_values = out.size() / 2;
+    shuffle::bitUnshuffle16(data.data(), out.data(), num_values, threads);
+    if (out.size() % 2) out[2 * num_values] = data[data.size() - 1];
 }
-#pragma GCC diagnostic pop
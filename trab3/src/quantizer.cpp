@@ -0,0 +1,475 @@
+#include "../includes/quantizer.hpp"
+#include "../includes/thread_pool.hpp"
+#include "../includes/byte_buffer.hpp"
+#include "../includes/io_util.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QUANTIZER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Values per parallel task, enough to amortise a pool dispatch
+const size_t TASK_VALUES = 1 << 16;
+
+// Values converted to float and quantized at a time, sized to stay in L2
+const size_t TILE_VALUES = 1 << 14;
+
+// Whole, even block counts: an even count of blocks always starts on a
+// whole byte of INT4 codes, whatever the block size
+size_t evenBlocks(size_t values, size_t block_size) {
+    size_t blocks = std::max<size_t>(1, values / block_size);
+    return blocks + (blocks & 1);
+}
+
+// ----------------------------------------------------------------------------
+// Scalar kernels. Clamping is written as maxps/minps behave (a NaN level
+// becomes the lower bound) so every path produces the same codes.
+// ----------------------------------------------------------------------------
+
+float halfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h >> 15) << 31;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0x1F) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // Subnormal: normalise the mantissa
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            --exp;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void bf16ToFloatScalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t v;
+        memcpy(&v, src + 2 * i, 2);
+        uint32_t bits = static_cast<uint32_t>(v) << 16;
+        memcpy(dst + i, &bits, 4);
+    }
+}
+
+void f16ToFloatScalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t v;
+        memcpy(&v, src + 2 * i, 2);
+        dst[i] = halfToFloat(v);
+    }
+}
+
+float absMaxScalar(const float* x, size_t count) {
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float a = std::fabs(x[i]);
+        max_abs = a > max_abs ? a : max_abs;
+    }
+    return max_abs;
+}
+
+void quantizeScalar(const float* x, size_t count, float scale, float lo, float hi, int8_t* q) {
+    for (size_t i = 0; i < count; ++i) {
+        float r = std::nearbyint(x[i] / scale);
+        r = r > lo ? r : lo;
+        r = r < hi ? r : hi;
+        q[i] = static_cast<int8_t>(static_cast<int>(r));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// AVX2 (+ F16C): the division is a real divps, not a reciprocal, so results
+// match the scalar loop and NumPy exactly
+// ----------------------------------------------------------------------------
+
+#ifdef QUANTIZER_X86
+
+__attribute__((target("avx2")))
+void bf16ToFloatAVX2(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        __m256i w = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(w));
+    }
+    bf16ToFloatScalar(src + 2 * i, dst + i, count - i);
+}
+
+__attribute__((target("avx2,f16c")))
+void f16ToFloatF16C(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    f16ToFloatScalar(src + 2 * i, dst + i, count - i);
+}
+
+__attribute__((target("avx2")))
+float absMaxAVX2(const float* x, size_t count) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 m0 = _mm256_setzero_ps(), m1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        m0 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(x + i), abs_mask), m0);
+        m1 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(x + i + 8), abs_mask), m1);
+    }
+    m0 = _mm256_max_ps(m0, m1);
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(m0), _mm256_extractf128_ps(m0, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    float max_abs = _mm_cvtss_f32(m);
+    float tail = absMaxScalar(x + i, count - i);
+    return tail > max_abs ? tail : max_abs;
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i levelsAVX2(const float* x, __m256 scale, __m256 lo, __m256 hi) {
+    __m256 r = _mm256_round_ps(_mm256_div_ps(_mm256_loadu_ps(x), scale),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_min_ps(_mm256_max_ps(r, lo), hi);
+    return _mm256_cvttps_epi32(r);
+}
+
+__attribute__((target("avx2")))
+void quantizeAVX2(const float* x, size_t count, float scale, float lo, float hi, int8_t* q) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vlo = _mm256_set1_ps(lo);
+    const __m256 vhi = _mm256_set1_ps(hi);
+    // packs works per 128-bit lane; the permute restores element order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = levelsAVX2(x + i, vscale, vlo, vhi);
+        __m256i b = levelsAVX2(x + i + 8, vscale, vlo, vhi);
+        __m256i c = levelsAVX2(x + i + 16, vscale, vlo, vhi);
+        __m256i d = levelsAVX2(x + i + 24, vscale, vlo, vhi);
+        __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(q + i), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    quantizeScalar(x + i, count - i, scale, lo, hi, q + i);
+}
+
+#endif
+
+struct Kernels {
+    void (*bf16ToFloat)(const uint8_t*, float*, size_t);
+    void (*f16ToFloat)(const uint8_t*, float*, size_t);
+    float (*absMax)(const float*, size_t);
+    void (*quantize)(const float*, size_t, float, float, float, int8_t*);
+    const char* name;
+};
+
+Kernels detectKernels() {
+    Kernels k{bf16ToFloatScalar, f16ToFloatScalar, absMaxScalar, quantizeScalar, "Scalar"};
+#ifdef QUANTIZER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        k = {bf16ToFloatAVX2, f16ToFloatScalar, absMaxAVX2, quantizeAVX2, "AVX2"};
+        if (__builtin_cpu_supports("f16c")) k.f16ToFloat = f16ToFloatF16C;
+    }
+#endif
+    return k;
+}
+
+const Kernels& activeKernels() {
+    static const Kernels kernels = detectKernels();
+    return kernels;
+}
+
+void toFloat(const Kernels& k, const uint8_t* src, DType dtype, float* dst, size_t count) {
+    switch (dtype) {
+        case DType::BF16: k.bf16ToFloat(src, dst, count); break;
+        case DType::F16: k.f16ToFloat(src, dst, count); break;
+        case DType::F32: memcpy(dst, src, count * 4); break;
+        case DType::F64:
+            for (size_t i = 0; i < count; ++i) {
+                double v;
+                memcpy(&v, src + 8 * i, 8);
+                dst[i] = static_cast<float>(v);
+            }
+            break;
+        default:
+            throw std::runtime_error("Cannot quantize " + SafetensorsParser::getDTypeName(dtype) + " values");
+    }
+}
+
+std::string jsonEntry(const std::string& name, DType dtype, const std::vector<int64_t>& shape,
+                      uint64_t begin, uint64_t end) {
+    std::ostringstream entry;
+    entry << io_util::jsonString(name) << ":{\"dtype\":\"" << SafetensorsParser::getDTypeName(dtype) << "\",\"shape\":[";
+    for (size_t i = 0; i < shape.size(); ++i) entry << (i ? "," : "") << shape[i];
+    entry << "],\"data_offsets\":[" << begin << "," << end << "]}";
+    return entry.str();
+}
+
+} // namespace
+
+Quantizer::Quantizer(unsigned bits, size_t block_size) : bits_(bits), block_size_(block_size) {
+    if (bits != 4 && bits != 8) throw std::invalid_argument("Quantization supports 4 or 8 bits");
+    if (block_size == 0) throw std::invalid_argument("Quantization block size must be at least 1");
+}
+
+bool Quantizer::shouldQuantize(const TensorInfo& tensor) {
+    switch (tensor.dtype) {
+        case DType::BF16:
+        case DType::F16:
+        case DType::F32:
+        case DType::F64:
+            break;
+        default:
+            return false;
+    }
+    size_t count = tensor.size() / SafetensorsParser::getDTypeSize(tensor.dtype);
+    std::string name = tensor.name;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    if (count < 512) return false;
+    if (name.find("embed") != std::string::npos) return false;
+    if (name.find("norm") != std::string::npos || name.find("ln") != std::string::npos) return false;
+    if (name.find("bias") != std::string::npos) return false;
+    if (name.find("weight") != std::string::npos) return true;
+    return count > 10000;
+}
+
+size_t Quantizer::codesSize(size_t count) const {
+    return bits_ == 4 ? (count + 1) / 2 : count;
+}
+
+size_t Quantizer::scalesCount(size_t count) const {
+    return (count + block_size_ - 1) / block_size_;
+}
+
+// Blocks [first_block, last_block), first_block even, converted and
+// quantized one tile of whole blocks at a time
+void Quantizer::quantizeRange(std::span<const uint8_t> src, DType dtype, size_t first_block, size_t last_block,
+                              std::span<uint8_t> codes, std::span<float> scales,
+                              std::vector<float>& values, std::vector<int8_t>& levels) const {
+    const Kernels& k = activeKernels();
+    const size_t elem_size = SafetensorsParser::getDTypeSize(dtype);
+    const size_t count = src.size() / elem_size;
+    const float qmax = bits_ == 4 ? 7.0f : 127.0f;
+    const size_t tile_blocks = evenBlocks(TILE_VALUES, block_size_);
+
+    for (size_t tile = first_block; tile < last_block; tile += tile_blocks) {
+        size_t tile_end = std::min(last_block, tile + tile_blocks);
+        size_t begin = tile * block_size_;
+        size_t n = std::min(count, tile_end * block_size_) - begin;
+        values.resize(n);
+        toFloat(k, src.data() + begin * elem_size, dtype, values.data(), n);
+
+        int8_t* q = reinterpret_cast<int8_t*>(codes.data()) + begin;
+        if (bits_ == 4) {
+            levels.resize(n);
+            q = levels.data();
+        }
+        for (size_t block = tile; block < tile_end; ++block) {
+            size_t offset = (block - tile) * block_size_;
+            size_t len = std::min(block_size_, n - offset);
+            float max_abs = k.absMax(values.data() + offset, len);
+            float scale = max_abs > 0.0f ? max_abs / qmax : 1.0f;
+            scales[block] = scale;
+            k.quantize(values.data() + offset, len, scale, -qmax - 1.0f, qmax, q + offset);
+        }
+
+        if (bits_ == 4) {
+            uint8_t* packed = codes.data() + begin / 2;
+            for (size_t i = 0; i + 1 < n; i += 2) {
+                packed[i / 2] = static_cast<uint8_t>(((levels[i] & 0x0F) << 4) | (levels[i + 1] & 0x0F));
+            }
+            if (n % 2) packed[n / 2] = static_cast<uint8_t>((levels[n - 1] & 0x0F) << 4);
+        }
+    }
+}
+
+void Quantizer::quantize(std::span<const uint8_t> src, DType dtype, std::span<uint8_t> codes,
+                         std::span<float> scales) const {
+    size_t elem_size = SafetensorsParser::getDTypeSize(dtype);
+    if (elem_size == 0 || src.size() % elem_size != 0) {
+        throw std::runtime_error("Tensor size is not a whole number of values");
+    }
+    size_t count = src.size() / elem_size;
+    size_t blocks = scalesCount(count);
+    if (codes.size() != codesSize(count) || scales.size() != blocks) {
+        throw std::runtime_error("Quantization buffers do not match the tensor size");
+    }
+
+    // Per-worker buffers, tasks of an even number of blocks handed out in order
+    const size_t task_blocks = evenBlocks(TASK_VALUES, block_size_);
+    const size_t tasks = (blocks + task_blocks - 1) / task_blocks;
+    unsigned threads = threads_ ? threads_ : ThreadPool::defaultThreadCount();
+    size_t workers = std::max<size_t>(1, std::min<size_t>(threads, tasks));
+    std::atomic<size_t> next{0};
+    auto work = [&](size_t) {
+        std::vector<float> values;
+        std::vector<int8_t> levels;
+        size_t task;
+        while ((task = next.fetch_add(1)) < tasks) {
+            size_t first = task * task_blocks;
+            quantizeRange(src, dtype, first, std::min(blocks, first + task_blocks), codes, scales, values, levels);
+        }
+    };
+    if (workers == 1) {
+        work(0);
+    } else {
+        ThreadPool::shared().parallelFor(workers, workers, work);
+    }
+}
+
+bool Quantizer::quantizeFile(const std::string& input, const std::string& output) {
+    auto start = std::chrono::high_resolution_clock::now();
+    stats_ = Stats();
+
+    SafetensorsParser parser;
+    parser.setVerbose(verbose_);
+    if (!parser.parse(input)) return false;
+    const std::vector<TensorInfo>& tensors = parser.getTensors();
+    if (tensors.empty()) {
+        std::cerr << "Error: " << input << " has no tensor table to quantize" << std::endl;
+        return false;
+    }
+
+    // Payload layout: every scales tensor, then the kept tensors (8-byte
+    // aligned), then the codes
+    struct Placement {
+        bool quantized = false;
+        uint64_t offset = 0;         // Codes or the kept copy
+        uint64_t size = 0;
+        uint64_t scales_offset = 0;
+        uint64_t scales_count = 0;
+    };
+    std::vector<Placement> placements(tensors.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const TensorInfo& t = tensors[i];
+        Placement& p = placements[i];
+        p.quantized = shouldQuantize(t);
+        if (!p.quantized) continue;
+        size_t count = t.size() / SafetensorsParser::getDTypeSize(t.dtype);
+        p.size = codesSize(count);
+        p.scales_count = scalesCount(count);
+        p.scales_offset = offset;
+        offset += 4 * p.scales_count;
+    }
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        if (placements[i].quantized) continue;
+        offset = (offset + 7) / 8 * 8;
+        placements[i].offset = offset;
+        placements[i].size = tensors[i].size();
+        offset += tensors[i].size();
+    }
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        if (!placements[i].quantized) continue;
+        placements[i].offset = offset;
+        offset += placements[i].size;
+    }
+    const uint64_t payload_size = offset;
+
+    std::ostringstream json;
+    json << "{\"__metadata__\":{\"quantization\":\"blockwise_absmax\",\"bits\":\"" << bits_
+         << "\",\"block_size\":\"" << block_size_ << "\"}";
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const TensorInfo& t = tensors[i];
+        const Placement& p = placements[i];
+        if (!p.quantized) {
+            json << "," << jsonEntry(t.name, t.dtype, t.shape, p.offset, p.offset + p.size);
+            continue;
+        }
+        if (bits_ == 4) {
+            json << "," << jsonEntry(t.name, DType::U8, {static_cast<int64_t>(p.size)}, p.offset, p.offset + p.size);
+        } else {
+            json << "," << jsonEntry(t.name, DType::I8, t.shape, p.offset, p.offset + p.size);
+        }
+        json << "," << jsonEntry(t.name + ".__scales__", DType::F32, {static_cast<int64_t>(p.scales_count)},
+                                 p.scales_offset, p.scales_offset + 4 * p.scales_count);
+    }
+    json << "}";
+    std::string header = json.str();
+    header.append((8 - header.size() % 8) % 8, ' ');  // Keeps the payload 8-byte aligned
+    const uint64_t data_offset = 8 + header.size();
+
+    int fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create " << output << std::endl;
+        return false;
+    }
+
+    // One tensor at a time, each written at its final offset; gaps left by
+    // the alignment stay zero from the truncate
+    bool ok = true;
+    try {
+        uint64_t header_size = header.size();
+        std::span<const uint8_t> size_bytes(reinterpret_cast<const uint8_t*>(&header_size), 8);
+        std::span<const uint8_t> header_bytes(reinterpret_cast<const uint8_t*>(header.data()), header.size());
+        if (ftruncate(fd, data_offset + payload_size) != 0 ||
+            !io_util::pwriteFully(fd, size_bytes, 0) || !io_util::pwriteFully(fd, header_bytes, 8)) {
+            throw std::runtime_error("Cannot write " + output);
+        }
+        std::span<const uint8_t> data = parser.getTensorData();
+        ByteBuffer codes;
+        std::vector<float> scales;
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            const TensorInfo& t = tensors[i];
+            const Placement& p = placements[i];
+            std::span<const uint8_t> src = data.subspan(t.data_begin, t.size());
+            stats_.original_bytes += t.size();
+            if (!p.quantized) {
+                if (!io_util::pwriteFully(fd, src, data_offset + p.offset)) {
+                    throw std::runtime_error("Cannot write " + output);
+                }
+                stats_.kept_bytes += src.size();
+                continue;
+            }
+            codes.resize(p.size);
+            scales.resize(p.scales_count);
+            quantize(src, t.dtype, codes, scales);
+            std::span<const uint8_t> scale_bytes(reinterpret_cast<const uint8_t*>(scales.data()), 4 * scales.size());
+            if (!io_util::pwriteFully(fd, codes, data_offset + p.offset) ||
+                !io_util::pwriteFully(fd, scale_bytes, data_offset + p.scales_offset)) {
+                throw std::runtime_error("Cannot write " + output);
+            }
+            stats_.quantized_tensors++;
+            stats_.code_bytes += codes.size();
+            stats_.scale_bytes += 4 * scales.size();
+        }
+        stats_.tensors = tensors.size();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        ok = false;
+    }
+    if (::close(fd) != 0) ok = false;
+    if (!ok) {
+        ::unlink(output.c_str());
+        return false;
+    }
+
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+    stats_.seconds = duration.count();
+    return true;
+}
+
+std::string Quantizer::getKernelName() {
+    return activeKernels().name;
+}
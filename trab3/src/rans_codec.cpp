@@ -0,0 +1,350 @@
+#include "../includes/rans_codec.hpp"
+#include "../includes/thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace rans {
+namespace {
+
+const size_t BLOCK_SIZE = 1 << 20;
+const size_t STREAM_HEADER = 16;
+const uint32_t SCALE_BITS = 12;
+const uint32_t SCALE = 1u << SCALE_BITS;
+const uint32_t STATE_LOW = 1u << 16;  // Lower bound of a normalised state
+const size_t STATES = 4;
+
+enum BlockMode : uint8_t { RAW = 0, CODED = 1 };
+
+using Frequencies = std::array<uint32_t, 256>;
+
+// Scales the symbol counts to sum to SCALE, keeping every present symbol at
+// least 1. Rounding drift is settled on the most frequent symbols, where it
+// costs the least.
+Frequencies normalise(const Frequencies& counts, size_t total) {
+    Frequencies freq{};
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; ++s) {
+        if (counts[s] == 0) continue;
+        freq[s] = std::max<uint32_t>(1, static_cast<uint32_t>(static_cast<uint64_t>(counts[s]) * SCALE / total));
+        sum += freq[s];
+    }
+
+    std::array<uint8_t, 256> order;
+    for (int s = 0; s < 256; ++s) order[s] = static_cast<uint8_t>(s);
+    std::sort(order.begin(), order.end(), [&](uint8_t a, uint8_t b) { return freq[a] > freq[b]; });
+
+    if (sum < SCALE) {
+        freq[order[0]] += SCALE - sum;
+    }
+    for (size_t k = 0; sum > SCALE && k < order.size(); ++k) {
+        uint32_t& f = freq[order[k]];
+        uint32_t take = std::min(sum - SCALE, f - 1);
+        f -= take;
+        sum -= take;
+    }
+    return freq;
+}
+
+// Encoder-side symbol with the division replaced by a multiply and shift
+// (F. Giesen, "rANS with static probability distributions")
+struct EncSymbol {
+    uint64_t x_max;  // 2^32 for a symbol with freq == SCALE, which never renormalises
+    uint32_t rcp_freq;
+    uint32_t bias;
+    uint32_t cmpl_freq;
+    uint32_t rcp_shift;
+};
+
+EncSymbol makeEncSymbol(uint32_t start, uint32_t freq) {
+    EncSymbol sym;
+    sym.x_max = static_cast<uint64_t>((STATE_LOW >> SCALE_BITS) << 16) * freq;
+    sym.cmpl_freq = SCALE - freq;
+    if (freq < 2) {
+        sym.rcp_freq = ~0u;
+        sym.rcp_shift = 0;
+        sym.bias = start + SCALE - 1;
+    } else {
+        uint32_t shift = 0;
+        while (freq > (1u << shift)) ++shift;
+        sym.rcp_freq = static_cast<uint32_t>(((1ULL << (shift + 31)) + freq - 1) / freq);
+        sym.rcp_shift = shift - 1;
+        sym.bias = start;
+    }
+    sym.rcp_shift += 32;
+    return sym;
+}
+
+// Table header: bitmap of present symbols, then freq - 1 of each as one
+// byte (< 128) or two (7 low bits with the top bit set, then the rest)
+size_t writeTable(const Frequencies& freq, uint8_t* dst) {
+    uint8_t* p = dst + 32;
+    memset(dst, 0, 32);
+    for (int s = 0; s < 256; ++s) {
+        if (freq[s] == 0) continue;
+        dst[s >> 3] |= static_cast<uint8_t>(1 << (s & 7));
+        uint32_t v = freq[s] - 1;
+        if (v < 128) {
+            *p++ = static_cast<uint8_t>(v);
+        } else {
+            *p++ = static_cast<uint8_t>(0x80 | (v & 0x7f));
+            *p++ = static_cast<uint8_t>(v >> 7);
+        }
+    }
+    return p - dst;
+}
+
+size_t readTable(const uint8_t* src, size_t size, Frequencies& freq) {
+    if (size < 32) throw std::runtime_error("RANS: truncated frequency table");
+    const uint8_t* p = src + 32;
+    const uint8_t* end = src + size;
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; ++s) {
+        freq[s] = 0;
+        if ((src[s >> 3] & (1 << (s & 7))) == 0) continue;
+        if (p == end) throw std::runtime_error("RANS: truncated frequency table");
+        uint32_t v = *p++;
+        if (v & 0x80) {
+            if (p == end) throw std::runtime_error("RANS: truncated frequency table");
+            v = (v & 0x7f) | (static_cast<uint32_t>(*p++) << 7);
+        }
+        freq[s] = v + 1;
+        sum += freq[s];
+    }
+    if (sum != SCALE) throw std::runtime_error("RANS: invalid frequency table");
+    return p - src;
+}
+
+// Codes one block into dst as mode, table, states and renormalisation
+// words. States renormalise 16 bits at a time, so a symbol moves at most one
+// word and the decoder can do it without a branch. Returns 0 when the block
+// would not fit in capacity.
+size_t encodeCoded(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    Frequencies counts{};
+    for (size_t i = 0; i < size; ++i) ++counts[src[i]];
+    Frequencies freq = normalise(counts, size);
+
+    std::array<EncSymbol, 256> syms;
+    uint32_t start = 0;
+    for (int s = 0; s < 256; ++s) {
+        syms[s] = makeEncSymbol(start, std::max<uint32_t>(freq[s], 1));
+        start += freq[s];
+    }
+
+    if (capacity < 1 + 32 + 2 * 256 + 4 * STATES) return 0;
+    dst[0] = CODED;
+    size_t header = 1 + writeTable(freq, dst + 1);
+
+    // Symbols go in last to first so the decoder reads forwards; symbol i
+    // belongs to state i % STATES, and the output grows down from the end
+    uint8_t* const limit = dst + header + 4 * STATES;
+    uint8_t* ptr = dst + capacity;
+    uint32_t state[STATES];
+    std::fill(state, state + STATES, STATE_LOW);
+
+    for (size_t i = size; i-- > 0;) {
+        const EncSymbol& sym = syms[src[i]];
+        uint32_t& x = state[i % STATES];
+        if (x >= sym.x_max) {
+            if (ptr - limit < 2) return 0;
+            ptr -= 2;
+            uint16_t word = static_cast<uint16_t>(x);
+            memcpy(ptr, &word, 2);
+            x >>= 16;
+        }
+        uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(x) * sym.rcp_freq) >> sym.rcp_shift);
+        x += sym.bias + q * sym.cmpl_freq;
+    }
+    for (size_t k = STATES; k-- > 0;) {
+        ptr -= 4;
+        memcpy(ptr, &state[k], 4);
+    }
+
+    size_t payload = dst + capacity - ptr;
+    memmove(dst + header, ptr, payload);
+    return header + payload;
+}
+
+// Slot entry: symbol in bits 0-7, freq - 1 in bits 8-19, slot - start in
+// bits 20-31, so one load per decoded symbol
+using DecodeTable = std::array<uint32_t, SCALE>;
+
+void buildDecodeTable(const Frequencies& freq, DecodeTable& table) {
+    uint32_t start = 0;
+    for (uint32_t s = 0; s < 256; ++s) {
+        for (uint32_t k = 0; k < freq[s]; ++k) {
+            table[start + k] = s | ((freq[s] - 1) << 8) | (k << 20);
+        }
+        start += freq[s];
+    }
+}
+
+inline uint8_t decodeStep(const DecodeTable& table, uint32_t& x) {
+    uint32_t e = table[x & (SCALE - 1)];
+    x = (((e >> 8) & 0xfff) + 1) * (x >> SCALE_BITS) + (e >> 20);
+    return static_cast<uint8_t>(e);
+}
+
+// Branch-free: the word is always loaded, and only used and consumed when
+// the state dropped below STATE_LOW
+inline void renormalise(uint32_t& x, const uint8_t*& ptr) {
+    uint16_t word;
+    memcpy(&word, ptr, 2);
+    bool refill = x < STATE_LOW;
+    x = refill ? (x << 16) | word : x;
+    ptr += refill ? 2 : 0;
+}
+
+void decodeCoded(const uint8_t* src, size_t size, uint8_t* dst, size_t count) {
+    Frequencies freq;
+    size_t pos = readTable(src, size, freq);
+    if (size - pos < 4 * STATES) throw std::runtime_error("RANS: truncated block");
+
+    DecodeTable table;
+    buildDecodeTable(freq, table);
+
+    uint32_t state[STATES];
+    for (size_t k = 0; k < STATES; ++k) {
+        memcpy(&state[k], src + pos, 4);
+        pos += 4;
+    }
+    const uint8_t* ptr = src + pos;
+    const uint8_t* const end = src + size;
+
+    // A symbol consumes at most one word, so while STATES words remain a
+    // group of STATES symbols can renormalise without bounds checks
+    size_t i = 0;
+    for (; i + STATES <= count && end - ptr >= static_cast<ptrdiff_t>(2 * STATES); i += STATES) {
+        for (size_t k = 0; k < STATES; ++k) {
+            dst[i + k] = decodeStep(table, state[k]);
+        }
+        for (size_t k = 0; k < STATES; ++k) {
+            renormalise(state[k], ptr);
+        }
+    }
+    for (; i < count; ++i) {
+        uint32_t& x = state[i % STATES];
+        dst[i] = decodeStep(table, x);
+        if (x < STATE_LOW) {
+            if (end - ptr < 2) throw std::runtime_error("RANS: truncated block");
+            renormalise(x, ptr);
+        }
+    }
+
+    // The encoder started every state at STATE_LOW and consumed all bytes
+    if (ptr != end || std::any_of(state, state + STATES, [](uint32_t x) { return x != STATE_LOW; })) {
+        throw std::runtime_error("RANS: corrupt block");
+    }
+}
+
+size_t blockCount(uint64_t size) {
+    return static_cast<size_t>((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+} // namespace
+
+size_t encodeBound(size_t size) {
+    size_t count = blockCount(size);
+    return STREAM_HEADER + 5 * count + size;
+}
+
+size_t encode(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    const size_t block_count = blockCount(data.size());
+    const size_t table_end = STREAM_HEADER + 4 * block_count;
+
+    // Each block is written at its worst-case offset (mode byte plus raw
+    // bytes), then moved down into place
+    std::vector<size_t> slots(block_count), sizes(block_count);
+    for (size_t i = 0; i < block_count; ++i) {
+        slots[i] = table_end + i * (1 + BLOCK_SIZE);
+    }
+    ThreadPool::shared().parallelFor(block_count, threads, [&](size_t i) {
+        size_t begin = i * BLOCK_SIZE;
+        size_t size = std::min(BLOCK_SIZE, data.size() - begin);
+        uint8_t* dst = out.data() + slots[i];
+        // Only keep the coded form when it beats storing the block
+        size_t coded = encodeCoded(data.data() + begin, size, dst, size);
+        if (coded == 0) {
+            dst[0] = RAW;
+            memcpy(dst + 1, data.data() + begin, size);
+            coded = 1 + size;
+        }
+        sizes[i] = coded;
+    });
+
+    uint64_t raw_size = data.size();
+    uint32_t block_size = BLOCK_SIZE;
+    uint32_t count = block_count;
+    memcpy(out.data(), &raw_size, 8);
+    memcpy(out.data() + 8, &block_size, 4);
+    memcpy(out.data() + 12, &count, 4);
+
+    size_t pos = table_end;
+    for (size_t i = 0; i < block_count; ++i) {
+        uint32_t size = sizes[i];
+        memcpy(out.data() + STREAM_HEADER + 4 * i, &size, 4);
+        memmove(out.data() + pos, out.data() + slots[i], sizes[i]);
+        pos += sizes[i];
+    }
+    return pos;
+}
+
+uint64_t decodedSize(std::span<const uint8_t> data) {
+    if (data.size() < STREAM_HEADER) {
+        throw std::runtime_error("RANS: invalid compressed data");
+    }
+    uint64_t raw_size;
+    memcpy(&raw_size, data.data(), 8);
+    return raw_size;
+}
+
+void decode(std::span<const uint8_t> data, std::span<uint8_t> out, unsigned threads) {
+    uint64_t raw_size = decodedSize(data);
+    if (raw_size != out.size()) {
+        throw std::runtime_error("RANS: decompressed size mismatch");
+    }
+
+    uint32_t block_size, block_count;
+    memcpy(&block_size, data.data() + 8, 4);
+    memcpy(&block_count, data.data() + 12, 4);
+    if (block_size == 0 || (raw_size + block_size - 1) / block_size != block_count ||
+        data.size() < STREAM_HEADER + 4 * static_cast<uint64_t>(block_count)) {
+        throw std::runtime_error("RANS: invalid block table");
+    }
+
+    std::vector<uint64_t> offsets(block_count + 1);
+    offsets[0] = STREAM_HEADER + 4 * static_cast<uint64_t>(block_count);
+    for (uint32_t i = 0; i < block_count; ++i) {
+        uint32_t size;
+        memcpy(&size, data.data() + STREAM_HEADER + 4 * i, 4);
+        if (size == 0) throw std::runtime_error("RANS: invalid block table");
+        offsets[i + 1] = offsets[i] + size;
+    }
+    if (offsets[block_count] > data.size()) {
+        throw std::runtime_error("RANS: invalid block table");
+    }
+
+    ThreadPool::shared().parallelFor(block_count, threads, [&](size_t i) {
+        uint64_t begin = i * static_cast<uint64_t>(block_size);
+        size_t expected = static_cast<size_t>(std::min<uint64_t>(block_size, raw_size - begin));
+        const uint8_t* src = data.data() + offsets[i];
+        size_t size = offsets[i + 1] - offsets[i];
+        uint8_t* dst = out.data() + begin;
+
+        switch (src[0]) {
+            case RAW:
+                if (size - 1 != expected) throw std::runtime_error("RANS: invalid raw block");
+                memcpy(dst, src + 1, expected);
+                return;
+            case CODED:
+                decodeCoded(src + 1, size - 1, dst, expected);
+                return;
+        }
+        throw std::runtime_error("RANS: unknown block mode");
+    });
+}
+
+} // namespace rans
@@ -1,40 +1,571 @@
 #include "../includes/safetensors_parser.hpp"
-#include <fstream>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-SafetensorsParser::SafetensorsParser() : file_size_(0), header_size_(0) {}
+SafetensorsParser::SafetensorsParser()
+    : mapping_(nullptr), fd_(-1), file_size_(0), header_size_(0), data_size_(0), verbose_(true) {}
 
-SafetensorsParser::~SafetensorsParser() {}
+SafetensorsParser::~SafetensorsParser() {
+    release();
+}
 
-bool SafetensorsParser::parse(const std::string& filepath) {
+void SafetensorsParser::release() {
+    if (mapping_) {
+        munmap(mapping_, file_size_);
+        mapping_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    tensor_data_.clear();
+    tensor_data_.shrink_to_fit();
+    tensor_span_ = {};
+    tensors_.clear();
+}
+
+bool SafetensorsParser::parse(const std::string& filepath, LoadMode mode) {
+    release();
     filepath_ = filepath;
+    file_size_ = 0;
+    header_size_ = 0;
+    data_size_ = 0;
 
-    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filepath << std::endl;
-        return false;
+    if (mode == LoadMode::STREAM) {
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: Cannot open file " << filepath << std::endl;
+            return false;
+        }
+        if (!parseStream(fd)) {
+            close(fd);
+            return false;
+        }
+        return true;
+    }
+
+    if (mode == LoadMode::MMAP) {
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: Cannot open file " << filepath << std::endl;
+            return false;
+        }
+        bool ok = parseMapped(fd);
+        close(fd);  // The mapping stays valid after the descriptor is closed
+        if (ok) return true;
+        if (header_size_ != 0) return false;  // Mapped fine but the file itself is malformed
+        std::cerr << "Warning: mmap failed, falling back to buffered read" << std::endl;
     }
+    return parseRead();
+}
+
+// Maps the whole file and points tensor_span_ into the mapping, so the payload
+// is paged in lazily by the compressor instead of being copied up front.
+bool SafetensorsParser::parseMapped(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8) return false;
+    file_size_ = static_cast<size_t>(st.st_size);
+
+    void* addr = mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) return false;
+    mapping_ = addr;
 
-    file_size_ = file.tellg();
-    file.seekg(0, std::ios::beg);
+    // Hints only: the compressor walks the payload front to back once
+    madvise(mapping_, file_size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(mapping_, file_size_, MADV_HUGEPAGE);
+#endif
 
-    std::cout << "Parsing: " << filepath << " (" << (file_size_ / 1024.0 / 1024.0) << " MB)" << std::endl;
+    if (verbose_) std::cout << "Parsing: " << filepath_ << " (" << (file_size_ / 1024.0 / 1024.0) << " MB, mmap)" << std::endl;
 
+    const uint8_t* base = static_cast<const uint8_t*>(mapping_);
     uint64_t header_size_le;
-    file.read(reinterpret_cast<char*>(&header_size_le), 8);
+    memcpy(&header_size_le, base, 8);
     header_size_ = header_size_le;
+    if (header_size_ == 0 || header_size_ > file_size_ - 8) {
+        std::cerr << "Error: Invalid header size in " << filepath_ << std::endl;
+        release();
+        return false;
+    }
 
-    std::vector<uint8_t> header_bytes(header_size_);
-    file.read(reinterpret_cast<char*>(header_bytes.data()), header_size_);
-    header_ = std::string(header_bytes.begin(), header_bytes.end());
+    header_.assign(reinterpret_cast<const char*>(base + 8), header_size_);
+    tensor_span_ = std::span<const uint8_t>(base + 8 + header_size_, file_size_ - 8 - header_size_);
+    data_size_ = tensor_span_.size();
 
+    parseTensorTable();
+    if (verbose_) std::cout << "Header: " << header_size_ << " bytes, Tensors: "
+              << (data_size_ / 1024.0 / 1024.0) << " MB (" << tensors_.size() << " tensors)" << std::endl;
+    return true;
+}
+
+// Copies the payload into memory with several large reads in flight, so a
+// fast disk is not held to one request at a time
+bool SafetensorsParser::parseRead() {
+    int fd = open(filepath_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open file " << filepath_ << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    uint64_t header_size_le = 0;
+    bool ok = fstat(fd, &st) == 0 && st.st_size >= 8 && pread(fd, &header_size_le, 8, 0) == 8;
+    file_size_ = ok ? static_cast<size_t>(st.st_size) : 0;
+    header_size_ = header_size_le;
+    if (!ok || header_size_ == 0 || header_size_ > file_size_ - 8) {
+        std::cerr << "Error: Invalid header size in " << filepath_ << std::endl;
+        close(fd);
+        return false;
+    }
+
+    if (verbose_) std::cout << "Parsing: " << filepath_ << " (" << (file_size_ / 1024.0 / 1024.0) << " MB)" << std::endl;
+
+    header_.resize(header_size_);
     size_t tensor_data_size = file_size_ - 8 - header_size_;
     tensor_data_.resize(tensor_data_size);
-    file.read(reinterpret_cast<char*>(tensor_data_.data()), tensor_data_size);
+    try {
+        AsyncIO io;
+        AsyncIO::Ticket header_read =
+            io.read(fd, std::span<uint8_t>(reinterpret_cast<uint8_t*>(header_.data()), header_size_), 8);
+        AsyncIO::Ticket payload_read = io.read(fd, tensor_data_, 8 + header_size_);
+        io.wait(header_read);
+        io.wait(payload_read);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Cannot read " << filepath_ << ": " << e.what() << std::endl;
+        close(fd);
+        return false;
+    }
+    close(fd);
+    tensor_span_ = std::span<const uint8_t>(tensor_data_.data(), tensor_data_.size());
+    data_size_ = tensor_data_size;
+
+    parseTensorTable();
+    if (verbose_) std::cout << "Header: " << header_size_ << " bytes, Tensors: "
+              << (tensor_data_size / 1024.0 / 1024.0) << " MB (" << tensors_.size() << " tensors)" << std::endl;
+    return true;
+}
+
+// Reads only the header; the payload is pulled window by window with pread,
+// so nothing proportional to the model size is kept in memory.
+bool SafetensorsParser::parseStream(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8) {
+        std::cerr << "Error: Invalid safetensors file " << filepath_ << std::endl;
+        return false;
+    }
+    file_size_ = static_cast<size_t>(st.st_size);
+
+    if (verbose_) std::cout << "Parsing: " << filepath_ << " (" << (file_size_ / 1024.0 / 1024.0) << " MB, streaming)" << std::endl;
+
+    uint64_t header_size_le = 0;
+    if (pread(fd, &header_size_le, 8, 0) != 8) return false;
+    header_size_ = header_size_le;
+    if (header_size_ == 0 || header_size_ > file_size_ - 8) {
+        std::cerr << "Error: Invalid header size in " << filepath_ << std::endl;
+        return false;
+    }
 
-    std::cout << "Header: " << header_size_ << " bytes, Tensors: "
-              << (tensor_data_size / 1024.0 / 1024.0) << " MB" << std::endl;
+    header_.resize(header_size_);
+    if (pread(fd, header_.data(), header_size_, 8) != static_cast<ssize_t>(header_size_)) return false;
+    data_size_ = file_size_ - 8 - header_size_;
+    fd_ = fd;
 
-    file.close();
+    parseTensorTable();
+    if (verbose_) std::cout << "Header: " << header_size_ << " bytes, Tensors: "
+              << (data_size_ / 1024.0 / 1024.0) << " MB (" << tensors_.size() << " tensors)" << std::endl;
     return true;
 }
+
+bool SafetensorsParser::readTensorData(uint64_t offset, std::span<uint8_t> out) const {
+    if (offset > data_size_ || out.size() > data_size_ - offset) return false;
+
+    if (fd_ < 0) {
+        memcpy(out.data(), tensor_span_.data() + offset, out.size());
+        return true;
+    }
+
+    uint64_t file_offset = 8 + header_size_ + offset;
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = pread(fd_, out.data() + done, out.size() - done, file_offset + done);
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+AsyncIO::Ticket SafetensorsParser::readTensorData(AsyncIO& io, uint64_t offset, std::span<uint8_t> out) const {
+    if (offset > data_size_ || out.size() > data_size_ - offset) {
+        throw std::runtime_error("Tensor data read out of range at offset " + std::to_string(offset));
+    }
+    if (fd_ < 0) {
+        memcpy(out.data(), tensor_span_.data() + offset, out.size());
+        return 0;
+    }
+    return io.read(fd_, out, 8 + header_size_ + offset);
+}
+
+void SafetensorsParser::prefetchTensorData(uint64_t offset, size_t size) const {
+    if (!mapping_ || offset >= data_size_) return;
+    size = std::min<uint64_t>(size, data_size_ - offset);
+
+    // madvise wants a page-aligned start
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(tensor_span_.data() + offset);
+    uintptr_t aligned = begin & ~(page - 1);
+    madvise(reinterpret_cast<void*>(aligned), size + (begin - aligned), MADV_WILLNEED);
+}
+
+bool SafetensorsParser::dropPageCache() const {
+    if (mapping_) madvise(mapping_, file_size_, MADV_DONTNEED);
+    if (!mapping_ && fd_ < 0) return false;  // READ mode keeps its own copy
+
+    int fd = fd_ >= 0 ? fd_ : open(filepath_.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    if (fd != fd_) close(fd);
+    return rc == 0;
+}
+
+bool SafetensorsParser::parseTensorTable() {
+    if (!parseHeader(header_, data_size_, tensors_)) {
+        // Keep going without a table: the payload is then handled as one opaque blob
+        std::cerr << "Warning: Could not parse tensor table, treating payload as a single BF16 blob" << std::endl;
+        tensors_.clear();
+        return false;
+    }
+    return true;
+}
+
+const TensorInfo* SafetensorsParser::findTensor(const std::string& name) const {
+    for (const auto& t : tensors_) {
+        if (t.name == name) return &t;
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// HEADER JSON SCANNER
+// ============================================================================
+
+namespace {
+
+/**
+ * Minimal single-pass JSON scanner for safetensors headers.
+ *
+ * The header is a flat object mapping tensor names to
+ * {"dtype": str, "shape": [int...], "data_offsets": [begin, end]}, plus an
+ * optional "__metadata__" object of strings. Anything not needed for the
+ * tensor table is skipped without building a DOM.
+ */
+class HeaderScanner {
+public:
+    explicit HeaderScanner(const std::string& text)
+        : p_(text.data()), end_(text.data() + text.size()) {}
+
+    bool parse(std::vector<TensorInfo>& tensors) {
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do {
+            std::string key;
+            if (!parseString(key) || !consume(':')) return false;
+            if (key == "__metadata__") {
+                if (!skipValue()) return false;
+                continue;
+            }
+            TensorInfo info;
+            info.name = std::move(key);
+            if (!parseTensor(info)) return false;
+            tensors.push_back(std::move(info));
+        } while (consume(','));
+        return consume('}');
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+
+    void skipWhitespace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parseHex4(uint32_t& out) {
+        if (end_ - p_ < 4) return false;
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            int v = hexValue(*p_++);
+            if (v < 0) return false;
+            out = (out << 4) | static_cast<uint32_t>(v);
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool parseString(std::string& out) {
+        if (!consume('"')) return false;
+        out.clear();
+        while (p_ < end_) {
+            // Copy the unescaped run in one go
+            const char* run = p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\') ++p_;
+            out.append(run, p_ - run);
+            if (p_ >= end_) return false;
+            if (*p_ == '"') {
+                ++p_;
+                return true;
+            }
+            if (++p_ >= end_) return false;
+            char esc = *p_++;
+            switch (esc) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!parseHex4(cp)) return false;
+                    // Combine UTF-16 surrogate pairs; a half without its
+                    // partner has no code point and is not valid JSON text
+                    if (cp >= 0xDC00 && cp <= 0xDFFF) return false;
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u') return false;
+                        p_ += 2;
+                        uint32_t low;
+                        if (!parseHex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseInt(int64_t& out) {
+        skipWhitespace();
+        bool negative = false;
+        if (p_ < end_ && *p_ == '-') {
+            negative = true;
+            ++p_;
+        }
+        if (p_ >= end_ || *p_ < '0' || *p_ > '9') return false;
+        // Magnitudes past the int64_t range are rejected, not wrapped
+        const uint64_t limit = negative ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1;
+        uint64_t value = 0;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+            uint64_t digit = static_cast<uint64_t>(*p_ - '0');
+            if (value > (limit - digit) / 10) return false;
+            value = value * 10 + digit;
+            ++p_;
+        }
+        out = negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+        return true;
+    }
+
+    bool parseIntArray(std::vector<int64_t>& out) {
+        out.clear();
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            int64_t v;
+            if (!parseInt(v)) return false;
+            out.push_back(v);
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool parseTensor(TensorInfo& info) {
+        bool has_dtype = false, has_offsets = false;
+        if (!consume('{')) return false;
+        if (!consume('}')) {
+            do {
+                std::string key;
+                if (!parseString(key) || !consume(':')) return false;
+                if (key == "dtype") {
+                    std::string dtype;
+                    if (!parseString(dtype)) return false;
+                    info.dtype = SafetensorsParser::parseDType(dtype);
+                    has_dtype = true;
+                } else if (key == "shape") {
+                    if (!parseIntArray(info.shape)) return false;
+                } else if (key == "data_offsets") {
+                    std::vector<int64_t> offsets;
+                    if (!parseIntArray(offsets) || offsets.size() != 2) return false;
+                    if (offsets[0] < 0 || offsets[1] < offsets[0]) return false;
+                    info.data_begin = static_cast<uint64_t>(offsets[0]);
+                    info.data_end = static_cast<uint64_t>(offsets[1]);
+                    has_offsets = true;
+                } else if (!skipValue()) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume('}')) return false;
+        }
+        return has_dtype && has_offsets;
+    }
+
+    bool skipValue(int depth = 0) {
+        if (depth > 64) return false;
+        skipWhitespace();
+        if (p_ >= end_) return false;
+        char c = *p_;
+        if (c == '"') {
+            std::string ignored;
+            return parseString(ignored);
+        }
+        if (c == '{' || c == '[') {
+            char close = (c == '{') ? '}' : ']';
+            ++p_;
+            if (consume(close)) return true;
+            do {
+                if (c == '{') {
+                    std::string key;
+                    if (!parseString(key) || !consume(':')) return false;
+                }
+                if (!skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume(close);
+        }
+        // Number, true, false or null
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+               *p_ != ' ' && *p_ != '\n' && *p_ != '\r' && *p_ != '\t') ++p_;
+        return p_ > start;
+    }
+};
+
+} // namespace
+
+bool SafetensorsParser::parseHeader(const std::string& header, size_t data_size,
+                                    std::vector<TensorInfo>& tensors) {
+    tensors.clear();
+    HeaderScanner scanner(header);
+    if (!scanner.parse(tensors)) {
+        tensors.clear();
+        return false;
+    }
+
+    std::sort(tensors.begin(), tensors.end(), [](const TensorInfo& a, const TensorInfo& b) {
+        return a.data_begin < b.data_begin;
+    });
+
+    uint64_t prev_end = 0;
+    for (const auto& t : tensors) {
+        size_t elem = getDTypeSize(t.dtype);
+        if (t.data_end > data_size || t.data_begin < prev_end ||
+            (elem > 0 && t.size() % elem != 0)) {
+            tensors.clear();
+            return false;
+        }
+        prev_end = t.data_end;
+    }
+    return true;
+}
+
+DType SafetensorsParser::parseDType(const std::string& name) {
+    if (name == "BF16") return DType::BF16;
+    if (name == "F16") return DType::F16;
+    if (name == "F32") return DType::F32;
+    if (name == "F64") return DType::F64;
+    if (name == "I8") return DType::I8;
+    if (name == "U8") return DType::U8;
+    if (name == "I16") return DType::I16;
+    if (name == "U16") return DType::U16;
+    if (name == "I32") return DType::I32;
+    if (name == "U32") return DType::U32;
+    if (name == "I64") return DType::I64;
+    if (name == "U64") return DType::U64;
+    if (name == "BOOL") return DType::BOOL;
+    if (name == "F8_E4M3") return DType::F8_E4M3;
+    if (name == "F8_E5M2") return DType::F8_E5M2;
+    return DType::UNKNOWN;
+}
+
+std::string SafetensorsParser::getDTypeName(DType dtype) {
+    switch (dtype) {
+        case DType::BOOL: return "BOOL";
+        case DType::U8: return "U8";
+        case DType::I8: return "I8";
+        case DType::F8_E4M3: return "F8_E4M3";
+        case DType::F8_E5M2: return "F8_E5M2";
+        case DType::I16: return "I16";
+        case DType::U16: return "U16";
+        case DType::F16: return "F16";
+        case DType::BF16: return "BF16";
+        case DType::I32: return "I32";
+        case DType::U32: return "U32";
+        case DType::F32: return "F32";
+        case DType::I64: return "I64";
+        case DType::U64: return "U64";
+        case DType::F64: return "F64";
+        case DType::UNKNOWN: return "UNKNOWN";
+    }
+    return "UNKNOWN";
+}
+
+size_t SafetensorsParser::getDTypeSize(DType dtype) {
+    switch (dtype) {
+        case DType::BOOL:
+        case DType::U8:
+        case DType::I8:
+        case DType::F8_E4M3:
+        case DType::F8_E5M2: return 1;
+        case DType::I16:
+        case DType::U16:
+        case DType::F16:
+        case DType::BF16: return 2;
+        case DType::I32:
+        case DType::U32:
+        case DType::F32: return 4;
+        case DType::I64:
+        case DType::U64:
+        case DType::F64: return 8;
+        case DType::UNKNOWN: return 0;
+    }
+    return 0;
+}
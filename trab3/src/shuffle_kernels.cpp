@@ -0,0 +1,829 @@
+#include "../includes/shuffle_kernels.hpp"
+#include "../includes/thread_pool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHUFFLE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace shuffle {
+namespace {
+
+enum class Isa { SCALAR, SSE2, AVX2, AVX512 };
+
+Isa detectIsa() {
+#ifdef SHUFFLE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#endif
+    return Isa::SCALAR;
+}
+
+Isa activeIsa() {
+    static const Isa isa = detectIsa();
+    return isa;
+}
+
+void shuffleScalar(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size, size_t first) {
+    for (size_t b = 0; b < elem_size; ++b) {
+        uint8_t* plane = dst + b * count;
+        for (size_t i = first; i < count; ++i) plane[i] = src[i * elem_size + b];
+    }
+}
+
+void unshuffleScalar(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size, size_t first) {
+    for (size_t b = 0; b < elem_size; ++b) {
+        const uint8_t* plane = src + b * count;
+        for (size_t i = first; i < count; ++i) dst[i * elem_size + b] = plane[i];
+    }
+}
+
+#ifdef SHUFFLE_X86
+// The vector kernels load K vectors holding W elements of K bytes and apply
+// log2(K) rounds of the same step: split every adjacent pair of vectors into
+// its even and its odd bytes, evens first. After the last round vector b
+// holds byte b of all W elements. Unshuffling runs the inverse step (an
+// interleave of vector j with vector K/2 + j) the same number of times.
+// Each ISA only differs in how one split/merge is done; packus works within
+// 128-bit lanes, so AVX2 and AVX-512 add a 64-bit permute to undo that.
+
+// ---- SSE2: W = 16 ------------------------------------------------------
+
+__attribute__((target("sse2"), always_inline))
+static inline void splitSSE2(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    odd = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+__attribute__((target("sse2"), always_inline))
+static inline void mergeSSE2(__m128i even, __m128i odd, __m128i& a, __m128i& b) {
+    a = _mm_unpacklo_epi8(even, odd);
+    b = _mm_unpackhi_epi8(even, odd);
+}
+
+template <size_t K>
+__attribute__((target("sse2")))
+size_t shuffleSSE2(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 16;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m128i v[K], t[K];
+        const uint8_t* s = src + blk * W * K;
+        for (size_t j = 0; j < K; ++j) v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + j * W));
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) splitSSE2(v[2 * j], v[2 * j + 1], t[j], t[K / 2 + j]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        for (size_t j = 0; j < K; ++j) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j * count + blk * W), v[j]);
+    }
+    return blocks * W;
+}
+
+template <size_t K>
+__attribute__((target("sse2")))
+size_t unshuffleSSE2(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 16;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m128i v[K], t[K];
+        for (size_t j = 0; j < K; ++j) v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j * count + blk * W));
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) mergeSSE2(v[j], v[K / 2 + j], t[2 * j], t[2 * j + 1]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        uint8_t* d = dst + blk * W * K;
+        for (size_t j = 0; j < K; ++j) _mm_storeu_si128(reinterpret_cast<__m128i*>(d + j * W), v[j]);
+    }
+    return blocks * W;
+}
+
+// ---- AVX2: W = 32 ------------------------------------------------------
+
+__attribute__((target("avx2"), always_inline))
+static inline void splitAVX2(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    even = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask)), 0xD8);
+    odd = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8)), 0xD8);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void mergeAVX2(__m256i even, __m256i odd, __m256i& a, __m256i& b) {
+    even = _mm256_permute4x64_epi64(even, 0xD8);
+    odd = _mm256_permute4x64_epi64(odd, 0xD8);
+    a = _mm256_unpacklo_epi8(even, odd);
+    b = _mm256_unpackhi_epi8(even, odd);
+}
+
+template <size_t K>
+__attribute__((target("avx2")))
+size_t shuffleAVX2(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 32;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m256i v[K], t[K];
+        const uint8_t* s = src + blk * W * K;
+        for (size_t j = 0; j < K; ++j) v[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + j * W));
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) splitAVX2(v[2 * j], v[2 * j + 1], t[j], t[K / 2 + j]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        for (size_t j = 0; j < K; ++j) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j * count + blk * W), v[j]);
+    }
+    return blocks * W;
+}
+
+template <size_t K>
+__attribute__((target("avx2")))
+size_t unshuffleAVX2(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 32;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m256i v[K], t[K];
+        for (size_t j = 0; j < K; ++j) v[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j * count + blk * W));
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) mergeAVX2(v[j], v[K / 2 + j], t[2 * j], t[2 * j + 1]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        uint8_t* d = dst + blk * W * K;
+        for (size_t j = 0; j < K; ++j) _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + j * W), v[j]);
+    }
+    return blocks * W;
+}
+
+// ---- AVX-512BW: W = 64 -------------------------------------------------
+
+// GCC 12 flags the self-initialised _mm512_undefined_epi32() inside
+// _mm512_permutexvar_epi64 as maybe-uninitialized; it is a false positive
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512bw"), always_inline))
+static inline void splitAVX512(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+    const __m512i mask = _mm512_set1_epi16(0x00FF);
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    even = _mm512_permutexvar_epi64(order, _mm512_packus_epi16(_mm512_and_si512(a, mask), _mm512_and_si512(b, mask)));
+    odd = _mm512_permutexvar_epi64(order, _mm512_packus_epi16(_mm512_srli_epi16(a, 8), _mm512_srli_epi16(b, 8)));
+}
+
+__attribute__((target("avx512f,avx512bw"), always_inline))
+static inline void mergeAVX512(__m512i even, __m512i odd, __m512i& a, __m512i& b) {
+    const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+    even = _mm512_permutexvar_epi64(order, even);
+    odd = _mm512_permutexvar_epi64(order, odd);
+    a = _mm512_unpacklo_epi8(even, odd);
+    b = _mm512_unpackhi_epi8(even, odd);
+}
+
+template <size_t K>
+__attribute__((target("avx512f,avx512bw")))
+size_t shuffleAVX512(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 64;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m512i v[K], t[K];
+        const uint8_t* s = src + blk * W * K;
+        for (size_t j = 0; j < K; ++j) v[j] = _mm512_loadu_si512(s + j * W);
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) splitAVX512(v[2 * j], v[2 * j + 1], t[j], t[K / 2 + j]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        for (size_t j = 0; j < K; ++j) _mm512_storeu_si512(dst + j * count + blk * W, v[j]);
+    }
+    return blocks * W;
+}
+
+template <size_t K>
+__attribute__((target("avx512f,avx512bw")))
+size_t unshuffleAVX512(const uint8_t* src, uint8_t* dst, size_t count) {
+    constexpr size_t W = 64;
+    const size_t blocks = count / W;
+    for (size_t blk = 0; blk < blocks; ++blk) {
+        __m512i v[K], t[K];
+        for (size_t j = 0; j < K; ++j) v[j] = _mm512_loadu_si512(src + j * count + blk * W);
+        for (size_t round = 1; round < K; round *= 2) {
+            for (size_t j = 0; j < K / 2; ++j) mergeAVX512(v[j], v[K / 2 + j], t[2 * j], t[2 * j + 1]);
+            for (size_t j = 0; j < K; ++j) v[j] = t[j];
+        }
+        uint8_t* d = dst + blk * W * K;
+        for (size_t j = 0; j < K; ++j) _mm512_storeu_si512(d + j * W, v[j]);
+    }
+    return blocks * W;
+}
+
+// ---- Bit planes of 16-bit values -----------------------------------------
+//
+// Once W values are split into a vector of low bytes and one of high bytes,
+// shifting every 16-bit lane left by 7 - b moves bit b of each byte into its
+// top bit, and movemask collects those W bits: W / 8 consecutive bytes of
+// plane b, value i at bit i % 8. The inverse expands each plane mask back
+// into 0x00/0xFF bytes, keeps bit b of them and merges the two byte vectors.
+// Each kernel returns the first value it did not handle.
+
+__attribute__((target("sse2")))
+size_t bitShuffleSSE2(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    constexpr size_t W = 16;
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m128i lo, hi;
+        splitSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i)),
+                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 16)), lo, hi);
+        for (int b = 0; b < 8; ++b) {
+            uint16_t mask_lo = _mm_movemask_epi8(_mm_slli_epi16(lo, 7 - b));
+            uint16_t mask_hi = _mm_movemask_epi8(_mm_slli_epi16(hi, 7 - b));
+            memcpy(dst + b * stride + i / 8, &mask_lo, sizeof(mask_lo));
+            memcpy(dst + (8 + b) * stride + i / 8, &mask_hi, sizeof(mask_hi));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t bitShuffleAVX2(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    constexpr size_t W = 32;
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m256i lo, hi;
+        splitAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i)),
+                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i + 32)), lo, hi);
+        for (int b = 0; b < 8; ++b) {
+            uint32_t mask_lo = _mm256_movemask_epi8(_mm256_slli_epi16(lo, 7 - b));
+            uint32_t mask_hi = _mm256_movemask_epi8(_mm256_slli_epi16(hi, 7 - b));
+            memcpy(dst + b * stride + i / 8, &mask_lo, sizeof(mask_lo));
+            memcpy(dst + (8 + b) * stride + i / 8, &mask_hi, sizeof(mask_hi));
+        }
+    }
+    return i;
+}
+
+// 32 plane bits -> 32 bytes of 0xFF (bit set) or 0x00
+__attribute__((target("avx2"), always_inline))
+static inline __m256i expandMaskAVX2(uint32_t mask) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits = _mm256_set1_epi64x(0x8040201008040201LL);
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(mask)), spread);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits);
+}
+
+__attribute__((target("avx2")))
+size_t bitUnshuffleAVX2(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    constexpr size_t W = 32;
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+        for (int b = 0; b < 8; ++b) {
+            uint32_t mask_lo, mask_hi;
+            memcpy(&mask_lo, src + b * stride + i / 8, sizeof(mask_lo));
+            memcpy(&mask_hi, src + (8 + b) * stride + i / 8, sizeof(mask_hi));
+            const __m256i bit = _mm256_set1_epi8(static_cast<char>(1 << b));
+            lo = _mm256_or_si256(lo, _mm256_and_si256(expandMaskAVX2(mask_lo), bit));
+            hi = _mm256_or_si256(hi, _mm256_and_si256(expandMaskAVX2(mask_hi), bit));
+        }
+        __m256i a, c;
+        mergeAVX2(lo, hi, a, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 32), c);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+size_t bitShuffleAVX512(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    constexpr size_t W = 64;
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m512i lo, hi;
+        splitAVX512(_mm512_loadu_si512(src + 2 * i), _mm512_loadu_si512(src + 2 * i + 64), lo, hi);
+        for (int b = 0; b < 8; ++b) {
+            uint64_t mask_lo = _mm512_movepi8_mask(_mm512_slli_epi16(lo, 7 - b));
+            uint64_t mask_hi = _mm512_movepi8_mask(_mm512_slli_epi16(hi, 7 - b));
+            memcpy(dst + b * stride + i / 8, &mask_lo, sizeof(mask_lo));
+            memcpy(dst + (8 + b) * stride + i / 8, &mask_hi, sizeof(mask_hi));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+size_t bitUnshuffleAVX512(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    constexpr size_t W = 64;
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m512i lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+        for (int b = 0; b < 8; ++b) {
+            uint64_t mask_lo, mask_hi;
+            memcpy(&mask_lo, src + b * stride + i / 8, sizeof(mask_lo));
+            memcpy(&mask_hi, src + (8 + b) * stride + i / 8, sizeof(mask_hi));
+            const __m512i bit = _mm512_set1_epi8(static_cast<char>(1 << b));
+            lo = _mm512_or_si512(lo, _mm512_maskz_mov_epi8(mask_lo, bit));
+            hi = _mm512_or_si512(hi, _mm512_maskz_mov_epi8(mask_hi, bit));
+        }
+        __m512i a, c;
+        mergeAVX512(lo, hi, a, c);
+        _mm512_storeu_si512(dst + 2 * i, a);
+        _mm512_storeu_si512(dst + 2 * i + 64, c);
+    }
+    return i;
+}
+
+// ---- Sign/exponent/mantissa fields of 16-bit floats ----------------------
+//
+// The vector kernels take 32 values as 16-bit lanes. Shifting out the
+// mantissa and packing the lanes to bytes gives the exponents; packs keeps
+// the sign of every lane, so movemask of the packed lanes is the sign
+// bitmap. BMI2 pext squeezes the masked mantissas to M bits each and pdep
+// spreads them back. Packing works within 128-bit halves, hence the
+// permute after each pack. Each kernel returns the first value it did not
+// handle.
+
+template <unsigned M>
+__attribute__((target("avx2,bmi2")))
+size_t fieldSplitAVX2(const uint8_t* src, uint8_t* exps, uint8_t* signs, uint8_t* mants,
+                      size_t first, size_t last) {
+    constexpr size_t W = 32;
+    const __m256i exp_mask = _mm256_set1_epi16(static_cast<short>((1 << (15 - M)) - 1));
+    const __m256i mant_mask = _mm256_set1_epi16(static_cast<short>((1 << M) - 1));
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i + 32));
+
+        __m256i e = _mm256_packus_epi16(_mm256_and_si256(_mm256_srli_epi16(a, M), exp_mask),
+                                        _mm256_and_si256(_mm256_srli_epi16(b, M), exp_mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(exps + i), _mm256_permute4x64_epi64(e, 0xD8));
+
+        uint32_t s = _mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8));
+        memcpy(signs + i / 8, &s, sizeof(s));
+
+        __m256i ma = _mm256_and_si256(a, mant_mask), mb = _mm256_and_si256(b, mant_mask);
+        uint8_t* p = mants + i / 8 * M;
+        alignas(32) uint64_t q[8];
+        if constexpr (M <= 8) {
+            // 8 mantissas per byte-lane quadword -> M bytes
+            __m256i m = _mm256_permute4x64_epi64(_mm256_packus_epi16(ma, mb), 0xD8);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(q), m);
+            const uint64_t sel = 0x0101010101010101ULL * ((1u << M) - 1);
+            for (int g = 0; g < 4; ++g) {
+                uint64_t w = _pext_u64(q[g], sel);
+                memcpy(p + g * M, &w, M);
+            }
+        } else {
+            // 4 mantissas per 16-bit-lane quadword -> M / 2 bytes
+            _mm256_store_si256(reinterpret_cast<__m256i*>(q), ma);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(q + 4), mb);
+            const uint64_t sel = 0x0001000100010001ULL * ((1u << M) - 1);
+            for (int h = 0; h < 8; ++h) {
+                uint64_t w = _pext_u64(q[h], sel);
+                memcpy(p + h * (M / 2), &w, M / 2);
+            }
+        }
+    }
+    return i;
+}
+
+template <unsigned M>
+__attribute__((target("avx2,bmi2")))
+size_t fieldMergeAVX2(const uint8_t* exps, const uint8_t* signs, const uint8_t* mants, uint8_t* dst,
+                      size_t first, size_t last) {
+    constexpr size_t W = 32;
+    const __m256i exp_mask = _mm256_set1_epi16(static_cast<short>((1 << (15 - M)) - 1));
+    const __m256i sign_bit = _mm256_set1_epi16(static_cast<short>(0x8000));
+    size_t i = first;
+    for (; i + W <= last; i += W) {
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(exps + i));
+        __m128i e2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(exps + i + 16));
+        __m256i a = _mm256_slli_epi16(_mm256_and_si256(_mm256_cvtepu8_epi16(e), exp_mask), M);
+        __m256i b = _mm256_slli_epi16(_mm256_and_si256(_mm256_cvtepu8_epi16(e2), exp_mask), M);
+
+        uint32_t s;
+        memcpy(&s, signs + i / 8, sizeof(s));
+        __m256i sm = expandMaskAVX2(s);
+        a = _mm256_or_si256(a, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_castsi256_si128(sm)), sign_bit));
+        b = _mm256_or_si256(b, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_extracti128_si256(sm, 1)), sign_bit));
+
+        const uint8_t* p = mants + i / 8 * M;
+        uint64_t q[8];
+        if constexpr (M <= 8) {
+            const uint64_t sel = 0x0101010101010101ULL * ((1u << M) - 1);
+            for (int g = 0; g < 4; ++g) {
+                uint64_t w = 0;
+                memcpy(&w, p + g * M, M);
+                q[g] = _pdep_u64(w, sel);
+            }
+            __m256i m = _mm256_set_epi64x(q[3], q[2], q[1], q[0]);
+            a = _mm256_or_si256(a, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(m)));
+            b = _mm256_or_si256(b, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(m, 1)));
+        } else {
+            const uint64_t sel = 0x0001000100010001ULL * ((1u << M) - 1);
+            for (int h = 0; h < 8; ++h) {
+                uint64_t w = 0;
+                memcpy(&w, p + h * (M / 2), M / 2);
+                q[h] = _pdep_u64(w, sel);
+            }
+            a = _mm256_or_si256(a, _mm256_set_epi64x(q[3], q[2], q[1], q[0]));
+            b = _mm256_or_si256(b, _mm256_set_epi64x(q[7], q[6], q[5], q[4]));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 32), b);
+    }
+    return i;
+}
+#pragma GCC diagnostic pop
+#endif
+
+// Returns how many leading elements the vector kernel handled
+size_t shuffleVector(Isa isa, const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size) {
+#ifdef SHUFFLE_X86
+    switch (isa) {
+        case Isa::AVX512:
+            if (elem_size == 2) return shuffleAVX512<2>(src, dst, count);
+            if (elem_size == 4) return shuffleAVX512<4>(src, dst, count);
+            if (elem_size == 8) return shuffleAVX512<8>(src, dst, count);
+            break;
+        case Isa::AVX2:
+            if (elem_size == 2) return shuffleAVX2<2>(src, dst, count);
+            if (elem_size == 4) return shuffleAVX2<4>(src, dst, count);
+            if (elem_size == 8) return shuffleAVX2<8>(src, dst, count);
+            break;
+        case Isa::SSE2:
+            if (elem_size == 2) return shuffleSSE2<2>(src, dst, count);
+            if (elem_size == 4) return shuffleSSE2<4>(src, dst, count);
+            if (elem_size == 8) return shuffleSSE2<8>(src, dst, count);
+            break;
+        case Isa::SCALAR:
+            break;
+    }
+#else
+    (void)isa; (void)src; (void)dst; (void)count; (void)elem_size;
+#endif
+    return 0;
+}
+
+size_t unshuffleVector(Isa isa, const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size) {
+#ifdef SHUFFLE_X86
+    switch (isa) {
+        case Isa::AVX512:
+            if (elem_size == 2) return unshuffleAVX512<2>(src, dst, count);
+            if (elem_size == 4) return unshuffleAVX512<4>(src, dst, count);
+            if (elem_size == 8) return unshuffleAVX512<8>(src, dst, count);
+            break;
+        case Isa::AVX2:
+            if (elem_size == 2) return unshuffleAVX2<2>(src, dst, count);
+            if (elem_size == 4) return unshuffleAVX2<4>(src, dst, count);
+            if (elem_size == 8) return unshuffleAVX2<8>(src, dst, count);
+            break;
+        case Isa::SSE2:
+            if (elem_size == 2) return unshuffleSSE2<2>(src, dst, count);
+            if (elem_size == 4) return unshuffleSSE2<4>(src, dst, count);
+            if (elem_size == 8) return unshuffleSSE2<8>(src, dst, count);
+            break;
+        case Isa::SCALAR:
+            break;
+    }
+#else
+    (void)isa; (void)src; (void)dst; (void)count; (void)elem_size;
+#endif
+    return 0;
+}
+
+// Transposes an 8x8 bit matrix stored row by row in the bytes of x
+// (Hacker's Delight, 7-3): bit c of byte r moves to bit r of byte c
+uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;  x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL; x ^= t ^ (t << 28);
+    return x;
+}
+
+// Groups of 8 values; a short last group is padded with zero bits
+void bitShuffleScalar(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    for (size_t i = first; i < last; i += 8) {
+        size_t n = std::min<size_t>(8, last - i);
+        uint64_t lo = 0, hi = 0;
+        for (size_t k = 0; k < n; ++k) {
+            lo |= static_cast<uint64_t>(src[2 * (i + k)]) << (8 * k);
+            hi |= static_cast<uint64_t>(src[2 * (i + k) + 1]) << (8 * k);
+        }
+        lo = transpose8x8(lo);
+        hi = transpose8x8(hi);
+        for (size_t b = 0; b < 8; ++b) {
+            dst[b * stride + i / 8] = static_cast<uint8_t>(lo >> (8 * b));
+            dst[(8 + b) * stride + i / 8] = static_cast<uint8_t>(hi >> (8 * b));
+        }
+    }
+}
+
+void bitUnshuffleScalar(const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    for (size_t i = first; i < last; i += 8) {
+        size_t n = std::min<size_t>(8, last - i);
+        uint64_t lo = 0, hi = 0;
+        for (size_t b = 0; b < 8; ++b) {
+            lo |= static_cast<uint64_t>(src[b * stride + i / 8]) << (8 * b);
+            hi |= static_cast<uint64_t>(src[(8 + b) * stride + i / 8]) << (8 * b);
+        }
+        lo = transpose8x8(lo);
+        hi = transpose8x8(hi);
+        for (size_t k = 0; k < n; ++k) {
+            dst[2 * (i + k)] = static_cast<uint8_t>(lo >> (8 * k));
+            dst[2 * (i + k) + 1] = static_cast<uint8_t>(hi >> (8 * k));
+        }
+    }
+}
+
+// Values [first, last) with first a multiple of 8
+void bitShuffleRange(Isa isa, const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    size_t done = first;
+#ifdef SHUFFLE_X86
+    switch (isa) {
+        case Isa::AVX512: done = bitShuffleAVX512(src, dst, stride, first, last); break;
+        case Isa::AVX2: done = bitShuffleAVX2(src, dst, stride, first, last); break;
+        case Isa::SSE2: done = bitShuffleSSE2(src, dst, stride, first, last); break;
+        case Isa::SCALAR: break;
+    }
+#else
+    (void)isa;
+#endif
+    bitShuffleScalar(src, dst, stride, done, last);
+}
+
+// SSE2 has no byte shuffle to expand the masks; it uses the scalar transpose
+void bitUnshuffleRange(Isa isa, const uint8_t* src, uint8_t* dst, size_t stride, size_t first, size_t last) {
+    size_t done = first;
+#ifdef SHUFFLE_X86
+    switch (isa) {
+        case Isa::AVX512: done = bitUnshuffleAVX512(src, dst, stride, first, last); break;
+        case Isa::AVX2: done = bitUnshuffleAVX2(src, dst, stride, first, last); break;
+        case Isa::SSE2:
+        case Isa::SCALAR: break;
+    }
+#else
+    (void)isa;
+#endif
+    bitUnshuffleScalar(src, dst, stride, done, last);
+}
+
+bool hasBmi2() {
+#ifdef SHUFFLE_X86
+    static const bool bmi2 = __builtin_cpu_supports("bmi2");
+    return bmi2;
+#else
+    return false;
+#endif
+}
+
+// Groups of 8 values: 8 exponent bytes, one sign byte and m mantissa bytes;
+// a short last group writes only the bytes its values reach
+void fieldSplitScalar(const uint8_t* src, uint8_t* exps, uint8_t* signs, uint8_t* mants,
+                      unsigned m, size_t first, size_t last) {
+    const uint32_t mant_mask = (1u << m) - 1;
+    for (size_t i = first; i < last; i += 8) {
+        size_t n = std::min<size_t>(8, last - i);
+        uint8_t* p = mants + i / 8 * m;
+        uint8_t sign = 0;
+        uint64_t acc = 0;
+        unsigned bits = 0;
+        for (size_t k = 0; k < n; ++k) {
+            uint16_t v;
+            memcpy(&v, src + 2 * (i + k), sizeof(v));
+            exps[i + k] = static_cast<uint8_t>((v & 0x7FFF) >> m);
+            sign |= static_cast<uint8_t>((v >> 15) << k);
+            acc |= static_cast<uint64_t>(v & mant_mask) << bits;
+            for (bits += m; bits >= 8; bits -= 8) {
+                *p++ = static_cast<uint8_t>(acc);
+                acc >>= 8;
+            }
+        }
+        if (bits) *p = static_cast<uint8_t>(acc);
+        signs[i / 8] = sign;
+    }
+}
+
+void fieldMergeScalar(const uint8_t* exps, const uint8_t* signs, const uint8_t* mants, uint8_t* dst,
+                      unsigned m, size_t first, size_t last) {
+    const uint32_t mant_mask = (1u << m) - 1;
+    for (size_t i = first; i < last; i += 8) {
+        size_t n = std::min<size_t>(8, last - i);
+        const uint8_t* p = mants + i / 8 * m;
+        uint64_t acc = 0;
+        unsigned bits = 0;
+        for (size_t k = 0; k < n; ++k) {
+            for (; bits < m; bits += 8) acc |= static_cast<uint64_t>(*p++) << bits;
+            uint16_t v = static_cast<uint16_t>(((signs[i / 8] >> k) & 1) << 15 |
+                                               ((static_cast<uint32_t>(exps[i + k]) << m) & 0x7FFF) |
+                                               (acc & mant_mask));
+            acc >>= m;
+            bits -= m;
+            memcpy(dst + 2 * (i + k), &v, sizeof(v));
+        }
+    }
+}
+
+// The vector kernels cover the BF16 (7-bit) and FP16 (10-bit) mantissas
+size_t fieldSplitVector(Isa isa, const uint8_t* src, uint8_t* exps, uint8_t* signs, uint8_t* mants,
+                        unsigned m, size_t first, size_t last) {
+#ifdef SHUFFLE_X86
+    if ((isa == Isa::AVX2 || isa == Isa::AVX512) && hasBmi2()) {
+        if (m == 7) return fieldSplitAVX2<7>(src, exps, signs, mants, first, last);
+        if (m == 10) return fieldSplitAVX2<10>(src, exps, signs, mants, first, last);
+    }
+#else
+    (void)isa; (void)src; (void)exps; (void)signs; (void)mants; (void)m; (void)last;
+#endif
+    return first;
+}
+
+size_t fieldMergeVector(Isa isa, const uint8_t* exps, const uint8_t* signs, const uint8_t* mants, uint8_t* dst,
+                        unsigned m, size_t first, size_t last) {
+#ifdef SHUFFLE_X86
+    if ((isa == Isa::AVX2 || isa == Isa::AVX512) && hasBmi2()) {
+        if (m == 7) return fieldMergeAVX2<7>(exps, signs, mants, dst, first, last);
+        if (m == 10) return fieldMergeAVX2<10>(exps, signs, mants, dst, first, last);
+    }
+#else
+    (void)isa; (void)exps; (void)signs; (void)mants; (void)dst; (void)m; (void)last;
+#endif
+    return first;
+}
+
+// XOR of byte streams for the prediction transforms. dst may be a, so one
+// kernel serves both the out-of-place residuals and the in-place inverse.
+// Backward prediction walks down in whole vectors, loading both operands
+// before the store, so every byte is XORed with a value not yet replaced
+// whatever the distance.
+
+#ifdef SHUFFLE_X86
+__attribute__((target("sse2")))
+size_t xorBytesSSE2(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(x, y));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t xorBytesAVX2(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(x, y));
+    }
+    return i;
+}
+
+// Returns the first byte not handled; [that, count) is left for the caller
+__attribute__((target("sse2")))
+size_t xorPredictSSE2(uint8_t* p, size_t count, size_t distance) {
+    size_t i = count;
+    while (i >= distance + 16) {
+        i -= 16;
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i - distance));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(x, y));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t xorPredictAVX2(uint8_t* p, size_t count, size_t distance) {
+    size_t i = count;
+    while (i >= distance + 32) {
+        i -= 32;
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i - distance));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_xor_si256(x, y));
+    }
+    return i;
+}
+#endif
+
+size_t xorBytesVector(Isa isa, const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+#ifdef SHUFFLE_X86
+    if (isa == Isa::AVX512 || isa == Isa::AVX2) return xorBytesAVX2(a, b, dst, n);
+    if (isa == Isa::SSE2) return xorBytesSSE2(a, b, dst, n);
+#else
+    (void)isa; (void)a; (void)b; (void)dst; (void)n;
+#endif
+    return 0;
+}
+
+size_t xorPredictVector(Isa isa, uint8_t* p, size_t count, size_t distance) {
+#ifdef SHUFFLE_X86
+    if (isa == Isa::AVX512 || isa == Isa::AVX2) return xorPredictAVX2(p, count, distance);
+    if (isa == Isa::SSE2) return xorPredictSSE2(p, count, distance);
+#else
+    (void)isa; (void)p; (void)distance;
+#endif
+    return count;
+}
+
+// Splits [0, count) into ranges of whole plane bytes and runs them on the
+// shared pool; ranges never write the same output byte
+void forEachRange(size_t count, unsigned threads, const std::function<void(size_t, size_t)>& fn) {
+    const size_t grain = 1 << 18;  // Values per task, a multiple of every vector width
+    size_t parts = (count + grain - 1) / grain;
+    if (threads <= 1 || parts <= 1) {
+        fn(0, count);
+        return;
+    }
+    ThreadPool::shared().parallelFor(parts, threads, [&](size_t p) {
+        fn(p * grain, std::min(count, (p + 1) * grain));
+    });
+}
+
+} // namespace
+
+void byteShuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size) {
+    size_t done = shuffleVector(activeIsa(), src, dst, count, elem_size);
+    shuffleScalar(src, dst, count, elem_size, done);
+}
+
+void byteUnshuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elem_size) {
+    size_t done = unshuffleVector(activeIsa(), src, dst, count, elem_size);
+    unshuffleScalar(src, dst, count, elem_size, done);
+}
+
+void bitShuffle16(const uint8_t* src, uint8_t* dst, size_t count, unsigned threads) {
+    const size_t stride = (count + 7) / 8;
+    const Isa isa = activeIsa();
+    forEachRange(count, threads, [&](size_t first, size_t last) {
+        bitShuffleRange(isa, src, dst, stride, first, last);
+    });
+}
+
+void bitUnshuffle16(const uint8_t* src, uint8_t* dst, size_t count, unsigned threads) {
+    const size_t stride = (count + 7) / 8;
+    const Isa isa = activeIsa();
+    forEachRange(count, threads, [&](size_t first, size_t last) {
+        bitUnshuffleRange(isa, src, dst, stride, first, last);
+    });
+}
+
+void fieldSplit16(const uint8_t* src, uint8_t* exponents, uint8_t* signs, uint8_t* mantissas,
+                  size_t count, unsigned exp_bits, unsigned threads) {
+    const unsigned m = 15 - exp_bits;
+    const Isa isa = activeIsa();
+    forEachRange(count, threads, [&](size_t first, size_t last) {
+        size_t done = fieldSplitVector(isa, src, exponents, signs, mantissas, m, first, last);
+        fieldSplitScalar(src, exponents, signs, mantissas, m, done, last);
+    });
+}
+
+void fieldMerge16(const uint8_t* exponents, const uint8_t* signs, const uint8_t* mantissas, uint8_t* dst,
+                  size_t count, unsigned exp_bits, unsigned threads) {
+    const unsigned m = 15 - exp_bits;
+    const Isa isa = activeIsa();
+    forEachRange(count, threads, [&](size_t first, size_t last) {
+        size_t done = fieldMergeVector(isa, exponents, signs, mantissas, dst, m, first, last);
+        fieldMergeScalar(exponents, signs, mantissas, dst, m, done, last);
+    });
+}
+
+void xorBytes(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    for (size_t i = xorBytesVector(activeIsa(), a, b, dst, n); i < n; ++i) dst[i] = a[i] ^ b[i];
+}
+
+void xorPredict(uint8_t* data, size_t count, size_t distance) {
+    if (distance == 0 || count <= distance) return;
+    size_t i = xorPredictVector(activeIsa(), data, count, distance);
+    while (i > distance) {
+        --i;
+        data[i] ^= data[i - distance];
+    }
+}
+
+void xorReconstruct(uint8_t* data, size_t count, size_t distance) {
+    if (distance == 0 || count <= distance) return;
+    if (distance < 32) {
+        // Each vector would need bytes it has not restored yet
+        for (size_t i = distance; i < count; ++i) data[i] ^= data[i - distance];
+        return;
+    }
+    // Blocks of distance bytes only read the finished block before them
+    for (size_t i = distance; i < count; i += distance) {
+        xorBytes(data + i, data + i - distance, data + i, std::min(distance, count - i));
+    }
+}
+
+std::string getKernelName() {
+    switch (activeIsa()) {
+        case Isa::AVX512: return "AVX-512";
+        case Isa::AVX2: return "AVX2";
+        case Isa::SSE2: return "SSE2";
+        case Isa::SCALAR: return "Scalar";
+    }
+    return "Scalar";
+}
+
+} // namespace shuffle
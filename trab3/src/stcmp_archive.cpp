@@ -0,0 +1,798 @@
+#include "../includes/stcmp_archive.hpp"
+#include "../includes/thread_pool.hpp"
+#include "../includes/checksum.hpp"
+#include "../includes/io_util.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char STCMP_MAGIC[5] = {'S', 'T', 'C', 'M', 'P'};
+const char INDEX_MAGIC[4] = {'S', 'T', 'I', 'X'};
+const uint8_t CHUNKED_VERSION = 3;
+const uint8_t DICTIONARY_VERSION = 4;  // Version 3 plus a ZSTD dictionary ID
+const uint8_t CHECKSUM_VERSION = 5;    // Version 4 plus CRC32C checksums
+const uint8_t STORED_VERSION = 6;      // Version 5 plus stored (uncompressed) chunks
+const size_t FOOTER_SIZE = 8 + 4;
+const size_t INDEX_ENTRY_SIZE = 4 * 8 + 3;
+const size_t CHECKSUM_ENTRY_SIZE = INDEX_ENTRY_SIZE + 2 * 4;
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+template <typename T>
+void appendValue(std::vector<uint8_t>& out, T value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T takeValue(const uint8_t*& cursor) {
+    T value;
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+} // namespace
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+StcmpWriter::~StcmpWriter() {
+    io_.reset();  // Waits for writes still in flight
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool StcmpWriter::open(const std::string& filepath,
+                       const std::string& header,
+                       Compressor::Algorithm algo,
+                       Compressor::OperationPoint op_point,
+                       uint64_t raw_size,
+                       uint32_t dictionary_id) {
+    io_.reset();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) return false;
+    io_ = std::make_unique<AsyncIO>();
+    io_backend_ = io_->getBackend();
+
+    algo_ = algo;
+    op_point_ = op_point;
+    index_.clear();
+    payload_bytes_ = 0;
+    header_crc_ = checksum::crc32c(reinterpret_cast<const uint8_t*>(header.data()), header.size());
+
+    prefix_.assign(STCMP_MAGIC, STCMP_MAGIC + sizeof(STCMP_MAGIC));
+    appendValue<uint8_t>(prefix_, STORED_VERSION);
+    appendValue<uint8_t>(prefix_, static_cast<uint8_t>(algo));
+    appendValue<uint8_t>(prefix_, static_cast<uint8_t>(op_point));
+    appendValue<uint32_t>(prefix_, dictionary_id);
+
+    appendValue<uint64_t>(prefix_, header.size());
+    prefix_.insert(prefix_.end(), header.begin(), header.end());
+    appendValue<uint64_t>(prefix_, raw_size);
+
+    offset_ = prefix_.size();
+    try {
+        io_->write(fd_, prefix_, 0);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+AsyncIO::Ticket StcmpWriter::queueChunk(ChunkEntry entry, std::span<const uint8_t> payload) {
+    entry.file_offset = offset_;
+    entry.compressed_size = payload.size();
+    AsyncIO::Ticket ticket = io_->write(fd_, payload, offset_);
+
+    offset_ += payload.size();
+    payload_bytes_ += payload.size();
+    index_.push_back(entry);
+    return ticket;
+}
+
+bool StcmpWriter::addChunk(ChunkEntry entry, std::span<const uint8_t> compressed) {
+    if (!io_) return false;
+    try {
+        queueChunk(entry, compressed);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Compresses the plan in batches of chunks that run side by side on the
+// shared pool and are written in plan order, so the file layout does not
+// depend on the thread count. The batches form a pipeline: while batch b
+// compresses, batch b + 1 is read (or prefetched) and batch b - 1 is still
+// being written. Under a memory limit a batch only holds as many chunks as
+// fit the limit together with the buffers in flight.
+bool StcmpWriter::compressPlan(Compressor& compressor,
+                               const std::vector<Compressor::Segment>& plan,
+                               std::span<const uint8_t> data,
+                               const SafetensorsParser* source) {
+    if (plan.empty()) return true;
+    if (!io_) throw std::runtime_error("Archive is not open");
+    const bool streaming = source && source->isStreaming();
+
+    // Windows rotate over three batches (being read, being compressed,
+    // being written when stored raw), outputs over two (being compressed,
+    // being written)
+    const size_t WINDOW_SETS = 3;
+    const size_t OUTPUT_SETS = 2;
+
+    size_t threads = compressor.getThreads();
+    size_t batch = threads;
+    if (compressor.getMemoryLimit() != 0) {
+        size_t chunk = compressor.getChunkSize(algo_, op_point_);
+        size_t per_chunk = compressor.estimateChunkMemory(algo_, op_point_, chunk) +
+                           ((streaming ? WINDOW_SETS - 1 : 0) + OUTPUT_SETS - 1) * chunk;
+        batch = std::clamp<size_t>(compressor.getMemoryLimit() / per_chunk, 1, threads);
+    }
+    batch = std::min(batch, plan.size());
+    // Fewer chunks than threads: let each chunk use the remaining cores
+    unsigned inner = std::max<size_t>(1, threads / batch);
+    const size_t batches = (plan.size() + batch - 1) / batch;
+
+    // Per-slot buffers are reused by every batch and never zero-filled
+    std::vector<std::vector<ByteBuffer>> windows(streaming ? WINDOW_SETS : 0, std::vector<ByteBuffer>(batch));
+    std::vector<std::vector<ByteBuffer>> outputs(OUTPUT_SETS, std::vector<ByteBuffer>(batch));
+    std::vector<std::vector<AsyncIO::Ticket>> reads(WINDOW_SETS), writes(OUTPUT_SETS);
+    std::vector<ByteBuffer> scratch(batch);
+    std::vector<size_t> sizes(batch);
+    std::vector<Preprocessor::Strategy> strategies(batch);
+    std::vector<uint32_t> raw_crcs(batch), compressed_crcs(batch);
+    std::vector<uint8_t> stored(batch);
+
+    auto batchCount = [&](size_t b) { return std::min(batch, plan.size() - b * batch); };
+    auto fetch = [&](size_t b) {
+        size_t start = b * batch, n = batchCount(b);
+        if (streaming) {
+            std::vector<ByteBuffer>& window = windows[b % WINDOW_SETS];
+            reads[b % WINDOW_SETS].clear();
+            for (size_t i = 0; i < n; ++i) {
+                const Compressor::Segment& seg = plan[start + i];
+                window[i].resize(seg.size);
+                reads[b % WINDOW_SETS].push_back(source->readTensorData(*io_, seg.offset, window[i]));
+            }
+        } else if (source) {
+            const Compressor::Segment& last = plan[start + n - 1];
+            source->prefetchTensorData(plan[start].offset, last.offset + last.size - plan[start].offset);
+        }
+    };
+
+    try {
+        fetch(0);
+        for (size_t b = 0; b < batches; ++b) {
+            size_t start = b * batch, n = batchCount(b);
+            std::vector<ByteBuffer>& output = outputs[b % OUTPUT_SETS];
+
+            // Batch b - 2 is done with this output set and the window set
+            // batch b + 1 reads into
+            if (b >= OUTPUT_SETS) io_->wait(writes[b % OUTPUT_SETS]);
+            if (b + 1 < batches) fetch(b + 1);
+            if (streaming) io_->wait(reads[b % WINDOW_SETS]);
+
+            // A chunk the probe rates incompressible skips the codec; one the
+            // codec fails to shrink is stored as well, so no chunk grows
+            auto rawChunk = [&](size_t i) {
+                const Compressor::Segment& seg = plan[start + i];
+                return streaming ? std::span<const uint8_t>(windows[b % WINDOW_SETS][i])
+                                 : data.subspan(seg.offset, seg.size);
+            };
+            ThreadPool::shared().parallelFor(n, n, [&](size_t i) {
+                const Compressor::Segment& seg = plan[start + i];
+                std::span<const uint8_t> raw = rawChunk(i);
+                strategies[i] = compressor.getAutoStrategy()
+                    ? compressor.selectStrategy(raw, algo_, seg.strategy, op_point_, seg.row_length)
+                    : seg.strategy;
+                raw_crcs[i] = checksum::crc32c(raw);
+                stored[i] = !compressor.worthCompressing(raw, algo_, strategies[i], seg.row_length);
+                if (!stored[i]) {
+                    output[i].resize(Compressor::maxCompressedSize(seg.size, algo_, strategies[i]));
+                    sizes[i] = compressor.compressChunk(raw, output[i], algo_, strategies[i], op_point_, scratch[i],
+                                                        inner, seg.row_length);
+                    stored[i] = sizes[i] >= seg.size;
+                }
+                compressed_crcs[i] = stored[i] ? raw_crcs[i] : checksum::crc32c(output[i].data(), sizes[i]);
+            });
+
+            writes[b % OUTPUT_SETS].clear();
+            for (size_t i = 0; i < n; ++i) {
+                const Compressor::Segment& seg = plan[start + i];
+                ChunkEntry entry;
+                entry.raw_offset = seg.offset;
+                entry.raw_size = seg.size;
+                entry.algo = algo_;
+                entry.strategy = stored[i] ? Preprocessor::Strategy::NONE : strategies[i];
+                entry.flags = stored[i] ? ChunkEntry::STORED : 0;
+                entry.raw_crc = raw_crcs[i];
+                entry.compressed_crc = compressed_crcs[i];
+                std::span<const uint8_t> payload = stored[i] ? rawChunk(i)
+                                                             : std::span<const uint8_t>(output[i].data(), sizes[i]);
+                writes[b % OUTPUT_SETS].push_back(queueChunk(entry, payload));
+            }
+        }
+        for (const auto& tickets : writes) io_->wait(tickets);
+    } catch (...) {
+        // The buffers die with this frame: let the kernel finish with them first
+        try {
+            io_->drain();
+        } catch (const std::exception&) {
+        }
+        throw;
+    }
+    return true;
+}
+
+bool StcmpWriter::writeChunks(Compressor& compressor,
+                              std::span<const uint8_t> data,
+                              const std::vector<TensorInfo>& tensors) {
+    try {
+        std::vector<Compressor::Segment> plan = compressor.planChunks(tensors, data.size(), algo_, op_point_);
+        return compressPlan(compressor, plan, data, nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool StcmpWriter::writeChunks(Compressor& compressor, const SafetensorsParser& source) {
+    try {
+        std::vector<Compressor::Segment> plan =
+            compressor.planChunks(source.getTensors(), source.getTensorDataSize(), algo_, op_point_);
+        return compressPlan(compressor, plan, source.getTensorData(), &source);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+size_t StcmpWriter::getStoredCount() const {
+    return std::count_if(index_.begin(), index_.end(), [](const ChunkEntry& e) { return e.isStored(); });
+}
+
+bool StcmpWriter::finish() {
+    if (!io_) return false;
+    uint64_t index_offset = offset_;
+
+    // Built in memory first, so its own CRC can close it
+    suffix_.clear();
+    suffix_.reserve(4 + index_.size() * CHECKSUM_ENTRY_SIZE + 8 + FOOTER_SIZE);
+    appendValue<uint32_t>(suffix_, static_cast<uint32_t>(index_.size()));
+    for (const auto& e : index_) {
+        appendValue<uint64_t>(suffix_, e.raw_offset);
+        appendValue<uint64_t>(suffix_, e.raw_size);
+        appendValue<uint64_t>(suffix_, e.file_offset);
+        appendValue<uint64_t>(suffix_, e.compressed_size);
+        appendValue<uint8_t>(suffix_, static_cast<uint8_t>(e.algo));
+        appendValue<uint8_t>(suffix_, static_cast<uint8_t>(e.strategy));
+        appendValue<uint8_t>(suffix_, e.flags);
+        appendValue<uint32_t>(suffix_, e.raw_crc);
+        appendValue<uint32_t>(suffix_, e.compressed_crc);
+    }
+    appendValue<uint32_t>(suffix_, header_crc_);
+    appendValue<uint32_t>(suffix_, checksum::crc32c(suffix_));
+
+    appendValue<uint64_t>(suffix_, index_offset);
+    suffix_.insert(suffix_.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+
+    bool ok = true;
+    try {
+        io_->write(fd_, suffix_, offset_);
+        io_->drain();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        ok = false;
+    }
+    io_.reset();
+    if (::close(fd_) != 0) ok = false;
+    fd_ = -1;
+    return ok;
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+StcmpReader::~StcmpReader() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool StcmpReader::open(const std::string& filepath) {
+    // A reader may be reused: drop the previous archive's handles and index
+    if (file_.is_open()) file_.close();
+    file_.clear();
+    if (fd_ >= 0) ::close(fd_);
+    header_.clear();
+    chunks_.clear();
+    tensors_.clear();
+    raw_size_ = 0;
+    dictionary_id_ = 0;
+    version_ = 0;
+
+    filepath_ = filepath;
+    file_.open(filepath, std::ios::binary | std::ios::ate);
+    fd_ = ::open(filepath.c_str(), O_RDONLY);
+    if (!file_.is_open() || fd_ < 0) {
+        std::cerr << "Error: Cannot open file " << filepath << std::endl;
+        return false;
+    }
+    uint64_t file_size = file_.tellg();
+    file_.seekg(0, std::ios::beg);
+
+    char magic[sizeof(STCMP_MAGIC)];
+    file_.read(magic, sizeof(magic));
+    if (!file_ || memcmp(magic, STCMP_MAGIC, sizeof(magic)) != 0) {
+        std::cerr << "Error: Not an STCMP file: " << filepath << std::endl;
+        return false;
+    }
+
+    uint8_t algo_byte = 0, op = 0;
+    if (!readValue(file_, version_)) {
+        std::cerr << "Error: Corrupt STCMP header" << std::endl;
+        return false;
+    }
+    bool read_ok = true;
+    if (version_ == 1) {
+        // Old format only supported ZSTD
+        read_ok = readValue(file_, op);
+    } else if (version_ >= 2 && version_ <= STORED_VERSION) {
+        read_ok = readValue(file_, algo_byte) && readValue(file_, op);
+    } else {
+        std::cerr << "Error: Unsupported STCMP version " << static_cast<int>(version_) << std::endl;
+        return false;
+    }
+    if (!read_ok) {
+        std::cerr << "Error: Corrupt STCMP header" << std::endl;
+        return false;
+    }
+    algo_ = static_cast<Compressor::Algorithm>(algo_byte);
+    op_point_ = static_cast<Compressor::OperationPoint>(op);
+    dictionary_id_ = 0;
+    if (version_ >= DICTIONARY_VERSION &&
+        (!readValue(file_, dictionary_id_) || (version_ == DICTIONARY_VERSION && dictionary_id_ == 0))) {
+        std::cerr << "Error: Corrupt STCMP header" << std::endl;
+        return false;
+    }
+
+    uint64_t header_size = 0;
+    if (!readValue(file_, header_size) || header_size > file_size) {
+        std::cerr << "Error: Corrupt STCMP header" << std::endl;
+        return false;
+    }
+    header_.resize(header_size);
+    if (!file_.read(header_.data(), header_size)) {
+        std::cerr << "Error: Corrupt STCMP header" << std::endl;
+        return false;
+    }
+
+    chunks_.clear();
+    if (version_ >= CHUNKED_VERSION) {
+        if (!readValue(file_, raw_size_) || !readIndex(file_size)) {
+            std::cerr << "Error: Corrupt STCMP chunk index" << std::endl;
+            return false;
+        }
+    } else {
+        // Legacy monolithic blob: expose it as one chunk of unknown raw size
+        ChunkEntry entry;
+        if (!readValue(file_, entry.compressed_size)) return false;
+        entry.file_offset = file_.tellg();
+        entry.algo = algo_;
+        entry.strategy = Preprocessor::Strategy::BYTE_REORDER;
+        if (entry.file_offset > file_size || entry.compressed_size > file_size - entry.file_offset) return false;
+        chunks_.push_back(entry);
+        raw_size_ = 0;
+    }
+
+    if (!SafetensorsParser::parseHeader(header_, raw_size_ ? raw_size_ : SIZE_MAX, tensors_)) {
+        tensors_.clear();
+    }
+    return true;
+}
+
+bool StcmpReader::readIndex(uint64_t file_size) {
+    if (file_size < FOOTER_SIZE) return false;
+
+    uint64_t index_offset = 0;
+    char magic[sizeof(INDEX_MAGIC)];
+    file_.seekg(file_size - FOOTER_SIZE, std::ios::beg);
+    if (!readValue(file_, index_offset) || !file_.read(magic, sizeof(magic))) return false;
+    if (memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0) return false;
+    // Bounded before any arithmetic, so a corrupt offset cannot wrap
+    uint64_t index_end = file_size - FOOTER_SIZE;
+    if (index_offset > index_end || index_end - index_offset < 4) return false;
+
+    // The whole index is read at once; it is small next to the payload
+    std::vector<uint8_t> index(index_end - index_offset);
+    if (!readAt(index_offset, index)) return false;
+    const uint8_t* cursor = index.data();
+    uint32_t count = takeValue<uint32_t>(cursor);
+
+    const bool checksums = hasChecksums();
+    const size_t entry_size = checksums ? CHECKSUM_ENTRY_SIZE : INDEX_ENTRY_SIZE;
+    if (static_cast<uint64_t>(count) * entry_size + (checksums ? 8 : 0) > index.size() - 4) return false;
+    if (checksums) {
+        size_t covered = 4 + count * entry_size + 4;
+        uint32_t header_crc, index_crc;
+        memcpy(&header_crc, index.data() + covered - 4, 4);
+        memcpy(&index_crc, index.data() + covered, 4);
+        if (checksum::crc32c(index.data(), covered) != index_crc) {
+            std::cerr << "Error: STCMP index checksum mismatch" << std::endl;
+            return false;
+        }
+        if (checksum::crc32c(reinterpret_cast<const uint8_t*>(header_.data()), header_.size()) != header_crc) {
+            std::cerr << "Error: STCMP header checksum mismatch" << std::endl;
+            return false;
+        }
+    }
+
+    chunks_.resize(count);
+    uint64_t expected_offset = 0;
+    for (auto& e : chunks_) {
+        e.raw_offset = takeValue<uint64_t>(cursor);
+        e.raw_size = takeValue<uint64_t>(cursor);
+        e.file_offset = takeValue<uint64_t>(cursor);
+        e.compressed_size = takeValue<uint64_t>(cursor);
+        e.algo = static_cast<Compressor::Algorithm>(takeValue<uint8_t>(cursor));
+        e.strategy = static_cast<Preprocessor::Strategy>(takeValue<uint8_t>(cursor));
+        e.flags = takeValue<uint8_t>(cursor);
+        if (checksums) {
+            e.raw_crc = takeValue<uint32_t>(cursor);
+            e.compressed_crc = takeValue<uint32_t>(cursor);
+        }
+
+        // Chunks must tile the payload in order and stay before the index
+        if (e.raw_offset != expected_offset || e.file_offset > index_offset ||
+            e.compressed_size > index_offset - e.file_offset || e.raw_size > UINT64_MAX - expected_offset) return false;
+        if (Compressor::getAlgorithmName(e.algo) == "Unknown" ||
+            Preprocessor::getStrategyName(e.strategy) == "Unknown") return false;
+        if ((e.flags & ~ChunkEntry::STORED) != 0 ||
+            (e.isStored() && (version_ < STORED_VERSION || e.compressed_size != e.raw_size))) return false;
+        expected_offset += e.raw_size;
+    }
+    return expected_offset == raw_size_;
+}
+
+bool StcmpReader::hasChecksums() const {
+    return version_ >= CHECKSUM_VERSION;
+}
+
+void StcmpReader::checkChunk(size_t index, std::span<const uint8_t> bytes, bool raw) const {
+    if (!hasChecksums()) return;
+    const ChunkEntry& e = chunks_[index];
+    if (checksum::crc32c(bytes) != (raw ? e.raw_crc : e.compressed_crc)) {
+        throw std::runtime_error("Chunk " + std::to_string(index) + ": " +
+                                 (raw ? "decoded" : "compressed") + " data checksum mismatch");
+    }
+}
+
+bool StcmpReader::readCompressedChunk(size_t index, std::vector<uint8_t>& out) {
+    if (index >= chunks_.size()) return false;
+    out.resize(chunks_[index].compressed_size);
+    return readAt(chunks_[index].file_offset, out);
+}
+
+bool StcmpReader::readAt(uint64_t offset, std::span<uint8_t> out) {
+    file_.clear();
+    file_.seekg(offset, std::ios::beg);
+    file_.read(reinterpret_cast<char*>(out.data()), out.size());
+    return static_cast<bool>(file_);
+}
+
+std::vector<uint8_t> StcmpReader::decompressChunk(size_t index) {
+    std::vector<uint8_t> compressed;
+    if (!readCompressedChunk(index, compressed)) {
+        throw std::runtime_error("Cannot read chunk " + std::to_string(index));
+    }
+    return decodeChunk(index, compressed, compressor_.getThreads());
+}
+
+std::vector<uint8_t> StcmpReader::decodeChunk(size_t index, std::span<const uint8_t> compressed, unsigned threads) {
+    const ChunkEntry& e = chunks_[index];
+    checkChunk(index, compressed, false);
+    if (e.isStored()) return std::vector<uint8_t>(compressed.begin(), compressed.end());
+    if (version_ < CHUNKED_VERSION) {
+        // Legacy blobs record no raw size; their byte reorder keeps it
+        std::vector<uint8_t> raw = compressor_.decompressChunk(compressed, e.algo, e.strategy, threads);
+        checkChunk(index, raw, true);
+        return raw;
+    }
+    // The index knows the raw size, which padded strategies cannot recover
+    // from their own length
+    std::vector<uint8_t> raw(e.raw_size);
+    ByteBuffer scratch;
+    compressor_.decompressChunk(compressed, raw, e.algo, e.strategy, scratch, threads);
+    checkChunk(index, raw, true);
+    return raw;
+}
+
+void StcmpReader::decompressChunk(size_t index, std::span<uint8_t> out,
+                                  ByteBuffer& compressed, ByteBuffer& scratch, unsigned threads) {
+    const ChunkEntry& e = chunks_.at(index);
+    if (version_ < CHUNKED_VERSION || out.size() != e.raw_size) {
+        throw std::runtime_error("Chunk " + std::to_string(index) + " has no known raw size");
+    }
+    if (e.isStored()) {
+        // Read straight into place; its two CRCs are the same
+        if (!io_util::preadFully(fd_, out, e.file_offset)) {
+            throw std::runtime_error("Cannot read chunk " + std::to_string(index));
+        }
+        checkChunk(index, out, true);
+        return;
+    }
+    compressed.resize(e.compressed_size);
+    if (!io_util::preadFully(fd_, compressed, e.file_offset)) {
+        throw std::runtime_error("Cannot read chunk " + std::to_string(index));
+    }
+    checkChunk(index, compressed, false);
+    compressor_.decompressChunk(compressed, out, e.algo, e.strategy, scratch, threads);
+    checkChunk(index, out, true);
+}
+
+// Chunks decoded side by side per batch: enough to keep every thread busy,
+// or fewer when the decoded chunks together would exceed the memory limit
+size_t StcmpReader::batchSize(size_t first, size_t last) const {
+    size_t batch = compressor_.getThreads();
+    if (compressor_.getMemoryLimit() != 0) {
+        uint64_t per_chunk = 0;
+        for (size_t i = first; i < last; ++i) {
+            per_chunk = std::max(per_chunk, 2 * chunks_[i].raw_size + chunks_[i].compressed_size);
+        }
+        if (per_chunk > 0) {
+            batch = std::clamp<size_t>(compressor_.getMemoryLimit() / per_chunk, 1, batch);
+        }
+    }
+    return std::max<size_t>(1, std::min(batch, last - first));
+}
+
+// Reads chunks [first, last) in file order, decodes each batch on the
+// shared pool straight into per-slot buffers that are reused across batches,
+// and hands the results to sink in order
+void StcmpReader::decodeRange(size_t first, size_t last,
+                              const std::function<void(size_t, std::span<const uint8_t>)>& sink) {
+    if (version_ < CHUNKED_VERSION) {
+        // Legacy blob: its raw size is only known once decoded
+        for (size_t i = first; i < last; ++i) sink(i, decompressChunk(i));
+        return;
+    }
+
+    size_t batch = batchSize(first, last);
+    unsigned inner = std::max<size_t>(1, compressor_.getThreads() / batch);
+
+    std::vector<ByteBuffer> compressed(batch), raw(batch), scratch(batch);
+    for (size_t start = first; start < last; start += batch) {
+        size_t n = std::min(batch, last - start);
+        for (size_t i = 0; i < n; ++i) {
+            // Stored chunks are read straight into their output slot
+            const ChunkEntry& e = chunks_[start + i];
+            ByteBuffer& target = e.isStored() ? raw[i] : compressed[i];
+            target.resize(e.compressed_size);
+            if (!readAt(e.file_offset, target)) {
+                throw std::runtime_error("Cannot read chunk " + std::to_string(start + i));
+            }
+        }
+        ThreadPool::shared().parallelFor(n, n, [&](size_t i) {
+            const ChunkEntry& e = chunks_[start + i];
+            if (e.isStored()) {
+                checkChunk(start + i, raw[i], true);
+                return;
+            }
+            raw[i].resize(e.raw_size);
+            checkChunk(start + i, compressed[i], false);
+            compressor_.decompressChunk(compressed[i], raw[i], e.algo, e.strategy, scratch[i], inner);
+            checkChunk(start + i, raw[i], true);
+        });
+        for (size_t i = 0; i < n; ++i) {
+            sink(start + i, raw[i]);
+        }
+    }
+}
+
+bool StcmpReader::decompressTensor(const std::string& name, std::vector<uint8_t>& out) {
+    auto it = std::find_if(tensors_.begin(), tensors_.end(),
+                           [&name](const TensorInfo& t) { return t.name == name; });
+    if (it == tensors_.end()) {
+        std::cerr << "Error: Tensor not found: " << name << std::endl;
+        return false;
+    }
+    const uint64_t begin = it->data_begin, end = it->data_end;
+
+    try {
+        out.resize(end - begin);
+        if (version_ < CHUNKED_VERSION) {
+            // Legacy files have no index, the whole blob has to be decoded
+            std::vector<uint8_t> all = decompressChunk(0);
+            if (end > all.size()) throw std::runtime_error("Tensor lies outside the tensor data");
+            std::copy(all.begin() + begin, all.begin() + end, out.begin());
+            return true;
+        }
+
+        // First chunk whose range ends after the tensor starts
+        auto first = std::upper_bound(chunks_.begin(), chunks_.end(), begin,
+            [](uint64_t offset, const ChunkEntry& c) { return offset < c.raw_offset + c.raw_size; });
+        auto last = first;
+        while (last != chunks_.end() && last->raw_offset < end) ++last;
+
+        decodeRange(first - chunks_.begin(), last - chunks_.begin(), [&](size_t index, std::span<const uint8_t> raw) {
+            const ChunkEntry& c = chunks_[index];
+            uint64_t from = std::max(begin, c.raw_offset);
+            uint64_t to = std::min(end, c.raw_offset + c.raw_size);
+            std::copy(raw.begin() + (from - c.raw_offset), raw.begin() + (to - c.raw_offset),
+                      out.begin() + (from - begin));
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool StcmpReader::decompressAll(std::ostream& out, uint64_t* bytes_written) {
+    uint64_t total = 0;
+    try {
+        decodeRange(0, chunks_.size(), [&](size_t, std::span<const uint8_t> raw) {
+            out.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+            total += raw.size();
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    if (bytes_written) *bytes_written = total;
+    if (version_ >= CHUNKED_VERSION && total != raw_size_) return false;
+    return static_cast<bool>(out);
+}
+
+// Every worker owns a set of buffers and repeatedly claims the next chunk,
+// decodes it and pwrites it at its final offset. No
+// worker waits for the chunks before its own, so restore time scales with
+// the core count instead of being bounded by one in-order writer.
+bool StcmpReader::decompressToFile(const std::string& path, uint64_t* bytes_written) {
+    const uint64_t header_size = header_.size();
+    auto header_bytes = [&](std::span<uint8_t> prefix) {
+        memcpy(prefix.data(), &header_size, 8);
+        memcpy(prefix.data() + 8, header_.data(), header_.size());
+    };
+
+    if (version_ < CHUNKED_VERSION) {
+        // Legacy blob: the payload size is only known once decoded
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Error: Cannot create " << path << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> prefix(8 + header_size);
+        header_bytes(prefix);
+        out.write(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+        if (decompressAll(out, bytes_written)) return true;
+        out.close();
+        ::unlink(path.c_str());
+        return false;
+    }
+
+    int out = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        std::cerr << "Error: Cannot create " << path << std::endl;
+        return false;
+    }
+
+    const uint64_t data_offset = 8 + header_size;
+    bool ok = true;
+    try {
+        // Reserve the whole file first: out-of-order writes then neither
+        // fragment it nor run out of space halfway. Filesystems without
+        // fallocate get a sparse file of the right size instead.
+        if (fallocate(out, 0, 0, data_offset + raw_size_) != 0 && ftruncate(out, data_offset + raw_size_) != 0) {
+            throw std::runtime_error("Cannot allocate " + path);
+        }
+        ByteBuffer prefix;
+        prefix.resize(data_offset);
+        header_bytes(prefix);
+        if (!io_util::pwriteFully(out, prefix, 0)) throw std::runtime_error("Cannot write " + path);
+
+        size_t workers = batchSize(0, chunks_.size());
+        unsigned inner = std::max<size_t>(1, compressor_.getThreads() / workers);
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        ThreadPool::shared().parallelFor(workers, workers, [&](size_t) {
+            ByteBuffer compressed, raw, scratch;
+            size_t i;
+            while (!failed && (i = next.fetch_add(1)) < chunks_.size()) {
+                const ChunkEntry& e = chunks_[i];
+                try {
+                    raw.resize(e.raw_size);
+                    decompressChunk(i, raw, compressed, scratch, inner);
+                    if (!io_util::pwriteFully(out, raw, data_offset + e.raw_offset)) {
+                        throw std::runtime_error("Cannot write chunk " + std::to_string(i) + " to " + path);
+                    }
+                } catch (...) {
+                    failed = true;
+                    throw;
+                }
+            }
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        ok = false;
+    }
+
+    if (::close(out) != 0) ok = false;
+    // A preallocated file of the right size would pass for a restored one
+    if (!ok) ::unlink(path.c_str());
+    if (ok && bytes_written) *bytes_written = raw_size_;
+    return ok;
+}
+
+bool StcmpReader::verify(bool quick, VerifyReport& report) {
+    report = VerifyReport();
+    report.chunks = chunks_.size();
+    report.checksums = hasChecksums();
+    report.decoded = !quick || !report.checksums;
+
+    if (version_ < CHUNKED_VERSION) {
+        // Legacy blob: decoding it is the only check there is
+        try {
+            report.compressed_bytes = chunks_[0].compressed_size;
+            report.raw_bytes = decompressChunk(0).size();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            report.failed_chunks = 1;
+        }
+        return report.failed_chunks == 0;
+    }
+
+    // Same worker scheme as decompressToFile, minus the writes
+    size_t workers = report.decoded ? batchSize(0, chunks_.size())
+                                    : std::min<size_t>(compressor_.getThreads(), chunks_.size());
+    workers = std::max<size_t>(1, workers);
+    unsigned inner = std::max<size_t>(1, compressor_.getThreads() / workers);
+    std::atomic<size_t> next{0}, failed{0};
+    std::atomic<uint64_t> compressed_bytes{0}, raw_bytes{0};
+    std::mutex print_mutex;
+    ThreadPool::shared().parallelFor(workers, workers, [&](size_t) {
+        ByteBuffer compressed, raw, scratch;
+        size_t i;
+        while ((i = next.fetch_add(1)) < chunks_.size()) {
+            const ChunkEntry& e = chunks_[i];
+            try {
+                if (report.decoded) {
+                    raw.resize(e.raw_size);
+                    decompressChunk(i, raw, compressed, scratch, inner);
+                    raw_bytes += e.raw_size;
+                } else {
+                    compressed.resize(e.compressed_size);
+                    if (!io_util::preadFully(fd_, compressed, e.file_offset)) {
+                        throw std::runtime_error("Cannot read chunk " + std::to_string(i));
+                    }
+                    checkChunk(i, compressed, false);
+                }
+                compressed_bytes += e.compressed_size;
+            } catch (const std::exception& ex) {
+                ++failed;
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cerr << "Error: " << ex.what() << " (raw bytes " << e.raw_offset << "-"
+                          << (e.raw_offset + e.raw_size) << ")" << std::endl;
+            }
+        }
+    });
+
+    report.failed_chunks = failed;
+    report.compressed_bytes = compressed_bytes;
+    report.raw_bytes = raw_bytes;
+    return report.failed_chunks == 0;
+}
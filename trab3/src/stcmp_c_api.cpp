@@ -0,0 +1,131 @@
+#include "../includes/stcmp.h"
+#include "../includes/tensor_loader.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct stcmp_reader {
+    std::unique_ptr<TensorLoader> loader;
+    std::vector<std::string> dtype_names;  // Backing storage for stcmp_tensor_dtype
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+int fail(int code, const std::string& message) {
+    last_error = message;
+    return code;
+}
+
+const TensorInfo* tensorAt(const stcmp_reader* reader, size_t index) {
+    if (!reader || index >= reader->loader->getTensors().size()) return nullptr;
+    return &reader->loader->getTensors()[index];
+}
+
+} // namespace
+
+uint32_t stcmp_abi_version(void) {
+    return STCMP_ABI_VERSION;
+}
+
+const char* stcmp_last_error(void) {
+    return last_error.c_str();
+}
+
+stcmp_reader* stcmp_open(const char* path, const char* dictionary_path) {
+    if (!path) {
+        fail(STCMP_ERROR_INVALID_ARGUMENT, "No archive path given");
+        return nullptr;
+    }
+    try {
+        std::shared_ptr<const ZstdDictionary> dictionary;
+        if (dictionary_path) {
+            dictionary = ZstdDictionary::load(dictionary_path);
+            if (!dictionary) throw std::runtime_error(std::string("Cannot load dictionary ") + dictionary_path);
+        }
+        auto reader = std::make_unique<stcmp_reader>();
+        reader->loader = std::make_unique<TensorLoader>(path, std::move(dictionary));
+        for (const auto& t : reader->loader->getTensors()) {
+            reader->dtype_names.push_back(SafetensorsParser::getDTypeName(t.dtype));
+        }
+        return reader.release();
+    } catch (const std::exception& e) {
+        fail(STCMP_ERROR_DECODE, e.what());
+        return nullptr;
+    }
+}
+
+void stcmp_close(stcmp_reader* reader) {
+    delete reader;
+}
+
+const char* stcmp_header(const stcmp_reader* reader) {
+    return reader ? reader->loader->getHeader().c_str() : nullptr;
+}
+
+size_t stcmp_tensor_count(const stcmp_reader* reader) {
+    return reader ? reader->loader->getTensors().size() : 0;
+}
+
+int64_t stcmp_find_tensor(const stcmp_reader* reader, const char* name) {
+    if (!reader || !name) return -1;
+    const TensorInfo* t = reader->loader->findTensor(name);
+    return t ? static_cast<int64_t>(t - reader->loader->getTensors().data()) : -1;
+}
+
+const char* stcmp_tensor_name(const stcmp_reader* reader, size_t index) {
+    const TensorInfo* t = tensorAt(reader, index);
+    return t ? t->name.c_str() : nullptr;
+}
+
+const char* stcmp_tensor_dtype(const stcmp_reader* reader, size_t index) {
+    return tensorAt(reader, index) ? reader->dtype_names[index].c_str() : nullptr;
+}
+
+size_t stcmp_tensor_ndim(const stcmp_reader* reader, size_t index) {
+    const TensorInfo* t = tensorAt(reader, index);
+    return t ? t->shape.size() : 0;
+}
+
+const int64_t* stcmp_tensor_shape(const stcmp_reader* reader, size_t index) {
+    const TensorInfo* t = tensorAt(reader, index);
+    return t ? t->shape.data() : nullptr;
+}
+
+uint64_t stcmp_tensor_size(const stcmp_reader* reader, size_t index) {
+    const TensorInfo* t = tensorAt(reader, index);
+    return t ? t->size() : 0;
+}
+
+int stcmp_read_tensor(stcmp_reader* reader, size_t index, void* dst, size_t dst_size) {
+    const TensorInfo* t = tensorAt(reader, index);
+    if (!t || (!dst && dst_size != 0)) {
+        return fail(STCMP_ERROR_INVALID_ARGUMENT, "Invalid reader, tensor index or buffer");
+    }
+    if (dst_size != t->size()) {
+        return fail(STCMP_ERROR_BUFFER_SIZE, "Buffer for " + t->name + " must be " +
+                    std::to_string(t->size()) + " bytes");
+    }
+    try {
+        reader->loader->readTensor(*t, std::span<uint8_t>(static_cast<uint8_t*>(dst), dst_size));
+    } catch (const std::exception& e) {
+        return fail(STCMP_ERROR_DECODE, e.what());
+    }
+    return STCMP_OK;
+}
+
+void stcmp_set_cache_capacity(stcmp_reader* reader, size_t bytes) {
+    if (reader) reader->loader->setCacheCapacity(bytes);
+}
+
+void stcmp_set_threads(stcmp_reader* reader, unsigned threads) {
+    if (reader) reader->loader->setThreads(threads);
+}
+
+void stcmp_cache_stats(const stcmp_reader* reader, uint64_t* hits, uint64_t* misses, size_t* cached_bytes) {
+    if (!reader) return;
+    if (hits) *hits = reader->loader->getCacheHits();
+    if (misses) *misses = reader->loader->getCacheMisses();
+    if (cached_bytes) *cached_bytes = reader->loader->getCachedBytes();
+}
@@ -0,0 +1,141 @@
+#include "../includes/tensor_loader.hpp"
+#include "../includes/thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+TensorLoader::TensorLoader(const std::string& path, std::shared_ptr<const ZstdDictionary> dictionary) {
+    if (!reader_.open(path)) {
+        throw std::runtime_error("Cannot open STCMP archive " + path);
+    }
+    if (reader_.getVersion() < 3) {
+        throw std::runtime_error(path + " is a version " + std::to_string(reader_.getVersion()) +
+                                 " archive without a chunk index; compress it again to load tensors lazily");
+    }
+    uint32_t id = reader_.getDictionaryID();
+    if (id != 0) {
+        if (!dictionary || dictionary->getID() != id) {
+            throw std::runtime_error(path + " needs ZSTD dictionary " + std::to_string(id));
+        }
+        reader_.setDictionary(std::move(dictionary));
+    }
+}
+
+const TensorInfo* TensorLoader::findTensor(const std::string& name) const {
+    for (const auto& t : reader_.getTensors()) {
+        if (t.name == name) return &t;
+    }
+    return nullptr;
+}
+
+void TensorLoader::readTensor(const TensorInfo& tensor, std::span<uint8_t> out) {
+    if (out.size() != tensor.size()) {
+        throw std::runtime_error("Buffer for " + tensor.name + " holds " + std::to_string(out.size()) +
+                                 " bytes, the tensor has " + std::to_string(tensor.size()));
+    }
+    const std::vector<ChunkEntry>& chunks = reader_.getChunks();
+    const uint64_t begin = tensor.data_begin, end = tensor.data_end;
+    if (end > reader_.getRawSize()) throw std::runtime_error(tensor.name + " lies outside the tensor data");
+    if (begin == end) return;
+
+    // Cached chunks are copied right away; the rest is decoded below
+    auto first = std::upper_bound(chunks.begin(), chunks.end(), begin,
+        [](uint64_t offset, const ChunkEntry& c) { return offset < c.raw_offset + c.raw_size; });
+    std::vector<size_t> pending;
+    for (auto it = first; it != chunks.end() && it->raw_offset < end; ++it) {
+        size_t index = it - chunks.begin();
+        bool inside = it->raw_offset >= begin && it->raw_offset + it->raw_size <= end;
+        if (!inside) {
+            if (auto cached = lookup(index)) {
+                uint64_t from = std::max(begin, it->raw_offset);
+                uint64_t to = std::min(end, it->raw_offset + it->raw_size);
+                memcpy(out.data() + (from - begin), cached->data() + (from - it->raw_offset), to - from);
+                continue;
+            }
+        }
+        pending.push_back(index);
+    }
+    if (pending.empty()) return;
+
+    unsigned configured = threads_.load(std::memory_order_relaxed);
+    size_t threads = configured == 0 ? ThreadPool::defaultThreadCount() : configured;
+    size_t workers = std::min(threads, pending.size());
+    unsigned inner = static_cast<unsigned>(std::max<size_t>(1, threads / workers));
+    std::atomic<size_t> next{0};
+    ThreadPool::shared().parallelFor(workers, workers, [&](size_t) {
+        ByteBuffer compressed, scratch;
+        size_t k;
+        while ((k = next.fetch_add(1)) < pending.size()) {
+            const ChunkEntry& c = chunks[pending[k]];
+            if (c.raw_offset >= begin && c.raw_offset + c.raw_size <= end) {
+                reader_.decompressChunk(pending[k], out.subspan(c.raw_offset - begin, c.raw_size),
+                                        compressed, scratch, inner);
+                continue;
+            }
+            auto raw = std::make_shared<ByteBuffer>();
+            raw->resize(c.raw_size);
+            reader_.decompressChunk(pending[k], *raw, compressed, scratch, inner);
+            uint64_t from = std::max(begin, c.raw_offset);
+            uint64_t to = std::min(end, c.raw_offset + c.raw_size);
+            memcpy(out.data() + (from - begin), raw->data() + (from - c.raw_offset), to - from);
+            insert(pending[k], std::move(raw));
+        }
+    });
+}
+
+std::shared_ptr<const ByteBuffer> TensorLoader::lookup(size_t chunk) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_index_.find(chunk);
+    if (it == cache_index_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->data;
+}
+
+void TensorLoader::insert(size_t chunk, std::shared_ptr<const ByteBuffer> data) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    // Another thread may have decoded the same chunk meanwhile
+    if (data->size() > cache_capacity_ || cache_index_.count(chunk)) return;
+    cached_bytes_ += data->size();
+    lru_.push_front({chunk, std::move(data)});
+    cache_index_[chunk] = lru_.begin();
+    evict();
+}
+
+void TensorLoader::evict() {
+    while (cached_bytes_ > cache_capacity_) {
+        cached_bytes_ -= lru_.back().data->size();
+        cache_index_.erase(lru_.back().chunk);
+        lru_.pop_back();
+    }
+}
+
+void TensorLoader::setCacheCapacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_capacity_ = bytes;
+    evict();
+}
+
+size_t TensorLoader::getCacheCapacity() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return cache_capacity_;
+}
+
+size_t TensorLoader::getCachedBytes() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return cached_bytes_;
+}
+
+uint64_t TensorLoader::getCacheHits() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return hits_;
+}
+
+uint64_t TensorLoader::getCacheMisses() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return misses_;
+}
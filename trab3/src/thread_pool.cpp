@@ -0,0 +1,98 @@
+#include "../includes/thread_pool.hpp"
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned num_threads) : stop_(false) {
+    if (num_threads == 0) num_threads = defaultThreadCount();
+    workers_.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t max_parallel, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (count == 1 || max_parallel <= 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    // Helpers pull indices from a shared counter. A helper that only gets
+    // scheduled after all indices were taken returns without touching fn,
+    // so the caller never waits on tasks still queued behind busy workers.
+    struct State {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        size_t count = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+
+    auto run = [state, &fn]() {
+        size_t i;
+        while ((i = state->next.fetch_add(1)) < state->count) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) state->error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->done == state->count) state->cv.notify_all();
+        }
+    };
+
+    size_t helpers = std::min({max_parallel, count, static_cast<size_t>(getThreadCount()) + 1}) - 1;
+    for (size_t h = 0; h < helpers; ++h) submit(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&state] { return state->done == state->count; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+unsigned ThreadPool::defaultThreadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 4 : n;  // Fallback to 4 threads
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,74 @@
+#include "../includes/zstd_dictionary.hpp"
+#include <zstd.h>
+#include <zdict.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// Dictionaries alive in the process, by ID. Entries expire with the last
+// user, so the cache never pins memory nobody needs.
+std::mutex cache_mutex;
+std::map<uint32_t, std::weak_ptr<const ZstdDictionary>> cache;
+
+}  // namespace
+
+ZstdDictionary::ZstdDictionary(std::vector<uint8_t> bytes, uint32_t id)
+    : bytes_(std::move(bytes)), id_(id) {
+    ddict_ = ZSTD_createDDict(bytes_.data(), bytes_.size());
+    if (!ddict_) throw std::runtime_error("ZSTD: failed to digest dictionary");
+}
+
+ZstdDictionary::~ZstdDictionary() {
+    ZSTD_freeDDict(ddict_);
+    for (auto& [level, cdict] : cdicts_) ZSTD_freeCDict(cdict);
+}
+
+std::shared_ptr<const ZstdDictionary> ZstdDictionary::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open dictionary " << path << std::endl;
+        return nullptr;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto dict = fromBytes(std::move(bytes));
+    if (!dict) std::cerr << "Error: " << path << " is not a ZSTD dictionary" << std::endl;
+    return dict;
+}
+
+std::shared_ptr<const ZstdDictionary> ZstdDictionary::fromBytes(std::vector<uint8_t> bytes) {
+    // Raw-content dictionaries have no ID and could not be referenced
+    uint32_t id = ZDICT_getDictID(bytes.data(), bytes.size());
+    if (id == 0) return nullptr;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (auto cached = cache[id].lock()) return cached;
+    std::shared_ptr<const ZstdDictionary> dict(new ZstdDictionary(std::move(bytes), id));
+    cache[id] = dict;
+    return dict;
+}
+
+std::vector<uint8_t> ZstdDictionary::train(std::span<const uint8_t> samples,
+                                           const std::vector<size_t>& sample_sizes,
+                                           size_t capacity) {
+    std::vector<uint8_t> dict(capacity);
+    size_t size = ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(),
+                                        sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+    if (ZDICT_isError(size)) {
+        throw std::runtime_error("Dictionary training failed: " + std::string(ZDICT_getErrorName(size)));
+    }
+    dict.resize(size);
+    return dict;
+}
+
+const ZSTD_CDict_s* ZstdDictionary::getCDict(int level) const {
+    std::lock_guard<std::mutex> lock(cdict_mutex_);
+    ZSTD_CDict*& cdict = cdicts_[level];
+    if (!cdict) {
+        cdict = ZSTD_createCDict(bytes_.data(), bytes_.size(), level);
+        if (!cdict) throw std::runtime_error("ZSTD: failed to digest dictionary");
+    }
+    return cdict;
+}